@@ -1,7 +1,11 @@
 #ifndef ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 #define ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 
+#ifdef __ANDROID__
 #include <android/log.h>
+#else
+#include <iostream>
+#endif
 #include <sstream>
 
 /*!
@@ -26,7 +30,12 @@ public:
 
 protected:
     virtual int sync() override {
+#ifdef __ANDROID__
         __android_log_print(ANDROID_LOG_DEBUG, logTag_, "%s", str().c_str());
+#else
+        // on host builds there's no logcat, so go to stderr (stdout is left to the tools' output)
+        std::clog << logTag_ << ": " << str() << std::flush;
+#endif
         str("");
         return 0;
     }
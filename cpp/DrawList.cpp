@@ -0,0 +1,78 @@
+#include "DrawList.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint64_t DrawList::MakeSortKey(RenderPass pass, uint32_t program, const ModelMesh& mesh, size_t submesh, int lod,
+                                float view_depth)
+{
+    const auto& material = mesh._submeshes[submesh].material;
+    // the textures' hash, then the material's block: materials sharing textures stay together, and
+    // apart from each other
+    const uint32_t texture_bits = (material._pbr_base_color_texture._id * 0x9E3779B1u
+                                   ^ material._normal_texture._id) >> 22;
+    const uint32_t material_bits = (texture_bits << 6) | (static_cast<uint32_t>(material._uniform_block_slot) & 0x3Fu);
+    // the bits of a non-negative float sort like its value, the top 21 keep 12 bits of mantissa
+    view_depth = std::max(view_depth, 0.0f);
+    uint32_t depth_bits;
+    memcpy(&depth_bits, &view_depth, sizeof(depth_bits));
+
+    return (static_cast<uint64_t>(static_cast<uint32_t>(pass) & 0x3u) << 62)
+           | (static_cast<uint64_t>(program & 0x3Fu) << 56)
+           | (static_cast<uint64_t>(material_bits & 0xFFFFu) << 40)
+           | (static_cast<uint64_t>(mesh._sort_id & 0xFFFFu) << 24)
+           | (static_cast<uint64_t>(static_cast<uint32_t>(lod) & 0x7u) << 21)
+           | (depth_bits >> 11);
+}
+
+void DrawList::Clear()
+{
+    _items.clear();
+    _run_ends.clear();
+    _batches.clear();
+}
+
+void DrawList::AppendSortedRun(const std::vector<DrawItem>& items)
+{
+    if(items.empty()) {
+        return;
+    }
+    _items.insert(_items.end(), items.begin(), items.end());
+    _run_ends.push_back(_items.size());
+}
+
+void DrawList::MergeRuns()
+{
+    auto by_key = [](const DrawItem& a, const DrawItem& b) { return a.sort_key < b.sort_key; };
+    // merge neighbouring runs pairwise until one is left: log2(runs) passes over the items
+    while(_run_ends.size() > 1) {
+        std::vector<size_t> merged_ends;
+        size_t begin = 0;
+        for(size_t i = 0; i < _run_ends.size(); i += 2) {
+            if(i + 1 < _run_ends.size()) {
+                std::inplace_merge(_items.begin() + begin, _items.begin() + _run_ends[i],
+                                   _items.begin() + _run_ends[i + 1], by_key);
+                begin = _run_ends[i + 1];
+            } else {
+                begin = _run_ends[i];
+            }
+            merged_ends.push_back(begin);
+        }
+        _run_ends.swap(merged_ends);
+    }
+}
+
+void DrawList::BuildBatches()
+{
+    _batches.clear();
+    for(size_t i = 0; i < _items.size(); ++i) {
+        const auto& first = _items[_batches.empty() ? i : _batches.back().first];
+        if(_batches.empty() || _items[i].mesh != first.mesh || _items[i].submesh != first.submesh
+           || _items[i].lod != first.lod
+           || _items[i].meshlets != nullptr || first.meshlets != nullptr) {
+            _batches.push_back({i, 0});
+        }
+        _batches.back().count += 1;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef MY_MOBILE_APP_DRAWLIST_H
+#define MY_MOBILE_APP_DRAWLIST_H
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Model;
+struct ModelMesh;
+
+// the passes of a frame, in drawing order
+enum class RenderPass : uint8_t
+{
+    Opaque = 0,
+};
+
+/*!
+ * One mesh draw of a frame.
+ */
+struct DrawItem
+{
+    // draws are submitted in increasing key order, see DrawList::MakeSortKey()
+    uint64_t sort_key = 0;
+    // the model owning the mesh, whose gpu resources are created on first use if needed
+    Model* model = nullptr;
+    ModelMesh* mesh = nullptr;
+    // the submesh drawn, in the mesh's _submeshes
+    uint32_t submesh = 0;
+    // the mesh's level of detail, see ModelMesh::_lods
+    int lod = 0;
+    // the drawing node's world matrix. Valid until the scene's transforms are next updated.
+    const glm::mat4* world_matrix = nullptr;
+    // when some of the submesh's meshlets were culled, the ones left to draw: meshlet_count indices in
+    // the mesh's _meshlets. Null to draw the whole level of detail.
+    const uint32_t* meshlets = nullptr;
+    uint32_t meshlet_count = 0;
+};
+
+/*!
+ * Consecutive draws of a DrawList sharing a submesh and its level of detail, and so its material,
+ * vertex array and index range: they're submitted as one instanced draw call. A draw of some of a
+ * submesh's meshlets is a batch of its own.
+ */
+struct DrawBatch
+{
+    // index of the first draw in the list's items
+    size_t first = 0;
+    size_t count = 0;
+};
+
+/*!
+ * The draws of a frame, in submission order.
+ *
+ * It's built from runs of draws, each already sorted, e.g. one per chunk of render objects built
+ * by a job, then merged into one sorted list for the render thread to submit.
+ */
+class DrawList
+{
+public:
+    /*!
+     * Makes a draw's sort key. From the most to the least significant bits:
+     *
+     *   pass (2) | program (6) | material (16) | mesh (16) | lod (3) | depth (21)
+     *
+     * so that draws are grouped by the state most expensive to change, and front to back within
+     * the same state, which lets early depth testing reject hidden fragments. The mesh bits are
+     * the mesh's ModelMesh::_sort_id rather than its vertex array, which merged meshes share: their
+     * draws would interleave. Draws of a mesh are grouped by level of detail, which only changes the index range drawn. The material bits
+     * fold the texture ids together (10), then the material's uniform block slot (6), so that the
+     * submeshes of a mesh sharing textures don't interleave. Two materials may share them, which
+     * costs a few extra binds, never a wrong one.
+     * @param program the index of the shader program drawing the mesh
+     * @param submesh the submesh drawn, whose material is used
+     * @param lod the mesh's level of detail drawn
+     * @param view_depth the distance to the mesh in front of the camera
+     */
+    static uint64_t MakeSortKey(RenderPass pass, uint32_t program, const ModelMesh& mesh, size_t submesh, int lod,
+                                float view_depth);
+
+    void Clear();
+
+    // appends draws already sorted by key
+    void AppendSortedRun(const std::vector<DrawItem>& items);
+
+    // merges the appended runs into one sorted list
+    void MergeRuns();
+
+    /*!
+     * Groups the sorted draws into batches of the same submesh and level of detail, besides the draws
+     * of culled meshlets. The sort key puts those draws next to each other, front to back.
+     */
+    void BuildBatches();
+
+    inline const std::vector<DrawItem>& GetItems() const { return _items; }
+    inline const std::vector<DrawBatch>& GetBatches() const { return _batches; }
+
+private:
+    std::vector<DrawItem> _items;
+    // end of each run in _items
+    std::vector<size_t> _run_ends;
+    std::vector<DrawBatch> _batches;
+};
+
+#endif //MY_MOBILE_APP_DRAWLIST_H
@@ -0,0 +1,277 @@
+#include "GLStateCache.h"
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+
+void GLStateCache::invalidate()
+{
+    program_ = UNKNOWN;
+    vertex_array_ = UNKNOWN;
+    array_buffer_ = UNKNOWN;
+    element_array_buffer_ = UNKNOWN;
+    uniform_buffer_ = UNKNOWN;
+    std::fill(std::begin(uniform_buffer_ranges_), std::end(uniform_buffer_ranges_), BufferRange{UNKNOWN, 0, 0});
+    active_texture_unit_ = UNKNOWN;
+    for(auto& unit_textures : textures_) {
+        std::fill(std::begin(unit_textures), std::end(unit_textures), UNKNOWN);
+    }
+    std::fill(std::begin(capabilities_), std::end(capabilities_), UNKNOWN);
+    blend_source_ = UNKNOWN;
+    blend_destination_ = UNKNOWN;
+    depth_function_ = UNKNOWN;
+    depth_mask_ = UNKNOWN;
+    uniforms_.clear();
+}
+
+bool GLStateCache::changes(GLuint& shadowed, GLuint value)
+{
+    if(shadowed == value) {
+        filtered_calls_ += 1;
+        return false;
+    }
+    shadowed = value;
+    issued_calls_ += 1;
+    return true;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if(changes(program_, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vertex_array)
+{
+    if(changes(vertex_array_, vertex_array)) {
+        glBindVertexArray(vertex_array);
+        // the element array binding is part of the vertex array's state
+        element_array_buffer_ = UNKNOWN;
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint* shadowed = nullptr;
+    switch(target) {
+        case GL_ARRAY_BUFFER: shadowed = &array_buffer_; break;
+        case GL_ELEMENT_ARRAY_BUFFER: shadowed = &element_array_buffer_; break;
+        case GL_UNIFORM_BUFFER: shadowed = &uniform_buffer_; break;
+        default: break;
+    }
+    if(shadowed == nullptr) {
+        issued_calls_ += 1;
+        glBindBuffer(target, buffer);
+    } else if(changes(*shadowed, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLStateCache::bindBufferRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    assert(index < MAX_UNIFORM_BUFFER_BINDINGS);
+    auto& range = uniform_buffer_ranges_[index];
+    if(range.buffer == buffer && range.offset == offset && range.size == size) {
+        filtered_calls_ += 1;
+        return;
+    }
+    range = {buffer, offset, size};
+    issued_calls_ += 1;
+    glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    // it binds the generic binding point too
+    uniform_buffer_ = buffer;
+}
+
+void GLStateCache::activeTexture(int unit)
+{
+    if(changes(active_texture_unit_, static_cast<GLuint>(unit))) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void GLStateCache::bindTexture(int unit, GLuint texture, GLenum target)
+{
+    assert(unit >= 0 && unit < MAX_TEXTURE_UNITS);
+    assert(target == GL_TEXTURE_2D || target == GL_TEXTURE_3D);
+    GLuint& bound_texture = textures_[unit][target == GL_TEXTURE_3D ? 1 : 0];
+    if(bound_texture == texture) {
+        filtered_calls_ += 1;
+        return;
+    }
+    activeTexture(unit);
+    changes(bound_texture, texture);
+    glBindTexture(target, texture);
+}
+
+int GLStateCache::capabilityIndex(GLenum capability)
+{
+    switch(capability) {
+        case GL_BLEND: return Blend;
+        case GL_CULL_FACE: return CullFace;
+        case GL_DEPTH_TEST: return DepthTest;
+        case GL_SCISSOR_TEST: return ScissorTest;
+        case GL_STENCIL_TEST: return StencilTest;
+        default: return -1;
+    }
+}
+
+void GLStateCache::setCapability(GLenum capability, bool enabled)
+{
+    const int index = capabilityIndex(capability);
+    if(index < 0) {
+        issued_calls_ += 1;
+    } else if(!changes(capabilities_[index], enabled ? GL_TRUE : GL_FALSE)) {
+        return;
+    }
+    if(enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+    setCapability(capability, true);
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+    setCapability(capability, false);
+}
+
+void GLStateCache::blendFunc(GLenum source_factor, GLenum destination_factor)
+{
+    if(blend_source_ == source_factor && blend_destination_ == destination_factor) {
+        filtered_calls_ += 1;
+        return;
+    }
+    blend_source_ = source_factor;
+    blend_destination_ = destination_factor;
+    issued_calls_ += 1;
+    glBlendFunc(source_factor, destination_factor);
+}
+
+void GLStateCache::depthFunc(GLenum function)
+{
+    if(changes(depth_function_, function)) {
+        glDepthFunc(function);
+    }
+}
+
+void GLStateCache::depthMask(GLboolean enabled)
+{
+    if(changes(depth_mask_, enabled ? GL_TRUE : GL_FALSE)) {
+        glDepthMask(enabled);
+    }
+}
+
+bool GLStateCache::setUniform(GLint location, const void* value, size_t size)
+{
+    // GL ignores location -1, and uniforms can't be tracked without knowing the program
+    if(location < 0) {
+        return false;
+    }
+    if(program_ == UNKNOWN) {
+        issued_calls_ += 1;
+        return true;
+    }
+    const uint64_t key = (static_cast<uint64_t>(program_) << 32) | static_cast<uint32_t>(location);
+    auto& shadowed = uniforms_[key];
+    if(shadowed.size == size && memcmp(shadowed.data, value, size) == 0) {
+        filtered_calls_ += 1;
+        return false;
+    }
+    memcpy(shadowed.data, value, size);
+    shadowed.size = size;
+    issued_calls_ += 1;
+    return true;
+}
+
+bool GLStateCache::uniform1i(GLint location, GLint value)
+{
+    if(!setUniform(location, &value, sizeof(value))) {
+        return false;
+    }
+    glUniform1i(location, value);
+    return true;
+}
+
+bool GLStateCache::uniform3fv(GLint location, const glm::vec3& value)
+{
+    if(!setUniform(location, glm::value_ptr(value), sizeof(value))) {
+        return false;
+    }
+    glUniform3fv(location, 1, glm::value_ptr(value));
+    return true;
+}
+
+bool GLStateCache::uniform4fv(GLint location, const glm::vec4& value)
+{
+    if(!setUniform(location, glm::value_ptr(value), sizeof(value))) {
+        return false;
+    }
+    glUniform4fv(location, 1, glm::value_ptr(value));
+    return true;
+}
+
+bool GLStateCache::uniformMatrix4fv(GLint location, const glm::mat4& value)
+{
+    if(!setUniform(location, glm::value_ptr(value), sizeof(value))) {
+        return false;
+    }
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    return true;
+}
+
+void GLStateCache::deleteProgram(GLuint program)
+{
+    glDeleteProgram(program);
+    // a program in use is only deleted once it's no longer used, but its ids may then be reused
+    for(auto it = uniforms_.begin(); it != uniforms_.end();) {
+        it = (it->first >> 32) == program ? uniforms_.erase(it) : std::next(it);
+    }
+    if(program_ == program) {
+        program_ = UNKNOWN;
+    }
+}
+
+void GLStateCache::deleteVertexArray(GLuint vertex_array)
+{
+    glDeleteVertexArrays(1, &vertex_array);
+    if(vertex_array_ == vertex_array) {
+        vertex_array_ = 0;
+        element_array_buffer_ = UNKNOWN;
+    }
+}
+
+void GLStateCache::deleteBuffer(GLuint buffer)
+{
+    glDeleteBuffers(1, &buffer);
+    for(GLuint* shadowed : {&array_buffer_, &element_array_buffer_, &uniform_buffer_}) {
+        if(*shadowed == buffer) {
+            *shadowed = 0;
+        }
+    }
+    for(auto& range : uniform_buffer_ranges_) {
+        if(range.buffer == buffer) {
+            range = {0, 0, 0};
+        }
+    }
+}
+
+void GLStateCache::deleteTexture(GLuint texture)
+{
+    glDeleteTextures(1, &texture);
+    for(auto& unit_textures : textures_) {
+        for(auto& bound_texture : unit_textures) {
+            if(bound_texture == texture) {
+                bound_texture = 0;
+            }
+        }
+    }
+}
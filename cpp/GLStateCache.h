@@ -0,0 +1,118 @@
+#ifndef MY_MOBILE_APP_GLSTATECACHE_H
+#define MY_MOBILE_APP_GLSTATECACHE_H
+
+#include <GLES3/gl3.h>
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+
+/*!
+ * Shadows the GL state the renderer sets, and drops the calls that wouldn't change it. GL calls
+ * cost CPU time in the driver even when they change nothing.
+ *
+ * There's one per GL context, and all state changes on that context must go through it: a call
+ * made directly to GL leaves the shadow copy wrong, until invalidate().
+ */
+class GLStateCache
+{
+public:
+    static constexpr int MAX_TEXTURE_UNITS = 16;
+    static constexpr int MAX_UNIFORM_BUFFER_BINDINGS = 16;
+
+    GLStateCache() { invalidate(); }
+
+    /*!
+     * Forgets the shadowed state, e.g. after GL code that doesn't use this cache. The next call of
+     * each kind is then always issued.
+     */
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertex_array);
+    // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER are tracked, other targets are
+    // always issued
+    void bindBuffer(GLenum target, GLuint buffer);
+    // binds a range of a uniform buffer to a uniform block binding point
+    void bindBufferRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    // @param unit 0, 1, 2... for GL_TEXTURE0, GL_TEXTURE1, GL_TEXTURE2...
+    void activeTexture(int unit);
+    // binds a texture to the given unit, switching the active unit only if needed. GL_TEXTURE_2D and
+    // GL_TEXTURE_3D textures are supported. Texture updates apply to the active unit: call
+    // activeTexture() first, the unit may not be active if the texture was already bound.
+    void bindTexture(int unit, GLuint texture, GLenum target = GL_TEXTURE_2D);
+
+    // GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST and GL_STENCIL_TEST are tracked, other
+    // capabilities are always issued
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void blendFunc(GLenum source_factor, GLenum destination_factor);
+    void depthFunc(GLenum function);
+    void depthMask(GLboolean enabled);
+
+    // uniforms of the program in use. @return true if the value changed, and so was uploaded
+    bool uniform1i(GLint location, GLint value);
+    bool uniform3fv(GLint location, const glm::vec3& value);
+    bool uniform4fv(GLint location, const glm::vec4& value);
+    bool uniformMatrix4fv(GLint location, const glm::mat4& value);
+
+    // delete the object, and forget it where it was bound: GL unbinds deleted objects
+    void deleteProgram(GLuint program);
+    void deleteVertexArray(GLuint vertex_array);
+    void deleteBuffer(GLuint buffer);
+    void deleteTexture(GLuint texture);
+
+    // state changing calls issued to GL, and dropped because they changed nothing, since resetCounters()
+    inline uint64_t getIssuedCalls() const { return issued_calls_; }
+    inline uint64_t getFilteredCalls() const { return filtered_calls_; }
+    inline void resetCounters() {
+        issued_calls_ = 0;
+        filtered_calls_ = 0;
+    }
+
+private:
+    // a value no object id or enum takes here, standing for "unknown"
+    static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    enum Capability { Blend = 0, CullFace, DepthTest, ScissorTest, StencilTest, CapabilityCount };
+    // @return the tracked capability index, or -1
+    static int capabilityIndex(GLenum capability);
+    void setCapability(GLenum capability, bool enabled);
+
+    // @return true, and updates the shadowed value, if it differs from the given one
+    bool changes(GLuint& shadowed, GLuint value);
+    bool setUniform(GLint location, const void* value, size_t size);
+
+    GLuint program_;
+    GLuint vertex_array_;
+    GLuint array_buffer_;
+    GLuint element_array_buffer_;
+    GLuint uniform_buffer_;
+    struct BufferRange {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+    BufferRange uniform_buffer_ranges_[MAX_UNIFORM_BUFFER_BINDINGS];
+    GLuint active_texture_unit_;
+    // per unit, the 2D then the 3D texture
+    GLuint textures_[MAX_TEXTURE_UNITS][2];
+    GLuint capabilities_[CapabilityCount];
+    GLuint blend_source_;
+    GLuint blend_destination_;
+    GLuint depth_function_;
+    GLuint depth_mask_;
+
+    // uniform values by program and location
+    struct UniformValue {
+        float data[16];
+        size_t size = 0;
+    };
+    std::unordered_map<uint64_t, UniformValue> uniforms_;
+
+    uint64_t issued_calls_ = 0;
+    uint64_t filtered_calls_ = 0;
+};
+
+#endif //MY_MOBILE_APP_GLSTATECACHE_H
@@ -0,0 +1,269 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+
+// the streams of a Separate page, one after the other: positions, normals, tangents, uvs. Their
+// bytes per vertex, the offset of a stream being the sum of the previous ones' times the capacity.
+static constexpr size_t SEPARATE_STREAM_SIZES[] = {
+        sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec4), sizeof(glm::vec2)};
+
+static size_t GetVertexSize(VertexLayout layout)
+{
+    switch(layout) {
+        case VertexLayout::Packed: return sizeof(PackedVertex);
+        case VertexLayout::PackedQuantized: return sizeof(QuantizedVertex);
+        default: return sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec4) + sizeof(glm::vec2);
+    }
+}
+
+static uint32_t GetVertexCount(const ModelMesh& mesh)
+{
+    if(mesh._vertex_layout == VertexLayout::Separate) {
+        return static_cast<uint32_t>(mesh._vertices.size());
+    }
+    return static_cast<uint32_t>(mesh._packed_vertices.size() / GetVertexSize(mesh._vertex_layout));
+}
+
+// writes a vertex stream into a Separate page's buffer, bound to GL_COPY_WRITE_BUFFER. An empty one
+// is filled with the attribute's constant value, which draws of the mesh on its own would read.
+template<typename T>
+static size_t UploadPooledStream(const SharedArray<T>& stream, uint32_t vertex_count, const T& missing_value,
+                                 size_t offset)
+{
+    if(!stream.empty()) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, vertex_count * sizeof(T), stream.data());
+    } else {
+        const std::vector<T> values(vertex_count, missing_value);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, vertex_count * sizeof(T), values.data());
+    }
+    return vertex_count * sizeof(T);
+}
+
+GeometryPool::GeometryPool(GLStateCache& gl_state, AttributeSetup setup_attributes)
+: gl_state_(gl_state)
+, setup_attributes_(std::move(setup_attributes))
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+    for(auto& page : pages_) {
+        gl_state_.deleteVertexArray(page->vertex_array_id);
+        gl_state_.deleteBuffer(page->vertex_buffer_id);
+        gl_state_.deleteBuffer(page->index_buffer_id);
+    }
+}
+
+bool GeometryPool::add(ModelMesh& mesh, size_t& uploaded_bytes)
+{
+    const uint32_t vertex_count = GetVertexCount(mesh);
+    const size_t index_count = mesh._indices.size() + mesh._lod_indices.size();
+    if(vertex_count == 0 || vertex_count > MAX_PAGE_VERTICES || index_count == 0) {
+        return false;
+    }
+    if(mesh._vertex_layout == VertexLayout::Separate) {
+        // the streams are laid out by vertex, so each needs one per vertex, or none
+        auto fits = [vertex_count](size_t stream_size) { return stream_size == 0 || stream_size == vertex_count; };
+        if(!fits(mesh._normals.size()) || !fits(mesh._tangents.size()) || !fits(mesh._tex_coords.size())) {
+            return false;
+        }
+    }
+
+    // the first page of the mesh's layout with room for it, or a new one
+    Page* page = nullptr;
+    uint32_t first_vertex = 0;
+    uint32_t first_index = 0;
+    for(auto& candidate : pages_) {
+        if(candidate->layout == mesh._vertex_layout
+           && allocate(*candidate, vertex_count, static_cast<uint32_t>(index_count), first_vertex, first_index)) {
+            page = candidate.get();
+            break;
+        }
+    }
+    if(page == nullptr) {
+        pages_.push_back(std::make_unique<Page>());
+        page = pages_.back().get();
+        page->layout = mesh._vertex_layout;
+        glGenVertexArrays(1, &page->vertex_array_id);
+        allocate(*page, vertex_count, static_cast<uint32_t>(index_count), first_vertex, first_index);
+    }
+
+    uploaded_bytes += uploadVertices(*page, mesh, first_vertex);
+    uploaded_bytes += uploadIndices(*page, mesh, first_vertex, first_index);
+    gl_state_.bindVertexArray(0);
+
+    mesh._vertex_array_id = page->vertex_array_id;
+    mesh._vertex_buffer_id = page->vertex_buffer_id;
+    mesh._index_buffer_id = page->index_buffer_id;
+    mesh._index_type = GL_UNSIGNED_SHORT;
+    mesh._first_vertex = first_vertex;
+    mesh._first_index = first_index;
+    page->meshes.push_back(&mesh);
+    allocations_[&mesh] = {page, first_vertex, vertex_count, first_index, static_cast<uint32_t>(index_count)};
+    return true;
+}
+
+bool GeometryPool::remove(ModelMesh& mesh)
+{
+    auto found = allocations_.find(&mesh);
+    if(found == allocations_.end()) {
+        return false;
+    }
+    const Allocation allocation = found->second;
+    allocations_.erase(found);
+
+    Page& page = *allocation.page;
+    page.vertices.Free(allocation.first_vertex, allocation.vertex_count);
+    page.indices.Free(allocation.first_index, allocation.index_count);
+    page.meshes.erase(std::find(page.meshes.begin(), page.meshes.end(), &mesh));
+
+    mesh._vertex_array_id = 0;
+    mesh._vertex_buffer_id = 0;
+    mesh._index_buffer_id = 0;
+    mesh._first_vertex = 0;
+    mesh._first_index = 0;
+
+    // an empty page's buffers go with it
+    if(page.meshes.empty()) {
+        gl_state_.deleteVertexArray(page.vertex_array_id);
+        gl_state_.deleteBuffer(page.vertex_buffer_id);
+        gl_state_.deleteBuffer(page.index_buffer_id);
+        pages_.erase(std::find_if(pages_.begin(), pages_.end(),
+                                  [&page](const std::unique_ptr<Page>& other) { return other.get() == &page; }));
+    }
+    return true;
+}
+
+bool GeometryPool::allocate(Page& page, uint32_t vertex_count, uint32_t index_count, uint32_t& first_vertex,
+                            uint32_t& first_index)
+{
+    first_vertex = page.vertices.Allocate(vertex_count);
+    if(first_vertex == OffsetAllocator::NO_SPACE) {
+        const uint32_t capacity = page.vertices.GetSize();
+        if(capacity >= MAX_PAGE_VERTICES) {
+            return false;
+        }
+        growVertices(page, std::min(MAX_PAGE_VERTICES, std::max(2 * capacity, capacity + vertex_count)));
+        first_vertex = page.vertices.Allocate(vertex_count);
+        if(first_vertex == OffsetAllocator::NO_SPACE) {
+            return false;
+        }
+    }
+    first_index = page.indices.Allocate(index_count);
+    if(first_index == OffsetAllocator::NO_SPACE) {
+        // the added space joins the free range at the end, so it's large enough
+        const uint32_t capacity = page.indices.GetSize();
+        growIndices(page, std::max(2 * capacity, capacity + index_count));
+        first_index = page.indices.Allocate(index_count);
+    }
+    return true;
+}
+
+void GeometryPool::growVertices(Page& page, uint32_t vertex_capacity)
+{
+    const uint32_t old_capacity = page.vertices.GetSize();
+    const size_t vertex_size = GetVertexSize(page.layout);
+
+    GLuint buffer_id = 0;
+    glGenBuffers(1, &buffer_id);
+    gl_state_.bindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * vertex_size, nullptr, GL_STATIC_DRAW);
+    if(page.vertex_buffer_id != 0) {
+        // the copy stays on the gpu. Separate streams move apart, to their offsets at the new capacity.
+        gl_state_.bindBuffer(GL_COPY_READ_BUFFER, page.vertex_buffer_id);
+        if(page.layout == VertexLayout::Separate) {
+            size_t stream_offset = 0;
+            for(size_t stream_size : SEPARATE_STREAM_SIZES) {
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stream_offset * old_capacity,
+                                    stream_offset * vertex_capacity, stream_size * old_capacity);
+                stream_offset += stream_size;
+            }
+        } else {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_capacity * vertex_size);
+        }
+    }
+
+    // the vertex array's attributes point into the new buffer, so the old one can go
+    gl_state_.bindVertexArray(page.vertex_array_id);
+    gl_state_.bindBuffer(GL_ARRAY_BUFFER, buffer_id);
+    setup_attributes_(page.layout, vertex_capacity);
+    if(page.vertex_buffer_id != 0) {
+        gl_state_.deleteBuffer(page.vertex_buffer_id);
+    }
+    page.vertex_buffer_id = buffer_id;
+    page.vertices.Grow(vertex_capacity);
+    for(ModelMesh* mesh : page.meshes) {
+        mesh->_vertex_buffer_id = buffer_id;
+    }
+}
+
+void GeometryPool::growIndices(Page& page, uint32_t index_capacity)
+{
+    const uint32_t old_capacity = page.indices.GetSize();
+
+    GLuint buffer_id = 0;
+    glGenBuffers(1, &buffer_id);
+    gl_state_.bindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * sizeof(uint16_t), nullptr, GL_STATIC_DRAW);
+    if(page.index_buffer_id != 0) {
+        gl_state_.bindBuffer(GL_COPY_READ_BUFFER, page.index_buffer_id);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_capacity * sizeof(uint16_t));
+    }
+
+    // the index buffer binding is the vertex array's
+    gl_state_.bindVertexArray(page.vertex_array_id);
+    gl_state_.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_id);
+    if(page.index_buffer_id != 0) {
+        gl_state_.deleteBuffer(page.index_buffer_id);
+    }
+    page.index_buffer_id = buffer_id;
+    page.indices.Grow(index_capacity);
+    for(ModelMesh* mesh : page.meshes) {
+        mesh->_index_buffer_id = buffer_id;
+    }
+}
+
+size_t GeometryPool::uploadVertices(const Page& page, const ModelMesh& mesh, uint32_t first_vertex)
+{
+    const uint32_t vertex_count = GetVertexCount(mesh);
+    gl_state_.bindBuffer(GL_COPY_WRITE_BUFFER, page.vertex_buffer_id);
+    if(page.layout != VertexLayout::Separate) {
+        const size_t vertex_size = GetVertexSize(page.layout);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, first_vertex * vertex_size, vertex_count * vertex_size,
+                        mesh._packed_vertices.data());
+        return vertex_count * vertex_size;
+    }
+
+    const size_t capacity = page.vertices.GetSize();
+    size_t stream_offset = 0;
+    size_t uploaded_bytes = 0;
+    uploaded_bytes += UploadPooledStream(mesh._vertices, vertex_count, glm::vec3(0.0f),
+                                         stream_offset * capacity + first_vertex * sizeof(glm::vec3));
+    stream_offset += sizeof(glm::vec3);
+    uploaded_bytes += UploadPooledStream(mesh._normals, vertex_count, glm::vec3(0.0f),
+                                         stream_offset * capacity + first_vertex * sizeof(glm::vec3));
+    stream_offset += sizeof(glm::vec3);
+    uploaded_bytes += UploadPooledStream(mesh._tangents, vertex_count, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                                         stream_offset * capacity + first_vertex * sizeof(glm::vec4));
+    stream_offset += sizeof(glm::vec4);
+    uploaded_bytes += UploadPooledStream(mesh._tex_coords, vertex_count, glm::vec2(0.0f),
+                                         stream_offset * capacity + first_vertex * sizeof(glm::vec2));
+    return uploaded_bytes;
+}
+
+size_t GeometryPool::uploadIndices(const Page& page, const ModelMesh& mesh, uint32_t first_vertex,
+                                   uint32_t first_index)
+{
+    // the full mesh's indices, then its levels of detail's, pointing at its range of the vertices
+    std::vector<uint16_t> indices;
+    indices.reserve(mesh._indices.size() + mesh._lod_indices.size());
+    for(const auto* stream : {&mesh._indices, &mesh._lod_indices}) {
+        for(Index index : *stream) {
+            indices.push_back(static_cast<uint16_t>(first_vertex + index));
+        }
+    }
+    gl_state_.bindBuffer(GL_COPY_WRITE_BUFFER, page.index_buffer_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first_index * sizeof(uint16_t), indices.size() * sizeof(uint16_t),
+                    indices.data());
+    return indices.size() * sizeof(uint16_t);
+}
@@ -0,0 +1,95 @@
+#ifndef MY_MOBILE_APP_GEOMETRYPOOL_H
+#define MY_MOBILE_APP_GEOMETRYPOOL_H
+
+#include <GLES3/gl3.h>
+
+#include "GLStateCache.h"
+#include "Model.h"
+#include "OffsetAllocator.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * Packs the vertices and indices of many meshes into a few large gpu buffers, rather than a vertex
+ * buffer, an index buffer and a vertex array per mesh: the meshes of a vertex layout share a page's
+ * vertex array, which is bound once for all their draws, and the driver tracks a few buffers.
+ *
+ * A page holds up to MAX_PAGE_VERTICES vertices, so its indices stay 16-bit, and its buffers grow
+ * as meshes are added. A mesh gets a range of each, from an OffsetAllocator. GLES 3.0 draws have no
+ * base vertex, so a mesh's indices are offset by its first vertex when they're uploaded; draws then
+ * only address the mesh's range of the index buffer (see ModelMesh::_first_index).
+ */
+class GeometryPool
+{
+public:
+    // the most vertices of a page, as many as 16-bit indices number
+    static constexpr uint32_t MAX_PAGE_VERTICES = 65536;
+
+    /*!
+     * Sets up the vertex attributes of a page's vertex array, with it and the page's vertex buffer
+     * bound. Separate streams are laid out one after the other, each vertex_capacity long.
+     */
+    using AttributeSetup = std::function<void(VertexLayout layout, size_t vertex_capacity)>;
+
+    GeometryPool(GLStateCache& gl_state, AttributeSetup setup_attributes);
+    ~GeometryPool();
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    /*!
+     * Uploads the mesh's vertices and indices into a page of its vertex layout, and points its gpu
+     * resource ids at the page's.
+     * @param uploaded_bytes increased by the bytes uploaded
+     * @return false if the mesh has too many vertices for a page, or none: it needs buffers of its own
+     */
+    bool add(ModelMesh& mesh, size_t& uploaded_bytes);
+
+    /*!
+     * Frees the mesh's ranges, and resets its gpu resource ids.
+     * @return false if the mesh isn't in the pool
+     */
+    bool remove(ModelMesh& mesh);
+
+    inline size_t getPageCount() const { return pages_.size(); }
+
+private:
+    struct Page {
+        VertexLayout layout = VertexLayout::Separate;
+        GLuint vertex_array_id = 0;
+        GLuint vertex_buffer_id = 0;
+        GLuint index_buffer_id = 0;
+        // the buffers' sizes, in vertices and indices
+        OffsetAllocator vertices;
+        OffsetAllocator indices;
+        // the meshes in the page, whose ids follow the buffers when they grow
+        std::vector<ModelMesh*> meshes;
+    };
+    struct Allocation {
+        Page* page = nullptr;
+        uint32_t first_vertex = 0;
+        uint32_t vertex_count = 0;
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+    };
+
+    // a range of the page's buffers, growing them as needed. @return false if the vertices don't fit
+    bool allocate(Page& page, uint32_t vertex_count, uint32_t index_count, uint32_t& first_vertex, uint32_t& first_index);
+    // reallocates the page's buffers with room for more, keeping their contents
+    void growVertices(Page& page, uint32_t vertex_capacity);
+    void growIndices(Page& page, uint32_t index_capacity);
+    // write the mesh's vertices and indices into its ranges of the page's buffers. @return the bytes written
+    size_t uploadVertices(const Page& page, const ModelMesh& mesh, uint32_t first_vertex);
+    size_t uploadIndices(const Page& page, const ModelMesh& mesh, uint32_t first_vertex, uint32_t first_index);
+
+    GLStateCache& gl_state_;
+    AttributeSetup setup_attributes_;
+    std::vector<std::unique_ptr<Page>> pages_;
+    std::unordered_map<const ModelMesh*, Allocation> allocations_;
+};
+
+#endif //MY_MOBILE_APP_GEOMETRYPOOL_H
@@ -1,49 +1,372 @@
 
 #include "GltfMeshModelLoader.h"
+#include "AndroidOut.h"
+#include "JobSystem.h"
+#include "Ktx2.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
 #include "Model.h"
+#include "TextureCache.h"
 
+#ifdef __ANDROID__
 #define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+#endif
 #include "tiny_gltf.h"
 
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <memory>
 #include <iostream>
 
 
-struct VertexAttribute
+/*!
+ * Where a glTF buffer's bytes live once the file is loaded. When meshes reference the buffers
+ * directly, storage keeps them alive.
+ */
+struct SourceBuffer
 {
-    const unsigned char* data_ptr = nullptr;
-    size_t data_size = 0;
-    int byte_stride = 0;
-    bool is_normalized = false;
+    std::shared_ptr<const void> storage;
+    const unsigned char* data = nullptr;
+    size_t size = 0;
 };
 
-bool GetVertexAttributeBuffer(tinygltf::Model& model, int accessor_idx, VertexAttribute& data_buffer)
+/*!
+ * Encoded images collected while tinygltf parses the document, decoded afterwards in parallel.
+ */
+struct DeferredImages
 {
-    if(accessor_idx < 0 || accessor_idx > model.accessors.size() - 1) {
-        // TODO: log error
+    std::vector<std::vector<unsigned char>> encoded; // by image index, empty when not deferred
+};
+
+// tinygltf image loader callback: keeps a copy of the encoded image instead of decoding it.
+static bool DeferImageDecoding(tinygltf::Image* image, const int image_idx, std::string* err, std::string* warn,
+                               int req_width, int req_height, const unsigned char* bytes, int size, void* user_data)
+{
+    auto* deferred = static_cast<DeferredImages*>(user_data);
+    if(image_idx < 0 || size <= 0) {
+        return tinygltf::LoadImageData(image, image_idx, err, warn, req_width, req_height, bytes, size, nullptr);
+    }
+    if(deferred->encoded.size() <= static_cast<size_t>(image_idx)) {
+        deferred->encoded.resize(image_idx + 1);
+    }
+    deferred->encoded[image_idx].assign(bytes, bytes + size);
+    return true;
+}
+
+using SharedImages = std::vector<std::shared_ptr<const TextureCache::Image>>;
+
+/*!
+ * Loads the images having a KTX2 version next to them (same path, .ktx2 extension) in a format the
+ * gpu samples, rather than decoding them, across the shared job system. Their encoded source is
+ * dropped.
+ * @param images set to the images loaded, by image index
+ */
+static void LoadKtx2Images(const tinygltf::Model& model, const std::string& base_dir, const std::vector<GLenum>& formats,
+                           DeferredImages& deferred, SharedImages& images)
+{
+    auto& cache = TextureCache::GetShared();
+    JobSystem::GetShared().ParallelFor(model.images.size(), [&](size_t i) {
+        const std::string& uri = model.images[i].uri;
+        const size_t extension = uri.find_last_of('.');
+        if(uri.compare(0, 5, "data:") == 0 || extension == std::string::npos) {
+            return;
+        }
+        std::vector<unsigned char> bytes;
+        std::string err;
+        if(!tinygltf::ReadWholeFile(&bytes, &err, base_dir + uri.substr(0, extension) + ".ktx2", nullptr)) {
+            return;
+        }
+        const uint64_t key = TextureCache::MakeKey(bytes.data(), bytes.size());
+        auto image = cache.Find(key);
+        if(!image) {
+            TextureCache::Image ktx2_image;
+            if(!Ktx2::Read(bytes.data(), bytes.size(), ktx2_image)) {
+                aout << "Warn: unsupported KTX2 file for image " << uri << std::endl;
+                return;
+            }
+            ktx2_image.key = key;
+            image = cache.Add(std::move(ktx2_image));
+        }
+        if(image->compressed_format != 0
+           && std::find(formats.begin(), formats.end(), image->compressed_format) == formats.end()) {
+            // the source image is decoded instead
+            return;
+        }
+        images[i] = std::move(image);
+        if(i < deferred.encoded.size()) {
+            std::vector<unsigned char>().swap(deferred.encoded[i]);
+        }
+    });
+}
+
+/*!
+ * Decodes the deferred images of the model, across the shared job system. Images the texture cache
+ * already holds, e.g. for another model, are shared rather than decoded again.
+ * @param images set to the decoded images, by image index. The pixels move out of the tinygltf model.
+ * @return false if any image fails to decode
+ */
+static bool DecodeDeferredImages(tinygltf::Model& model, DeferredImages& deferred, SharedImages& images)
+{
+    const size_t image_count = std::min(deferred.encoded.size(), model.images.size());
+    std::vector<char> decoded(image_count, 1);
+    auto& cache = TextureCache::GetShared();
+    JobSystem::GetShared().ParallelFor(image_count, [&](size_t i) {
+        auto& encoded = deferred.encoded[i];
+        if(encoded.empty()) {
+            return;
+        }
+        const uint64_t key = TextureCache::MakeKey(encoded.data(), encoded.size());
+        images[i] = cache.Find(key);
+        if(!images[i]) {
+            std::string err;
+            std::string warn;
+            auto& image = model.images[i];
+            decoded[i] = tinygltf::LoadImageData(&image, static_cast<int>(i), &err, &warn, 0, 0,
+                                                 encoded.data(), static_cast<int>(encoded.size()), nullptr);
+            if(decoded[i]) {
+                TextureCache::Image decoded_image;
+                decoded_image.key = key;
+                decoded_image.width = image.width;
+                decoded_image.height = image.height;
+                decoded_image.pixels = std::move(image.image);
+                images[i] = cache.Add(std::move(decoded_image));
+            } else {
+                aout << "Err: could not decode image " << i << ": " << err << std::endl;
+            }
+        }
+        std::vector<unsigned char>().swap(encoded);
+    });
+
+    // the images tinygltf decoded itself aren't shared with other models
+    for(size_t i = 0; i < model.images.size(); ++i) {
+        if(!images[i] && !model.images[i].image.empty()) {
+            auto image = std::make_shared<TextureCache::Image>();
+            image->width = model.images[i].width;
+            image->height = model.images[i].height;
+            image->pixels = std::move(model.images[i].image);
+            images[i] = std::move(image);
+        }
+    }
+    return std::all_of(decoded.begin(), decoded.end(), [](char ok) { return ok != 0; });
+}
+
+static bool HasExtension(const std::string& path, const std::string& extension)
+{
+    if(path.size() < extension.size()) {
+        return false;
+    }
+    return std::equal(extension.rbegin(), extension.rend(), path.rbegin(), [](char a, char b) {
+        return std::tolower(a) == std::tolower(b);
+    });
+}
+
+/*!
+ * Finds the BIN chunk of a binary glTF (.glb) file.
+ * @return false if the data isn't a glb file, or it has no BIN chunk
+ */
+static bool FindGlbBinaryChunk(const unsigned char* data, size_t size, size_t& chunk_offset, size_t& chunk_length)
+{
+    constexpr uint32_t kGlbMagic = 0x46546C67;     // "glTF"
+    constexpr uint32_t kBinChunkType = 0x004E4942; // "BIN\0"
+    auto read_u32 = [data](size_t offset) {
+        uint32_t value;
+        memcpy(&value, data + offset, sizeof(value));
+        return value;
+    };
+    // 12-byte header followed by the JSON chunk (8-byte chunk header + content)
+    if(size < 20 || read_u32(0) != kGlbMagic) {
+        return false;
+    }
+    size_t bin_header = 20 + size_t(read_u32(12));
+    if(bin_header + 8 > size || read_u32(bin_header + 4) != kBinChunkType) {
+        return false;
+    }
+    chunk_offset = bin_header + 8;
+    chunk_length = read_u32(bin_header);
+    return chunk_offset + chunk_length <= size;
+}
+
+/*!
+ * Locates the elements of an accessor inside its source buffer.
+ * @return false if the accessor is invalid, or isn't made of the expected component type and count
+ */
+static bool LocateAccessor(
+        const tinygltf::Model& model,
+        const std::vector<SourceBuffer>& buffers,
+        int accessor_idx,
+        int component_type,
+        int type,
+        const unsigned char*& data,
+        size_t& byte_stride,
+        size_t& count)
+{
+    if(accessor_idx < 0 || accessor_idx >= int(model.accessors.size())) {
         return false;
     }
     const auto &accessor = model.accessors[accessor_idx];
+    if(accessor.bufferView < 0 || accessor.componentType != component_type || accessor.type != type) {
+        aout << "Err: unsupported accessor " << accessor_idx << std::endl;
+        return false;
+    }
     const auto &buffer_view = model.bufferViews[accessor.bufferView];
-    const auto &buffer = model.buffers[buffer_view.buffer];
-
-    //data_buffer.data_ptr = buffer.data.data() + buffer_view.byteOffset + accessor.byteOffset;
-    //data_buffer.data_size = buffer.data.size() - (buffer_view.byteOffset + accessor.byteOffset);
-    data_buffer.data_ptr = &buffer.data.at(0) + buffer_view.byteOffset;
-    data_buffer.data_size = buffer_view.byteLength;
-    data_buffer.byte_stride = accessor.ByteStride(buffer_view);
-    data_buffer.is_normalized = accessor.normalized;
+    const auto &buffer = buffers[buffer_view.buffer];
+    const int stride = accessor.ByteStride(buffer_view);
+    if(stride <= 0 || accessor.count == 0) {
+        return false;
+    }
+    const size_t offset = buffer_view.byteOffset + accessor.byteOffset;
+    const size_t element_size = size_t(tinygltf::GetComponentSizeInBytes(component_type))
+                                * size_t(tinygltf::GetNumComponentsInType(type));
+    if(buffer.data == nullptr || offset + size_t(stride) * (accessor.count - 1) + element_size > buffer.size) {
+        aout << "Err: accessor " << accessor_idx << " is out of its buffer's bounds" << std::endl;
+        return false;
+    }
+    data = buffer.data + offset;
+    byte_stride = size_t(stride);
+    count = accessor.count;
+    return true;
+}
 
-    if(data_buffer.data_size <= 0) {
-        // TODO: log error
+/*!
+ * Reads a float vertex attribute. Tightly packed attributes are referenced in place when
+ * reference_source is set, otherwise (or when interleaved) they're copied.
+ */
+template<typename T>
+static bool ReadVertexAttribute(
+        const tinygltf::Model& model,
+        const std::vector<SourceBuffer>& buffers,
+        int accessor_idx,
+        int type,
+        bool reference_source,
+        SharedArray<T>& attribute)
+{
+    const unsigned char* data = nullptr;
+    size_t byte_stride = 0;
+    size_t count = 0;
+    if(!LocateAccessor(model, buffers, accessor_idx, TINYGLTF_COMPONENT_TYPE_FLOAT, type, data, byte_stride, count)) {
         return false;
     }
+    const auto& storage = buffers[model.bufferViews[model.accessors[accessor_idx].bufferView].buffer].storage;
+    if(reference_source && storage && byte_stride == sizeof(T)
+       && reinterpret_cast<uintptr_t>(data) % alignof(T) == 0) {
+        attribute = SharedArray<T>::View(storage, reinterpret_cast<const T*>(data), count);
+        return true;
+    }
+    std::vector<T> values(count);
+    for(size_t i = 0; i < count; ++i) {
+        memcpy(&values[i], data + i * byte_stride, sizeof(T));
+    }
+    attribute = std::move(values);
+    return true;
+}
 
+/*!
+ * Reads the index buffer of a primitive of vertex_count vertices. Tightly packed 16 and 32-bit
+ * indices can be referenced in place. Copied ones are 16-bit when the vertices allow, 8-bit ones
+ * being widened.
+ */
+static bool ReadIndices(
+        const tinygltf::Model& model,
+        const std::vector<SourceBuffer>& buffers,
+        int accessor_idx,
+        size_t vertex_count,
+        bool reference_source,
+        IndexArray& indices)
+{
+    if(accessor_idx < 0 || accessor_idx >= int(model.accessors.size())) {
+        return false;
+    }
+    const int component_type = model.accessors[accessor_idx].componentType;
+    if(component_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && component_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+       && component_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+        aout << "Err: unsupported index type " << component_type << std::endl;
+        return false;
+    }
+    const unsigned char* data = nullptr;
+    size_t byte_stride = 0;
+    size_t count = 0;
+    if(!LocateAccessor(model, buffers, accessor_idx, component_type, TINYGLTF_TYPE_SCALAR, data, byte_stride, count)) {
+        return false;
+    }
+    const auto& storage = buffers[model.bufferViews[model.accessors[accessor_idx].bufferView].buffer].storage;
+    if(component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        if(reference_source && storage && byte_stride == sizeof(uint16_t)
+           && reinterpret_cast<uintptr_t>(data) % alignof(uint16_t) == 0) {
+            indices = SharedArray<uint16_t>::View(storage, reinterpret_cast<const uint16_t*>(data), count);
+            return true;
+        }
+    } else if(component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+        if(reference_source && storage && byte_stride == sizeof(uint32_t)
+           && reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) == 0) {
+            indices = SharedArray<uint32_t>::View(storage, reinterpret_cast<const uint32_t*>(data), count);
+            return true;
+        }
+    }
+    std::vector<Index> values(count);
+    for(size_t i = 0; i < count; ++i) {
+        if(component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+            values[i] = data[i * byte_stride];
+        } else if(component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+            uint16_t index = 0;
+            memcpy(&index, data + i * byte_stride, sizeof(index));
+            values[i] = index;
+        } else {
+            memcpy(&values[i], data + i * byte_stride, sizeof(Index));
+        }
+    }
+    // 8 and 16-bit indices fit in 16 bits whatever the vertices
+    indices = IndexArray(std::move(values), component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT
+                                            ? vertex_count : IndexArray::MAX_SHORT_VERTICES);
     return true;
 }
 
+/*!
+ * Appends a primitive's vertex stream to its mesh's, the vertices of either that lack it getting
+ * the given value instead.
+ */
+template<typename T>
+static void AppendVertexStream(SharedArray<T>& stream, size_t vertex_count,
+                               const SharedArray<T>& appended, size_t appended_count, const T& value)
+{
+    if(stream.empty() && appended.empty()) {
+        return;
+    }
+    auto& values = stream.Edit();
+    values.resize(vertex_count, value);
+    if(appended.size() == appended_count) {
+        values.insert(values.end(), appended.begin(), appended.end());
+    } else {
+        values.resize(vertex_count + appended_count, value);
+    }
+}
+
+/*!
+ * Computes smooth normals for vertices lacking them: each vertex's is the sum of its triangles'
+ * normals, weighted by their area, normalized.
+ */
+template<typename Indices>
+static std::vector<glm::vec3> ComputeNormals(const SharedArray<glm::vec3>& vertices, const Indices& indices)
+{
+    std::vector<glm::vec3> normals(vertices.size(), glm::vec3(0.0f));
+    for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const Index a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        // the cross product's length is twice the triangle's area
+        const glm::vec3 normal = glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]);
+        normals[a] += normal;
+        normals[b] += normal;
+        normals[c] += normal;
+    }
+    for(auto& normal : normals) {
+        const float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+    return normals;
+}
+
 static void QuatToAngleAxis(const std::vector<double>& quaternion,
         float& angle_radians,
         glm::vec3& axis) {
@@ -60,6 +383,7 @@ static void QuatToAngleAxis(const std::vector<double>& quaternion,
 
 static void ConvertTexture(
         const tinygltf::Model& model,
+        const SharedImages& images,
         const tinygltf::Texture& source_texture,
         Texture& model_texture)
 {
@@ -72,12 +396,21 @@ static void ConvertTexture(
         model_texture._sampler_wrap_t = sampler.wrapT;
     }
     // image parameters
-    auto texture_image = model.images[source_texture.source];
+    if(source_texture.source < 0 || source_texture.source >= static_cast<int>(images.size())) {
+        return;
+    }
+    const auto& texture_image = model.images[source_texture.source];
     model_texture._name = texture_image.name;
-    model_texture._image_data = texture_image.image;
-    model_texture._image_width = texture_image.width;
-    model_texture._image_height = texture_image.height;
     model_texture._image_uri = texture_image.uri;
+    // the pixels are shared by every texture using the image, rather than copied into each
+    if(const auto& image = images[source_texture.source]) {
+        model_texture._image_data = SharedArray<u_char>::View(image, image->pixels.data(), image->pixels.size());
+        model_texture._image_width = image->width;
+        model_texture._image_height = image->height;
+        model_texture._mip_levels = image->mip_levels;
+        model_texture._compressed_format = image->compressed_format;
+        model_texture._cache_key = image->key;
+    }
 }
 
 static void ConvertSampler(const tinygltf::Sampler& source_sampler, Texture& model_texture)
@@ -88,6 +421,219 @@ static void ConvertSampler(const tinygltf::Sampler& source_sampler, Texture& mod
     model_texture._sampler_wrap_t = source_sampler.wrapT;
 }
 
+static void ConvertMaterial(
+        const tinygltf::Model& model,
+        const SharedImages& images,
+        const tinygltf::Material& material,
+        Material& model_material)
+{
+    model_material._name = material.name;
+    // --factors--
+    const auto& pbr = material.pbrMetallicRoughness;
+    if(pbr.baseColorFactor.size() == 4) {
+        model_material._base_color_factor = glm::vec4(pbr.baseColorFactor[0], pbr.baseColorFactor[1],
+                                                      pbr.baseColorFactor[2], pbr.baseColorFactor[3]);
+    }
+    model_material._metallic_factor = static_cast<float>(pbr.metallicFactor);
+    model_material._roughness_factor = static_cast<float>(pbr.roughnessFactor);
+    if(material.emissiveFactor.size() == 3) {
+        model_material._emissive_factor = glm::vec3(material.emissiveFactor[0], material.emissiveFactor[1],
+                                                    material.emissiveFactor[2]);
+    }
+    // --color texture --
+    if(material.pbrMetallicRoughness.baseColorTexture.index != -1) {
+        const auto& source_texture = model.textures[material.pbrMetallicRoughness.baseColorTexture.index];
+        ConvertTexture(model, images, source_texture, model_material._pbr_base_color_texture);
+        if(source_texture.sampler != -1) {
+            auto sampler = model.samplers[source_texture.sampler];
+            ConvertSampler(sampler, model_material._pbr_base_color_texture);
+        }
+    }
+    // --normal texture --
+    if(material.normalTexture.index != -1) {
+        const auto& source_texture = model.textures[material.normalTexture.index];
+        ConvertTexture(model, images, source_texture, model_material._normal_texture);
+        if(source_texture.sampler != -1) {
+            auto sampler = model.samplers[source_texture.sampler];
+            ConvertSampler(sampler, model_material._normal_texture);
+        }
+    }
+}
+
+/*!
+ * Converts a glTF mesh into an engine mesh. Its primitives become submeshes, sharing one set of
+ * vertex streams and one index buffer: each primitive's vertices are appended to the mesh's, and
+ * its indices offset to match. A mesh of one primitive keeps referencing the source buffers.
+ */
+static std::shared_ptr<ModelMesh> ConvertMesh(
+        const tinygltf::Model& model,
+        const std::vector<SourceBuffer>& source_buffers,
+        const SharedImages& images,
+        bool reference_source,
+        const tinygltf::Mesh& mesh)
+{
+    auto model_mesh = std::make_shared<ModelMesh>();
+    // the indices of a mesh of several primitives, widened while they're merged
+    std::vector<Index> merged_indices;
+    // the union of the primitives' position accessor bounds, when they all have them
+    BoundingBox bounds;
+    bool has_bounds = true;
+    // process mesh primitives
+    for (auto& primitive : mesh.primitives) {
+        if(primitive.mode != -1 && primitive.mode != TINYGLTF_MODE_TRIANGLES) {
+            aout << "Warn: skipping a primitive of mesh " << mesh.name << ", of unsupported mode " << primitive.mode << std::endl;
+            continue;
+        }
+        SharedArray<glm::vec3> vertices;
+        SharedArray<glm::vec3> normals;
+        SharedArray<glm::vec4> tangents;
+        SharedArray<glm::vec2> tex_coords;
+        // next, for each primitive extract vertex attributes
+        for(auto& attribute_pair : primitive.attributes) {
+            bool read = true;
+            if(attribute_pair.first == "POSITION") {
+                read = ReadVertexAttribute(model, source_buffers, attribute_pair.second, TINYGLTF_TYPE_VEC3,
+                                           reference_source, vertices);
+                // glTF requires the position accessor's min/max, which saves walking the vertices
+                const auto& accessor = model.accessors[attribute_pair.second];
+                if(read && accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+                    bounds.Extend(glm::vec3(accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]));
+                    bounds.Extend(glm::vec3(accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]));
+                } else {
+                    has_bounds = false;
+                }
+            } else if( attribute_pair.first == "NORMAL") {
+                read = ReadVertexAttribute(model, source_buffers, attribute_pair.second, TINYGLTF_TYPE_VEC3,
+                                           reference_source, normals);
+            } else if( attribute_pair.first == "TANGENT") {
+                read = ReadVertexAttribute(model, source_buffers, attribute_pair.second, TINYGLTF_TYPE_VEC4,
+                                           reference_source, tangents);
+            } else if( attribute_pair.first == "TEXCOORD_0") {
+                read = ReadVertexAttribute(model, source_buffers, attribute_pair.second, TINYGLTF_TYPE_VEC2,
+                                           reference_source, tex_coords);
+            }
+            if(!read) {
+                aout << "Err: could not read attribute " << attribute_pair.first << std::endl;
+            }
+        } // attribute_pair
+        if(vertices.empty()) {
+            continue;
+        }
+
+        // --now, extract the primitive's index buffer, or number its vertices when it has none--
+        IndexArray indices;
+        if(primitive.indices >= 0) {
+            if(!ReadIndices(model, source_buffers, primitive.indices, vertices.size(), reference_source, indices)) {
+                continue;
+            }
+        } else {
+            std::vector<Index> sequence(vertices.size());
+            for(size_t i = 0; i < sequence.size(); ++i) {
+                sequence[i] = static_cast<Index>(i);
+            }
+            indices = IndexArray(std::move(sequence), vertices.size());
+        }
+        bool in_range = true;
+        for(Index index : indices) {
+            in_range = in_range && index < vertices.size();
+        }
+        if(!in_range) {
+            aout << "Err: a primitive of mesh " << mesh.name << " indexes past its vertices" << std::endl;
+            continue;
+        }
+
+        // the primitives' indices are merged widened, and narrowed back once the vertex count is known
+        if(model_mesh->_submeshes.size() == 1) {
+            merged_indices = model_mesh->_indices.ToVector();
+        }
+        Submesh submesh;
+        submesh.first_index = static_cast<uint32_t>(merged_indices.size());
+        submesh.index_count = static_cast<uint32_t>(indices.size());
+        // process the primitive's material
+        int material_idx = primitive.material;
+        if(material_idx >= 0) {
+            ConvertMaterial(model, images, model.materials[material_idx], submesh.material);
+        }
+
+        if(model_mesh->_submeshes.empty()) {
+            model_mesh->_vertices = std::move(vertices);
+            model_mesh->_normals = std::move(normals);
+            model_mesh->_tangents = std::move(tangents);
+            model_mesh->_tex_coords = std::move(tex_coords);
+            model_mesh->_indices = std::move(indices);
+        } else {
+            const size_t vertex_count = model_mesh->_vertices.size();
+            const size_t appended_count = vertices.size();
+            // tangents are only kept when every primitive has them, they're computed for all otherwise
+            if(model_mesh->_tangents.size() == vertex_count && tangents.size() == appended_count) {
+                AppendVertexStream(model_mesh->_tangents, vertex_count, tangents, appended_count, glm::vec4(0.0f));
+            } else {
+                model_mesh->_tangents = SharedArray<glm::vec4>();
+            }
+            // the primitives lacking normals when others have them get smooth ones, zero ones would shade
+            // black
+            if(model_mesh->_normals.size() != vertex_count && normals.size() == appended_count) {
+                model_mesh->_normals = ComputeNormals(model_mesh->_vertices, merged_indices);
+            } else if(model_mesh->_normals.size() == vertex_count && normals.size() != appended_count) {
+                normals = ComputeNormals(vertices, indices);
+            }
+            AppendVertexStream(model_mesh->_normals, vertex_count, normals, appended_count, glm::vec3(0.0f));
+            AppendVertexStream(model_mesh->_tex_coords, vertex_count, tex_coords, appended_count, glm::vec2(0.0f));
+            AppendVertexStream(model_mesh->_vertices, vertex_count, vertices, appended_count, glm::vec3(0.0f));
+            for(Index index : indices) {
+                merged_indices.push_back(static_cast<Index>(vertex_count + index));
+            }
+        }
+        model_mesh->_submeshes.push_back(std::move(submesh));
+    } // for mesh primitive
+    if(model_mesh->_submeshes.size() > 1) {
+        model_mesh->_indices = IndexArray(std::move(merged_indices), model_mesh->_vertices.size());
+    }
+
+    if(has_bounds && !bounds.IsEmpty()) {
+        model_mesh->SetBounds(bounds);
+    } else {
+        model_mesh->ComputeBounds();
+    }
+    return model_mesh;
+}
+
+/*!
+ * @return the node's transform relative to its parent: either its matrix, or its TRS properties
+ */
+static glm::mat4 GetNodeLocalMatrix(const tinygltf::Node& node)
+{
+    if(node.matrix.size() == 16) {
+        // column-major, like glm
+        glm::mat4 matrix;
+        for(int i = 0; i < 16; ++i) {
+            matrix[i / 4][i % 4] = static_cast<float>(node.matrix[i]);
+        }
+        return matrix;
+    }
+
+    auto node_transform = glm::mat4(1.0);
+
+    if(!node.translation.empty()) {
+        node_transform = glm::translate(node_transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+    }
+    if(!node.rotation.empty()) {
+        float angle = 0.0f;
+        glm::vec3 axis(0.0);
+        QuatToAngleAxis(node.rotation, angle, axis);
+        node_transform = glm::rotate(node_transform, angle, axis);
+        //NOTE: If the mesh appears facing in the opposite direction...:
+        //To correct glTF's +Z forward into OpenGL’s -Z forward, apply a 180° rotation around Y:
+        //glm::mat4 orientation_fix = glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        //node_transform *= orientation_fix;
+        //or: node_transform = glm::rotate(node_transform, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    if(!node.scale.empty()) {
+        node_transform = glm::scale(node_transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+    }
+    return node_transform;
+}
+
 std::unique_ptr<Model> GltfMeshModelLoader::LoadModel(const std::string &resource_path)
 {
     tinygltf::Model model;
@@ -95,120 +641,172 @@ std::unique_ptr<Model> GltfMeshModelLoader::LoadModel(const std::string &resourc
     std::string err;
     std::string warn;
 
-    // TODO: depending on the file extension, determine if we must load either text or binary format.
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, resource_path);
-    //bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, argv[1]); // for binary glTF(.glb)
+    // images are decoded after parsing, in parallel, rather than one by one by the parser.
+    DeferredImages deferred_images;
+    loader.SetImageLoader(&DeferImageDecoding, &deferred_images);
+
+    // binary glTF is recognized by its extension, or on host builds by the file's magic.
+    bool is_binary = HasExtension(resource_path, ".glb");
+    bool ret = false;
+#ifdef __ANDROID__
+    // assets are read through the asset manager by tinygltf
+    if(is_binary) {
+        ret = loader.LoadBinaryFromFile(&model, &err, &warn, resource_path);
+    } else {
+        ret = loader.LoadASCIIFromFile(&model, &err, &warn, resource_path);
+    }
+#else
+    auto mapped_file = MappedFile::Open(resource_path);
+    size_t bin_chunk_offset = 0;
+    size_t bin_chunk_length = 0;
+    if(mapped_file) {
+        is_binary = FindGlbBinaryChunk(mapped_file->GetData(), mapped_file->GetSize(), bin_chunk_offset, bin_chunk_length);
+    }
+    if(is_binary && !mapped_file) {
+        ret = loader.LoadBinaryFromFile(&model, &err, &warn, resource_path);
+    } else if(is_binary) {
+        // parse straight from the mapping, rather than from a heap copy of the whole file
+        auto separator = resource_path.find_last_of('/');
+        std::string base_dir = separator == std::string::npos ? "" : resource_path.substr(0, separator);
+        ret = loader.LoadBinaryFromMemory(&model, &err, &warn,
+                                          mapped_file->GetData(),
+                                          static_cast<unsigned int>(mapped_file->GetSize()),
+                                          base_dir);
+    } else {
+        mapped_file.reset();
+        ret = loader.LoadASCIIFromFile(&model, &err, &warn, resource_path);
+    }
+#endif
 
     if (!warn.empty()) {
-        printf("Warn: %s\n", warn.c_str());
+        aout << "Warn: " << warn << std::endl;
         return nullptr;
     }
     if (!err.empty()) {
-        printf("Err: %s\n", err.c_str());
+        aout << "Err: " << err << std::endl;
         return nullptr;
     }
     if (!ret) {
-        printf("Failed to parse glTF\n");
+        aout << "Failed to parse glTF" << std::endl;
+        return nullptr;
+    }
+    // images with a KTX2 version the gpu samples are loaded from it, the others decoded
+    const auto separator = resource_path.find_last_of('/');
+    const std::string asset_dir = separator == std::string::npos ? "" : resource_path.substr(0, separator + 1);
+    SharedImages images(model.images.size());
+    LoadKtx2Images(model, asset_dir, _options.compressed_texture_formats, deferred_images, images);
+    if (!DecodeDeferredImages(model, deferred_images, images)) {
         return nullptr;
     }
 
+    // decide where the meshes will read buffer data from.
+    const bool reference_source = _options.reference_source_buffers;
+    std::vector<SourceBuffer> source_buffers(model.buffers.size());
+    for(size_t i = 0; i < model.buffers.size(); ++i) {
+        auto& buffer = model.buffers[i];
+        auto& source = source_buffers[i];
+#ifndef __ANDROID__
+        if(reference_source && mapped_file && i == 0 && buffer.uri.empty() && buffer.data.size() <= bin_chunk_length) {
+            // the glb BIN chunk: reference the mapped file, and drop tinygltf's copy of it
+            source.storage = mapped_file;
+            source.data = mapped_file->GetData() + bin_chunk_offset;
+            source.size = buffer.data.size();
+            std::vector<unsigned char>().swap(buffer.data);
+            continue;
+        }
+#endif
+        if(reference_source) {
+            // take the buffer over from tinygltf, so it outlives the tinygltf model
+            auto storage = std::make_shared<std::vector<unsigned char>>(std::move(buffer.data));
+            source.data = storage->data();
+            source.size = storage->size();
+            source.storage = std::move(storage);
+        } else {
+            // meshes copy what they need before the tinygltf model goes away
+            source.data = buffer.data.data();
+            source.size = buffer.data.size();
+        }
+    }
+
     auto engine_model = std::make_unique<Model>();
 
-    const tinygltf::Scene& scene = model.scenes[model.defaultScene];
-    for (int nodeIndex : scene.nodes) {
-        const tinygltf::Node& node = model.nodes[nodeIndex];
-        if (node.mesh < 0) {
+    // meshes referenced by several nodes are converted once, and drawn by each of them
+    std::vector<std::shared_ptr<ModelMesh>> converted_meshes(model.meshes.size());
+
+    // walk the whole node hierarchy of the default scene, parents before their children
+    const int scene_idx = model.defaultScene >= 0 ? model.defaultScene : 0;
+    if (scene_idx >= static_cast<int>(model.scenes.size())) {
+        aout << "Warn: glTF has no scene to load" << std::endl;
+        return engine_model;
+    }
+    const tinygltf::Scene& scene = model.scenes[scene_idx];
+    std::vector<char> visited(model.nodes.size(), 0);
+    std::vector<std::pair<int, SceneNode*>> pending_nodes; // node index, engine parent node
+    for (auto it = scene.nodes.rbegin(); it != scene.nodes.rend(); ++it) {
+        pending_nodes.emplace_back(*it, nullptr);
+    }
+    while (!pending_nodes.empty()) {
+        const int node_idx = pending_nodes.back().first;
+        SceneNode* parent = pending_nodes.back().second;
+        pending_nodes.pop_back();
+        if (node_idx < 0 || node_idx >= static_cast<int>(model.nodes.size()) || visited[node_idx]) {
+            // malformed: nodes must form a forest
             continue;
         }
-        // ==process this node's transform (this is the location in the world)==
-        auto mesh_transform = glm::mat4(1.0);
+        visited[node_idx] = 1;
 
-        if(!node.translation.empty()) {
-            mesh_transform = glm::translate(mesh_transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
-        }
-        if(!node.rotation.empty()) {
-            float angle = 0.0f;
-            glm::vec3 axis(0.0);
-            QuatToAngleAxis(node.rotation, angle, axis);
-            mesh_transform = glm::rotate(mesh_transform, angle, axis);
-            //NOTE: If the mesh appears facing in the opposite direction...:
-            //To correct glTF's +Z forward into OpenGL’s -Z forward, apply a 180° rotation around Y:
-            //glm::mat4 orientation_fix = glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            //mesh_transform *= orientation_fix;
-            //or: mesh_transform = glm::rotate(mesh_transform, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        }
-        if(!node.scale.empty()) {
-            mesh_transform = glm::scale(mesh_transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
-        }
+        const tinygltf::Node& node = model.nodes[node_idx];
+        // ==process this node's transform (this is the location relative to its parent)==
+        ModelNode* engine_node = engine_model->AddNode(node.name, parent);
+        engine_node->GetTransform().SetLocalMatrix(GetNodeLocalMatrix(node));
 
         // ==process this node's mesh==
-        tinygltf::Mesh& mesh = model.meshes[node.mesh];
-        auto model_mesh = std::make_shared<ModelMesh>();
-        model_mesh->_model_transform = mesh_transform; // keep the mesh transformation
-        // process mesh primitives
-        for (auto& primitive : mesh.primitives) {
-            // next, for each primitive extract vertex attributes
-            for(auto& attribute_pair : primitive.attributes) {
-                VertexAttribute va;
-                GetVertexAttributeBuffer(model, attribute_pair.second, va);
-                if(va.data_size <= 0) {
-                    // TODO: log error
-                    continue;
-                }
-                if(attribute_pair.first == "POSITION") {
-                    u_long count = floor(float(va.data_size) / sizeof(glm::vec3));
-                    model_mesh->_vertices.resize(count);
-                    memcpy(model_mesh->_vertices.data(), va.data_ptr, va.data_size);
-                } else if( attribute_pair.first == "NORMAL") {
-                    u_long count = floor(float(va.data_size) / sizeof(glm::vec3));
-                    model_mesh->_normals.resize(count);
-                    memcpy(model_mesh->_normals.data(), va.data_ptr, va.data_size);
-                } else if( attribute_pair.first == "TANGENT") {
-                    u_long count = floor(float(va.data_size) / sizeof(glm::vec4));
-                    model_mesh->_tangents.resize(count);
-                    memcpy(model_mesh->_tangents.data(), va.data_ptr, va.data_size);
-                } else if( attribute_pair.first == "TEXCOORD_0") {
-                    u_long count = floor(float(va.data_size) / sizeof(glm::vec2));
-                    model_mesh->_tex_coords.resize(count);
-                    memcpy(model_mesh->_tex_coords.data(), va.data_ptr, va.data_size);
-                }
-            } // attribute_pair
-            // process mesh materials
-            int material_idx = primitive.material;
-            if(material_idx >= 0) {
-                auto material = model.materials[material_idx];
-                model_mesh->_material._name = material.name;
-                // --color texture --
-                if(material.pbrMetallicRoughness.baseColorTexture.index != -1) {
-                    const auto& source_texture = model.textures[material.pbrMetallicRoughness.baseColorTexture.index];
-                    ConvertTexture(model, source_texture, model_mesh->_material._pbr_base_color_texture);
-                    if(source_texture.sampler != -1) {
-                        auto sampler = model.samplers[source_texture.sampler];
-                        ConvertSampler(sampler, model_mesh->_material._pbr_base_color_texture);
-                    }
-                }
-                // --normal texture --
-                if(material.normalTexture.index != -1) {
-                    const auto& source_texture = model.textures[material.normalTexture.index];
-                    ConvertTexture(model, source_texture, model_mesh->_material._normal_texture);
-                    if(source_texture.sampler != -1) {
-                        auto sampler = model.samplers[source_texture.sampler];
-                        ConvertSampler(sampler, model_mesh->_material._normal_texture);
-                    }
-                }
-            } // end material_idx
-            // --now, extract the mesh index buffer--
-            VertexAttribute va;
-            if(GetVertexAttributeBuffer(model, primitive.indices, va)) {
-                u_long count = floor(float(va.data_size) / sizeof(Index));
-                model_mesh->_indices.resize(count);
-                memcpy(model_mesh->_indices.data(), va.data_ptr, va.data_size);
+        if (node.mesh >= 0 && node.mesh < static_cast<int>(model.meshes.size())) {
+            auto& model_mesh = converted_meshes[node.mesh];
+            if (!model_mesh) {
+                model_mesh = ConvertMesh(model, source_buffers, images, reference_source, model.meshes[node.mesh]);
             }
-        } // for mesh primitive
-        // append this mesh to the engine model
-        model_mesh->ComputeTangentSpace();
-        engine_model->AddMesh(model_mesh);
+            // append this mesh to the engine model
+            engine_model->AddMesh(model_mesh, engine_node);
+        }
+
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+            pending_nodes.emplace_back(*it, engine_node);
+        }
     } // for scene nodes
 
+    // the meshes are independent: generate their tangents, optimize them, split them in meshlets,
+    // generate their levels of detail and pack their vertices in parallel.
+    const auto& meshes = engine_model->GetMeshes();
+    std::vector<MeshOptimizer::VertexCacheStatistics> stats_before(meshes.size());
+    std::vector<MeshOptimizer::VertexCacheStatistics> stats_after(meshes.size());
+    JobSystem::GetShared().ParallelFor(meshes.size(), [&](size_t i) {
+        ModelMesh& mesh = *meshes[i];
+        mesh.ComputeTangentSpace();
+        if (_options.optimize_meshes) {
+            auto indices = mesh._indices.ToVector();
+            stats_before[i] = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), mesh._vertices.size());
+            // renumbering the vertices would copy the streams the mesh references
+            mesh.Optimize(!_options.reference_source_buffers);
+            indices = mesh._indices.ToVector();
+            stats_after[i] = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), mesh._vertices.size());
+        }
+        if (_options.build_meshlets) {
+            mesh.BuildMeshlets();
+        }
+        mesh.GenerateLods(_options.lod_errors);
+        mesh.PackVertices(_options.vertex_layout);
+    });
+
+    if (_options.optimize_meshes && !meshes.empty()) {
+        MeshOptimizer::VertexCacheStatistics before, after;
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            before.Add(stats_before[i]);
+            after.Add(stats_after[i]);
+        }
+        aout << resource_path << ": ACMR " << before.GetAcmr() << " -> " << after.GetAcmr()
+             << ", ATVR " << before.GetAtvr() << " -> " << after.GetAtvr() << std::endl;
+    }
+
     return engine_model;
 }
@@ -9,6 +9,8 @@
 class GltfMeshModelLoader : public MeshModelLoaderBase
 {
 public:
+    explicit GltfMeshModelLoader(const MeshLoadOptions& options = MeshLoadOptions())
+        : MeshModelLoaderBase(options) {}
 
     std::unique_ptr<Model> LoadModel(const std::string &resource_path) override;
 
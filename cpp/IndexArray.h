@@ -0,0 +1,94 @@
+#ifndef MY_MOBILE_APP_INDEXARRAY_H
+#define MY_MOBILE_APP_INDEXARRAY_H
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <vector>
+#include "SharedArray.h"
+#include "Utility.h"
+
+/*!
+ * A mesh's vertex indices, 16 or 32-bit wide. Indices are only widened when the mesh has more
+ * vertices than 16 bits can number, which halves their memory otherwise, and 16-bit indices from
+ * the source asset or the mesh cache can be referenced rather than copied (see SharedArray).
+ *
+ * Reads return Index values whatever the width. The mesh processing code works on a vector of
+ * Index (@a ToVector()), and stores its result back, narrowed when the vertices allow.
+ */
+class IndexArray
+{
+public:
+    // the most vertices 16-bit indices can number
+    static constexpr size_t MAX_SHORT_VERTICES = size_t(std::numeric_limits<uint16_t>::max()) + 1;
+
+    IndexArray() = default;
+    IndexArray(SharedArray<uint16_t> indices) : _short(std::move(indices)) {}
+    IndexArray(SharedArray<uint32_t> indices) : _wide(std::move(indices)), _is_wide(true) {}
+
+    /*!
+     * Takes the indices of a mesh, 16-bit ones if its vertex_count vertices fit.
+     */
+    IndexArray(std::vector<Index> values, size_t vertex_count) {
+        if(vertex_count <= MAX_SHORT_VERTICES) {
+            _short = std::vector<uint16_t>(values.begin(), values.end());
+        } else {
+            _wide = std::move(values);
+            _is_wide = true;
+        }
+    }
+
+    // true for 32-bit indices
+    inline bool IsWide() const { return _is_wide; }
+    // bytes per index, 2 or 4
+    inline size_t GetIndexSize() const { return _is_wide ? sizeof(uint32_t) : sizeof(uint16_t); }
+    inline const SharedArray<uint16_t>& GetShort() const { return _short; }
+    inline const SharedArray<uint32_t>& GetWide() const { return _wide; }
+
+    inline size_t size() const { return _is_wide ? _wide.size() : _short.size(); }
+    inline bool empty() const { return size() == 0; }
+    // the indices as they are stored, size() * GetIndexSize() bytes
+    inline const void* data() const {
+        return _is_wide ? static_cast<const void*>(_wide.data()) : static_cast<const void*>(_short.data());
+    }
+    inline Index operator[](size_t i) const { return _is_wide ? _wide[i] : Index(_short[i]); }
+
+    // the indices widened, for processing
+    std::vector<Index> ToVector() const {
+        return _is_wide ? std::vector<Index>(_wide.begin(), _wide.end())
+                        : std::vector<Index>(_short.begin(), _short.end());
+    }
+
+    // iterates over the indices as Index values
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Index;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Index;
+
+        Iterator(const IndexArray& array, size_t i) : _array(&array), _i(i) {}
+        inline Index operator*() const { return (*_array)[_i]; }
+        inline Iterator& operator++() {
+            ++_i;
+            return *this;
+        }
+        inline bool operator==(const Iterator& other) const { return _i == other._i; }
+        inline bool operator!=(const Iterator& other) const { return _i != other._i; }
+
+    private:
+        const IndexArray* _array;
+        size_t _i;
+    };
+    inline Iterator begin() const { return Iterator(*this, 0); }
+    inline Iterator end() const { return Iterator(*this, size()); }
+
+private:
+    SharedArray<uint16_t> _short;
+    SharedArray<uint32_t> _wide;
+    bool _is_wide = false;
+};
+
+#endif //MY_MOBILE_APP_INDEXARRAY_H
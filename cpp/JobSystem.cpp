@@ -0,0 +1,150 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// the system and the worker index of the calling thread, if it's a worker
+static thread_local JobSystem* t_job_system = nullptr;
+static thread_local unsigned t_worker_index = 0;
+
+JobSystem::JobSystem(unsigned worker_count)
+{
+    worker_count = std::max(worker_count, 1u);
+    for(unsigned i = 0; i <= worker_count; ++i) {
+        _queues.emplace_back(std::make_unique<JobQueue>());
+    }
+    _workers.reserve(worker_count);
+    for(unsigned i = 0; i < worker_count; ++i) {
+        _workers.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+        _stopping = true;
+    }
+    _job_available.notify_all();
+    for(auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+JobSystem& JobSystem::GetShared()
+{
+    // hardware_concurrency() may report 0 when it can't tell
+    static JobSystem shared(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    return shared;
+}
+
+void JobSystem::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+    if(count == 0) {
+        return;
+    }
+    if(count == 1) {
+        job(0);
+        return;
+    }
+
+    // indices are handed out one at a time to whoever asks first. Helpers that only start once all
+    // indices are taken return without touching the job, so they may outlive this call.
+    struct Loop
+    {
+        const std::function<void(size_t)>* job;
+        size_t count;
+        std::atomic<size_t> next_index{0};
+        std::atomic<size_t> finished{0};
+    };
+    auto loop = std::make_shared<Loop>();
+    loop->job = &job;
+    loop->count = count;
+    auto run_indices = [](Loop& loop) {
+        for(size_t i = loop.next_index.fetch_add(1, std::memory_order_relaxed); i < loop.count;
+            i = loop.next_index.fetch_add(1, std::memory_order_relaxed)) {
+            (*loop.job)(i);
+            loop.finished.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    const size_t helper_count = std::min<size_t>(count - 1, _workers.size());
+    for(size_t i = 0; i < helper_count; ++i) {
+        Enqueue([loop, run_indices]() { run_indices(*loop); });
+    }
+    run_indices(*loop);
+
+    // the indices still running on helpers
+    while(loop->finished.load(std::memory_order_acquire) < count) {
+        std::this_thread::yield();
+    }
+}
+
+void JobSystem::Enqueue(Job job)
+{
+    // a worker queues onto its own queue, anyone else onto the shared one
+    const size_t queue_index = (t_job_system == this) ? t_worker_index : _queues.size() - 1;
+    // counted first, so the count never drops below the number of queued jobs
+    _pending_jobs.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(_queues[queue_index]->mutex);
+        _queues[queue_index]->jobs.emplace_back(std::move(job));
+    }
+    {
+        // taken so that a worker can't check for jobs and go to sleep in between
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+    }
+    _job_available.notify_one();
+}
+
+bool JobSystem::RunPendingJob(unsigned worker_index)
+{
+    auto take = [](JobQueue& queue, bool newest, Job& job) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.jobs.empty()) {
+            return false;
+        }
+        if(newest) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        } else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        return true;
+    };
+
+    // own queue first, newest job first. Then the shared queue, then steal the oldest job of the
+    // other workers, starting with the next one so that thieves spread out.
+    // not _workers, which the constructor may still be filling
+    const auto worker_count = static_cast<unsigned>(_queues.size() - 1);
+    Job job;
+    bool found = take(*_queues[worker_index], true, job) || take(*_queues[worker_count], false, job);
+    for(unsigned offset = 1; !found && offset < worker_count; ++offset) {
+        found = take(*_queues[(worker_index + offset) % worker_count], false, job);
+    }
+    if(!found) {
+        return false;
+    }
+    _pending_jobs.fetch_sub(1, std::memory_order_relaxed);
+    job();
+    return true;
+}
+
+void JobSystem::WorkerLoop(unsigned worker_index)
+{
+    t_job_system = this;
+    t_worker_index = worker_index;
+    while(true) {
+        if(RunPendingJob(worker_index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleep_mutex);
+        _job_available.wait(lock, [this]() {
+            return _stopping || _pending_jobs.load(std::memory_order_acquire) > 0;
+        });
+        if(_stopping && _pending_jobs.load(std::memory_order_acquire) == 0) {
+            // stopping, and nothing left to run
+            return;
+        }
+    }
+}
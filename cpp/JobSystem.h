@@ -0,0 +1,88 @@
+#ifndef MY_MOBILE_APP_JOBSYSTEM_H
+#define MY_MOBILE_APP_JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * A pool of worker threads with work stealing.
+ *
+ * Every worker has its own job queue: jobs submitted from a worker go to the back of its queue, and
+ * it runs its newest job first, while the cache is still warm. Idle workers steal the oldest job of
+ * another queue. Jobs submitted from other threads go to a shared queue all workers take from.
+ */
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    /*!
+     * @param worker_count the number of worker threads, at least 1
+     */
+    explicit JobSystem(unsigned worker_count);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /*!
+     * @return the pool shared by the engine, with one worker per core besides the render thread's
+     */
+    static JobSystem& GetShared();
+
+    inline unsigned GetWorkerCount() const { return static_cast<unsigned>(_workers.size()); }
+
+    /*!
+     * Queues a job for a worker thread.
+     * @return a future with the job's result
+     */
+    template<typename F>
+    auto Submit(F job) -> std::future<decltype(job())> {
+        using Result = decltype(job());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        auto result = task->get_future();
+        Enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    /*!
+     * Runs job(i) for every i in [0, count) across the workers and the calling thread, and returns
+     * once all of them have finished.
+     *
+     * The calling thread takes indices too, and only ever runs this loop's job while it waits: a
+     * long job queued earlier (e.g. a model load) can't stall it, at worst the caller does the
+     * work alone.
+     */
+    void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+private:
+    struct JobQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void Enqueue(Job job);
+    // runs one queued job, preferring the given worker's own queue. @return false if none was found
+    bool RunPendingJob(unsigned worker_index);
+    void WorkerLoop(unsigned worker_index);
+
+    std::vector<std::thread> _workers;
+    // one queue per worker, then the shared queue for jobs submitted from other threads
+    std::vector<std::unique_ptr<JobQueue>> _queues;
+    // queued, not yet started jobs, over all queues
+    std::atomic<size_t> _pending_jobs{0};
+    std::mutex _sleep_mutex;
+    std::condition_variable _job_available;
+    bool _stopping = false;
+};
+
+#endif //MY_MOBILE_APP_JOBSYSTEM_H
@@ -0,0 +1,262 @@
+#include "Ktx2.h"
+#include "TextureAsset.h"
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned char IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+// the identifier, 9 32-bit header fields and the index of the data format descriptor, key/values
+// and supercompression data
+constexpr size_t HEADER_SIZE = 80;
+// byte offset, byte length and uncompressed byte length, 64-bit each
+constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+
+constexpr uint32_t VK_FORMAT_R8G8B8A8_UNORM = 37;
+constexpr uint32_t VK_FORMAT_R8G8B8A8_SRGB = 43;
+constexpr uint32_t VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK = 147;
+constexpr uint32_t VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK = 151;
+constexpr uint32_t VK_FORMAT_ASTC_4x4_UNORM_BLOCK = 157;
+constexpr uint32_t ASTC_FORMAT_COUNT = 14;
+
+// the VkFormats of the ETC2/EAC formats, and their GL equivalent. The sRGB ones are sampled as
+// their UNORM equivalent, see ToGLFormat().
+const struct {
+    uint32_t vk_format;
+    GLenum gl_format;
+} ETC2_FORMATS[] = {
+        {147, GL_COMPRESSED_RGB8_ETC2},
+        {148, GL_COMPRESSED_RGB8_ETC2},
+        {149, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2},
+        {150, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2},
+        {151, GL_COMPRESSED_RGBA8_ETC2_EAC},
+        {152, GL_COMPRESSED_RGBA8_ETC2_EAC},
+        {153, GL_COMPRESSED_R11_EAC},
+        {154, GL_COMPRESSED_SIGNED_R11_EAC},
+        {155, GL_COMPRESSED_RG11_EAC},
+        {156, GL_COMPRESSED_SIGNED_RG11_EAC},
+};
+
+/*!
+ * @return the GL format of a VkFormat: 0 for RGBA8, or a compressed format. sRGB formats map to
+ *         their UNORM equivalent, so that every texture is sampled without decoding, as PNG images
+ *         are: the shaders work on the encoded values and don't encode their output.
+ */
+bool ToGLFormat(uint32_t vk_format, uint32_t& gl_format)
+{
+    if(vk_format == VK_FORMAT_R8G8B8A8_UNORM || vk_format == VK_FORMAT_R8G8B8A8_SRGB) {
+        gl_format = 0;
+        return true;
+    }
+    for(const auto& format : ETC2_FORMATS) {
+        if(format.vk_format == vk_format) {
+            gl_format = format.gl_format;
+            return true;
+        }
+    }
+    // the ASTC formats alternate unorm and srgb, in the same block size order as GL's
+    if(vk_format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && vk_format < VK_FORMAT_ASTC_4x4_UNORM_BLOCK + 2 * ASTC_FORMAT_COUNT) {
+        const uint32_t index = vk_format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+        gl_format = GL_COMPRESSED_RGBA_ASTC_4x4_KHR + index / 2;
+        return true;
+    }
+    return false;
+}
+
+uint32_t ReadU32(const unsigned char* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t ReadU64(const unsigned char* data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void AppendU32(std::vector<unsigned char>& bytes, uint32_t value)
+{
+    const auto* value_bytes = reinterpret_cast<const unsigned char*>(&value);
+    bytes.insert(bytes.end(), value_bytes, value_bytes + sizeof(value));
+}
+
+void WriteU64(std::vector<unsigned char>& bytes, size_t offset, uint64_t value)
+{
+    memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+// Khronos data format descriptor values
+constexpr uint32_t KHR_DF_MODEL_RGBSDA = 1;
+constexpr uint32_t KHR_DF_MODEL_ETC2 = 161;
+constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+constexpr uint32_t KHR_DF_CHANNEL_RED = 0;
+constexpr uint32_t KHR_DF_CHANNEL_GREEN = 1;
+constexpr uint32_t KHR_DF_CHANNEL_BLUE = 2;
+constexpr uint32_t KHR_DF_CHANNEL_ETC2_COLOR = 2;
+constexpr uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+
+struct DfdSample {
+    uint32_t channel;
+    uint32_t bit_offset;
+    uint32_t bit_length;
+    uint32_t upper;
+};
+
+/*!
+ * Appends a data format descriptor with a single basic descriptor block.
+ */
+void AppendDataFormatDescriptor(std::vector<unsigned char>& bytes, uint32_t color_model, uint32_t block_dimension,
+                                uint32_t block_bytes, const std::vector<DfdSample>& samples)
+{
+    const auto block_size = static_cast<uint32_t>(24 + 16 * samples.size());
+    AppendU32(bytes, 4 + block_size);                      // dfdTotalSize
+    AppendU32(bytes, 0);                                   // vendorId, descriptorType: Khronos basic
+    AppendU32(bytes, 2 | (block_size << 16));              // versionNumber, descriptorBlockSize
+    AppendU32(bytes, color_model | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+    AppendU32(bytes, (block_dimension - 1) | ((block_dimension - 1) << 8)); // texelBlockDimension0..3
+    AppendU32(bytes, block_bytes);                         // bytesPlane0..3
+    AppendU32(bytes, 0);                                   // bytesPlane4..7
+    for(const auto& sample : samples) {
+        AppendU32(bytes, sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+        AppendU32(bytes, 0);                               // samplePosition0..3
+        AppendU32(bytes, 0);                               // sampleLower
+        AppendU32(bytes, sample.upper);                    // sampleUpper
+    }
+}
+
+} // namespace
+
+bool Ktx2::IsKtx2(const unsigned char* data, size_t size)
+{
+    return size >= sizeof(IDENTIFIER) && memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) == 0;
+}
+
+bool Ktx2::Read(const unsigned char* data, size_t size, TextureCache::Image& image)
+{
+    if(size < HEADER_SIZE || !IsKtx2(data, size)) {
+        return false;
+    }
+    const uint32_t vk_format = ReadU32(data + 12);
+    const uint32_t width = ReadU32(data + 20);
+    const uint32_t height = ReadU32(data + 24);
+    const uint32_t depth = ReadU32(data + 28);
+    const uint32_t layer_count = ReadU32(data + 32);
+    const uint32_t face_count = ReadU32(data + 36);
+    const uint32_t level_count = std::max(ReadU32(data + 40), 1u);
+    const uint32_t supercompression_scheme = ReadU32(data + 44);
+    // a single 2D image, stored as it's sampled
+    uint32_t gl_format = 0;
+    if(width == 0 || height == 0 || width > 16384 || height > 16384 || depth > 1 || layer_count > 1
+       || face_count != 1 || level_count > 32 || supercompression_scheme != 0 || !ToGLFormat(vk_format, gl_format)) {
+        return false;
+    }
+    if(HEADER_SIZE + level_count * LEVEL_INDEX_ENTRY_SIZE > size) {
+        return false;
+    }
+
+    // the level index lists the largest level first, whatever the order of the levels in the file
+    size_t chain_size = 0;
+    for(uint32_t level = 0; level < level_count; ++level) {
+        chain_size += TextureAsset::getLevelSize(gl_format, width, height, level);
+    }
+    image.pixels.resize(chain_size);
+    size_t pixels_offset = 0;
+    for(uint32_t level = 0; level < level_count; ++level) {
+        const unsigned char* entry = data + HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+        const uint64_t offset = ReadU64(entry);
+        const uint64_t length = ReadU64(entry + 8);
+        if(length != TextureAsset::getLevelSize(gl_format, width, height, level) || offset > size || length > size - offset) {
+            return false;
+        }
+        memcpy(image.pixels.data() + pixels_offset, data + offset, length);
+        pixels_offset += length;
+    }
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+    image.mip_levels = static_cast<int>(level_count);
+    image.compressed_format = gl_format;
+    return true;
+}
+
+std::vector<unsigned char> Ktx2::Write(const TextureCache::Image& image)
+{
+    uint32_t vk_format = 0;
+    uint32_t color_model = 0;
+    uint32_t block_dimension = 1;
+    uint32_t block_bytes = 0;
+    std::vector<DfdSample> samples;
+    switch(image.compressed_format) {
+        case 0:
+            vk_format = VK_FORMAT_R8G8B8A8_UNORM;
+            color_model = KHR_DF_MODEL_RGBSDA;
+            block_bytes = 4;
+            samples = {{KHR_DF_CHANNEL_RED, 0, 8, 255}, {KHR_DF_CHANNEL_GREEN, 8, 8, 255},
+                       {KHR_DF_CHANNEL_BLUE, 16, 8, 255}, {KHR_DF_CHANNEL_ALPHA, 24, 8, 255}};
+            break;
+        case GL_COMPRESSED_RGB8_ETC2:
+            vk_format = VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+            color_model = KHR_DF_MODEL_ETC2;
+            block_dimension = 4;
+            block_bytes = 8;
+            samples = {{KHR_DF_CHANNEL_ETC2_COLOR, 0, 64, UINT32_MAX}};
+            break;
+        case GL_COMPRESSED_RGBA8_ETC2_EAC:
+            vk_format = VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK;
+            color_model = KHR_DF_MODEL_ETC2;
+            block_dimension = 4;
+            block_bytes = 16;
+            samples = {{KHR_DF_CHANNEL_ALPHA, 0, 64, UINT32_MAX}, {KHR_DF_CHANNEL_ETC2_COLOR, 64, 64, UINT32_MAX}};
+            break;
+        default:
+            return {};
+    }
+    const int level_count = std::max(image.mip_levels, 1);
+
+    std::vector<unsigned char> bytes(IDENTIFIER, IDENTIFIER + sizeof(IDENTIFIER));
+    AppendU32(bytes, vk_format);
+    AppendU32(bytes, 1);                                   // typeSize
+    AppendU32(bytes, static_cast<uint32_t>(image.width));
+    AppendU32(bytes, static_cast<uint32_t>(image.height));
+    AppendU32(bytes, 0);                                   // pixelDepth
+    AppendU32(bytes, 0);                                   // layerCount
+    AppendU32(bytes, 1);                                   // faceCount
+    AppendU32(bytes, static_cast<uint32_t>(level_count));
+    AppendU32(bytes, 0);                                   // supercompressionScheme
+    const size_t dfd_offset = HEADER_SIZE + level_count * LEVEL_INDEX_ENTRY_SIZE;
+    bytes.resize(dfd_offset, 0);
+    AppendDataFormatDescriptor(bytes, color_model, block_dimension, block_bytes, samples);
+    const auto dfd_length = static_cast<uint32_t>(bytes.size() - dfd_offset);
+    memcpy(bytes.data() + 48, &dfd_offset, sizeof(uint32_t));
+    memcpy(bytes.data() + 52, &dfd_length, sizeof(uint32_t));
+
+    // the levels, smallest first, each aligned to the block size (and to 4 bytes)
+    const size_t alignment = std::max<size_t>(block_bytes, 4);
+    std::vector<size_t> level_offsets(level_count);
+    size_t source_offset = 0;
+    for(int level = 0; level < level_count; ++level) {
+        level_offsets[level] = source_offset;
+        source_offset += TextureAsset::getLevelSize(image.compressed_format, image.width, image.height, level);
+    }
+    if(source_offset != image.pixels.size()) {
+        return {};
+    }
+    for(int level = level_count - 1; level >= 0; --level) {
+        const size_t length = TextureAsset::getLevelSize(image.compressed_format, image.width, image.height, level);
+        bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+        const size_t entry = HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+        WriteU64(bytes, entry, bytes.size());
+        WriteU64(bytes, entry + 8, length);
+        WriteU64(bytes, entry + 16, length);
+        bytes.insert(bytes.end(), image.pixels.begin() + level_offsets[level],
+                     image.pixels.begin() + level_offsets[level] + length);
+    }
+    return bytes;
+}
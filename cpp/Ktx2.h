@@ -0,0 +1,37 @@
+#ifndef MY_MOBILE_APP_KTX2_H
+#define MY_MOBILE_APP_KTX2_H
+
+#include "TextureCache.h"
+
+#include <cstddef>
+#include <vector>
+
+/*!
+ * Reads and writes KTX2 texture containers holding a 2D image and its mip chain: RGBA8 pixels, or
+ * ETC2/EAC or ASTC compressed blocks the gpu samples directly. Supercompressed containers (Basis
+ * Universal, zstd) aren't supported.
+ */
+class Ktx2
+{
+public:
+    /*!
+     * @return true if the data starts like a KTX2 file
+     */
+    static bool IsKtx2(const unsigned char* data, size_t size);
+
+    /*!
+     * Reads a KTX2 file's image. The levels are copied out of data, largest first. sRGB formats
+     * are read as their UNORM equivalent: like PNG images, textures are sampled without decoding.
+     * @return false if the file is malformed, or holds something else than a supported 2D image
+     */
+    static bool Read(const unsigned char* data, size_t size, TextureCache::Image& image);
+
+    /*!
+     * Writes an image as a KTX2 file. Only RGBA8 images, and ETC2 RGB8 and RGBA8 (EAC alpha)
+     * compressed images can be written.
+     * @return the file's contents, empty if the image's format can't be written
+     */
+    static std::vector<unsigned char> Write(const TextureCache::Image& image);
+};
+
+#endif //MY_MOBILE_APP_KTX2_H
@@ -0,0 +1,137 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+/*!
+ * @return the view space point a normalized device coordinate maps back to
+ */
+static glm::vec3 Unproject(const glm::mat4& inverse_projection, float x, float y, float z)
+{
+    const glm::vec4 point = inverse_projection * glm::vec4(x, y, z, 1.0f);
+    return glm::vec3(point) / point.w;
+}
+
+void LightClusters::ComputeClusterBounds(const glm::mat4& projection_matrix)
+{
+    _projection_matrix = projection_matrix;
+    const glm::mat4 inverse_projection = glm::inverse(projection_matrix);
+    _near_depth = -Unproject(inverse_projection, 0.0f, 0.0f, -1.0f).z;
+    _far_depth = -Unproject(inverse_projection, 0.0f, 0.0f, 1.0f).z;
+
+    // perspective projections have w = -z, orthographic ones w = 1. An orthographic near plane may
+    // be behind the camera, so those get linear slices.
+    _logarithmic_depth = projection_matrix[2][3] != 0.0f && _near_depth > 0.0f;
+    if(_logarithmic_depth) {
+        const float log_range = std::log(_far_depth / _near_depth);
+        _depth_scale = SLICES / log_range;
+        _depth_bias = -SLICES * std::log(_near_depth) / log_range;
+    } else {
+        _depth_scale = SLICES / (_far_depth - _near_depth);
+        _depth_bias = -_near_depth * _depth_scale;
+    }
+
+    // the view rays through the tile corners, from the near to the far plane
+    std::vector<glm::vec3> near_corners((TILES_X + 1) * (TILES_Y + 1));
+    std::vector<glm::vec3> far_corners(near_corners.size());
+    for(int y = 0; y <= TILES_Y; ++y) {
+        for(int x = 0; x <= TILES_X; ++x) {
+            const float ndc_x = 2.0f * float(x) / TILES_X - 1.0f;
+            const float ndc_y = 2.0f * float(y) / TILES_Y - 1.0f;
+            near_corners[y * (TILES_X + 1) + x] = Unproject(inverse_projection, ndc_x, ndc_y, -1.0f);
+            far_corners[y * (TILES_X + 1) + x] = Unproject(inverse_projection, ndc_x, ndc_y, 1.0f);
+        }
+    }
+    auto slice_depth = [this](int slice) {
+        const float d = (float(slice) - _depth_bias) / _depth_scale;
+        return _logarithmic_depth ? std::exp(d) : d;
+    };
+
+    // a cluster is bounded by its tile's corner rays between its slice's depths
+    _cluster_bounds.assign(CLUSTER_COUNT, BoundingBox());
+    for(int slice = 0; slice < SLICES; ++slice) {
+        const float depths[2] = {slice_depth(slice), slice_depth(slice + 1)};
+        for(int y = 0; y < TILES_Y; ++y) {
+            for(int x = 0; x < TILES_X; ++x) {
+                auto& bounds = _cluster_bounds[(slice * TILES_Y + y) * TILES_X + x];
+                for(int corner = 0; corner < 4; ++corner) {
+                    const int i = (y + corner / 2) * (TILES_X + 1) + x + corner % 2;
+                    for(float depth : depths) {
+                        const float t = (depth - _near_depth) / (_far_depth - _near_depth);
+                        bounds.Extend(near_corners[i] + (far_corners[i] - near_corners[i]) * t);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int LightClusters::GetSlice(float view_depth) const
+{
+    const float d = _logarithmic_depth ? std::log(std::max(view_depth, _near_depth)) : view_depth;
+    return std::min(std::max(static_cast<int>(std::floor(d * _depth_scale + _depth_bias)), 0), SLICES - 1);
+}
+
+void LightClusters::Build(const std::vector<SceneLight>& lights, const glm::mat4& view_matrix, const glm::mat4& projection_matrix)
+{
+    if(projection_matrix != _projection_matrix) {
+        ComputeClusterBounds(projection_matrix);
+    }
+
+    // global lights first
+    _lights.clear();
+    for(const auto& light : lights) {
+        if(light.light_range <= 0.0f && _lights.size() < MAX_LIGHTS) {
+            _lights.push_back(light);
+        }
+    }
+    _global_light_count = _lights.size();
+    for(const auto& light : lights) {
+        if(light.light_range > 0.0f && _lights.size() < MAX_LIGHTS) {
+            _lights.push_back(light);
+        }
+    }
+
+    // find the clusters each light's sphere overlaps, in the slices its depth range covers
+    _assignments.clear();
+    for(size_t i = _global_light_count; i < _lights.size(); ++i) {
+        const glm::vec3 center = glm::vec3(view_matrix * glm::vec4(_lights[i].light_position, 1.0f));
+        const float radius = _lights[i].light_range;
+        const float depth = -center.z;
+        if(depth + radius < _near_depth || depth - radius > _far_depth) {
+            continue;
+        }
+        const int last_slice = GetSlice(depth + radius);
+        for(int slice = GetSlice(depth - radius); slice <= last_slice; ++slice) {
+            for(int tile = 0; tile < TILES_X * TILES_Y; ++tile) {
+                const uint32_t cluster = slice * TILES_X * TILES_Y + tile;
+                const auto& bounds = _cluster_bounds[cluster];
+                const glm::vec3 offset = glm::clamp(center, bounds.min, bounds.max) - center;
+                if(glm::dot(offset, offset) <= radius * radius) {
+                    _assignments.emplace_back(cluster, static_cast<uint32_t>(i));
+                }
+            }
+        }
+    }
+    if(_assignments.size() > MAX_LIGHT_INDICES) {
+        _assignments.resize(MAX_LIGHT_INDICES);
+    }
+
+    // lay the lists out cluster after cluster: count, then place each light after its cluster's offset
+    _clusters.assign(2 * CLUSTER_COUNT, 0);
+    for(const auto& assignment : _assignments) {
+        _clusters[2 * assignment.first + 1] += 1;
+    }
+    uint32_t offset = 0;
+    for(int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+        _clusters[2 * cluster] = offset;
+        offset += _clusters[2 * cluster + 1];
+        _clusters[2 * cluster + 1] = 0;
+    }
+    _light_indices.resize(_assignments.size());
+    for(const auto& assignment : _assignments) {
+        auto* cluster = &_clusters[2 * assignment.first];
+        _light_indices[cluster[0] + cluster[1]] = assignment.second;
+        cluster[1] += 1;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef MY_MOBILE_APP_LIGHTCLUSTERS_H
+#define MY_MOBILE_APP_LIGHTCLUSTERS_H
+
+#include "glm/glm.hpp"
+#include "scene/BoundingVolume.h"
+#include "scene/SceneLight.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*!
+ * Assigns a frame's lights to clusters, the cells of a grid splitting the camera's view volume in
+ * screen tiles and depth slices, so that a fragment only shades the lights reaching its cluster.
+ *
+ * Lights without a range reach everything: they're kept first, as global lights every fragment
+ * shades. The others get listed in the clusters their sphere of influence overlaps.
+ */
+class LightClusters
+{
+public:
+    static constexpr int TILES_X = 16;
+    static constexpr int TILES_Y = 8;
+    static constexpr int SLICES = 24;
+    static constexpr int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    // the light index list is laid out in rows of this many indices
+    static constexpr int INDEX_ROW_LENGTH = 1024;
+    static constexpr size_t MAX_LIGHT_INDICES = size_t(INDEX_ROW_LENGTH) * 2048;
+
+    /*!
+     * @param lights the scene's lights, of which the first MAX_LIGHTS are kept
+     * @param view_matrix the camera's
+     * @param projection_matrix the camera's, perspective or orthographic
+     */
+    void Build(const std::vector<SceneLight>& lights, const glm::mat4& view_matrix, const glm::mat4& projection_matrix);
+
+    // the kept lights, global lights first. Cluster light indices refer to this order.
+    inline const std::vector<SceneLight>& GetLights() const { return _lights; }
+    inline size_t GetGlobalLightCount() const { return _global_light_count; }
+
+    /*!
+     * @return per cluster, the offset and number of its lights in GetLightIndices(). Cluster
+     * (x, y, slice) is at index (slice * TILES_Y + y) * TILES_X + x, with tile (0, 0) bottom left.
+     */
+    inline const std::vector<uint32_t>& GetClusters() const { return _clusters; }
+    inline const std::vector<uint32_t>& GetLightIndices() const { return _light_indices; }
+
+    /*!
+     * A view depth d (the distance in front of the camera) falls in slice
+     * (IsDepthLogarithmic() ? log(d) : d) * GetDepthScale() + GetDepthBias(). Perspective views
+     * get slices growing with the distance, like the on-screen size of things shrinks.
+     */
+    inline bool IsDepthLogarithmic() const { return _logarithmic_depth; }
+    inline float GetDepthScale() const { return _depth_scale; }
+    inline float GetDepthBias() const { return _depth_bias; }
+
+private:
+    // recomputes the clusters' view space bounds, which only depend on the projection
+    void ComputeClusterBounds(const glm::mat4& projection_matrix);
+    int GetSlice(float view_depth) const;
+
+    glm::mat4 _projection_matrix = glm::mat4(0.0f);
+    std::vector<BoundingBox> _cluster_bounds;
+    float _near_depth = 0.0f;
+    float _far_depth = 0.0f;
+    bool _logarithmic_depth = false;
+    float _depth_scale = 0.0f;
+    float _depth_bias = 0.0f;
+
+    std::vector<SceneLight> _lights;
+    size_t _global_light_count = 0;
+    std::vector<uint32_t> _clusters;
+    std::vector<uint32_t> _light_indices;
+    // (cluster, light) pairs found while building, kept to reuse the allocation
+    std::vector<std::pair<uint32_t, uint32_t>> _assignments;
+};
+
+#endif //MY_MOBILE_APP_LIGHTCLUSTERS_H
@@ -0,0 +1,36 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    const auto size = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after closing the descriptor
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const unsigned char*>(data), size));
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data != nullptr) {
+        munmap(const_cast<unsigned char*>(_data), _size);
+        _data = nullptr;
+        _size = 0;
+    }
+}
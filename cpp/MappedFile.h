@@ -0,0 +1,36 @@
+#ifndef MY_MOBILE_APP_MAPPEDFILE_H
+#define MY_MOBILE_APP_MAPPEDFILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/*!
+ * A read-only memory mapping of a whole file. The mapping is released on destruction, so share it
+ * (e.g. as the storage of a SharedArray view) to keep referenced data alive.
+ */
+class MappedFile
+{
+public:
+    /*!
+     * Maps the file at the given path.
+     * @return the mapping, or null if the file can't be opened or is empty
+     */
+    static std::shared_ptr<MappedFile> Open(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline const unsigned char* GetData() const { return _data; }
+    inline size_t GetSize() const { return _size; }
+
+private:
+    MappedFile(const unsigned char* data, size_t size) : _data(data), _size(size) {}
+
+    const unsigned char* _data = nullptr;
+    size_t _size = 0;
+};
+
+#endif //MY_MOBILE_APP_MAPPEDFILE_H
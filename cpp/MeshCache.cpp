@@ -0,0 +1,638 @@
+#include "MeshCache.h"
+#include "AndroidOut.h"
+#include "MappedFile.h"
+
+#ifdef __ANDROID__
+#define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+#endif
+#include "external/tiny_gltf/tiny_gltf.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr char MAGIC[4] = {'E', 'M', 'S', 'H'};
+// every blob starts at a multiple of this, so the mapped streams are suitably aligned for any element type
+constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+// a byte range of the file
+struct BlobRef {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t file_size;
+    uint32_t mesh_count; // the mesh records follow the header
+    uint32_t reserved;
+    BlobRef nodes;       // NodeRecords, parents before their children
+    BlobRef instances;   // InstanceRecords
+};
+
+struct NodeRecord {
+    float local_transform[16];
+    int32_t parent; // -1 for the model itself
+    uint32_t reserved;
+    BlobRef name;
+};
+
+struct InstanceRecord {
+    int32_t node;   // -1 for the model itself
+    uint32_t mesh;
+};
+
+struct TextureRecord {
+    BlobRef name;
+    BlobRef uri;
+    BlobRef pixels;
+    int32_t width;
+    int32_t height;
+    int32_t mip_levels;
+    int32_t wrap_s;
+    int32_t wrap_t;
+    int32_t min_filter;
+    int32_t mag_filter;
+    uint32_t compressed_format; // 0 for RGBA8 pixels
+    uint64_t cache_key; // textures sharing an image share the pixels blob
+};
+
+struct MeshRecord {
+    float position_offset[3];
+    float position_scale[3];
+    float bbox_min[3];
+    float bbox_max[3];
+    float bsphere_center[3];
+    float bsphere_radius;
+    int32_t vertex_layout;
+    uint16_t index_size;     // bytes per index of indices, 2 or 4
+    uint16_t lod_index_size; // and of lod_indices
+    BlobRef vertices;
+    BlobRef indices;
+    BlobRef normals;
+    BlobRef tangents;
+    BlobRef tex_coords;
+    BlobRef packed_vertices;
+    BlobRef lod_indices;
+    BlobRef lods;        // MeshLods
+    BlobRef meshlets;    // Meshlets
+    BlobRef submeshes;   // SubmeshRecords
+};
+
+struct SubmeshRecord {
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+    BlobRef material_name;
+    float base_color_factor[4];
+    float emissive_factor[3];
+    float metallic_factor;
+    float roughness_factor;
+    uint32_t reserved;
+    TextureRecord base_color_texture;
+    TextureRecord normal_texture;
+};
+
+static_assert(std::is_trivially_copyable<FileHeader>::value, "cache records are written as raw bytes");
+static_assert(std::is_trivially_copyable<MeshRecord>::value, "cache records are written as raw bytes");
+static_assert(std::is_trivially_copyable<SubmeshRecord>::value, "cache records are written as raw bytes");
+static_assert(std::is_trivially_copyable<NodeRecord>::value, "cache records are written as raw bytes");
+static_assert(std::is_trivially_copyable<MeshLod>::value, "cache records are written as raw bytes");
+static_assert(std::is_trivially_copyable<Meshlet>::value, "cache records are written as raw bytes");
+
+// 64-bit FNV-1a
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Calls visit(data, size) with the whole contents of a file. Assets are read through the asset
+// manager on Android, and mapped on host builds.
+template<typename Visitor>
+bool VisitFile(const std::string& path, Visitor visit)
+{
+#ifdef __ANDROID__
+    std::vector<unsigned char> bytes;
+    std::string err;
+    if(!tinygltf::ReadWholeFile(&bytes, &err, path, nullptr)) {
+        return false;
+    }
+    visit(bytes.data(), bytes.size());
+#else
+    auto mapped_file = MappedFile::Open(path);
+    if(!mapped_file) {
+        return false;
+    }
+    visit(mapped_file->GetData(), mapped_file->GetSize());
+#endif
+    return true;
+}
+
+// Collects the values of the "uri" properties of a glTF JSON document (or of a .glb's JSON chunk),
+// without fully parsing it. Embedded data: uris are skipped, they are hashed as part of the document.
+std::vector<std::string> FindExternalUris(const unsigned char* data, size_t size)
+{
+    static const char URI_KEY[] = "\"uri\"";
+    const size_t key_length = sizeof(URI_KEY) - 1;
+    std::vector<std::string> uris;
+    const char* text = reinterpret_cast<const char*>(data);
+    size_t position = 0;
+    while(position + key_length < size) {
+        const void* found = memmem(text + position, size - position, URI_KEY, key_length);
+        if(found == nullptr) {
+            break;
+        }
+        position = static_cast<const char*>(found) - text + key_length;
+        while(position < size && (text[position] == ' ' || text[position] == ':'
+                                  || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+            ++position;
+        }
+        if(position >= size || text[position] != '"') {
+            continue;
+        }
+        const size_t uri_begin = ++position;
+        while(position < size && text[position] != '"') {
+            ++position;
+        }
+        std::string uri(text + uri_begin, position - uri_begin);
+        if(uri.compare(0, 5, "data:") != 0) {
+            uris.emplace_back(std::move(uri));
+        }
+    }
+    return uris;
+}
+
+// Appends the engine data to a cache file being built in memory.
+class CacheWriter
+{
+public:
+    explicit CacheWriter(size_t header_size) : _bytes(header_size, 0) {}
+
+    BlobRef AppendBlob(const void* data, size_t size) {
+        BlobRef blob;
+        if(size == 0) {
+            return blob;
+        }
+        _bytes.resize((_bytes.size() + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT, 0);
+        blob.offset = _bytes.size();
+        blob.size = size;
+        const auto* bytes = static_cast<const u_char*>(data);
+        _bytes.insert(_bytes.end(), bytes, bytes + size);
+        return blob;
+    }
+
+    template<typename T>
+    BlobRef AppendArray(const SharedArray<T>& array) {
+        return AppendBlob(array.data(), array.size() * sizeof(T));
+    }
+
+    template<typename T>
+    BlobRef AppendArray(const std::vector<T>& array) {
+        return AppendBlob(array.data(), array.size() * sizeof(T));
+    }
+
+    BlobRef AppendArray(const IndexArray& array) {
+        return AppendBlob(array.data(), array.size() * array.GetIndexSize());
+    }
+
+    BlobRef AppendString(const std::string& value) {
+        return AppendBlob(value.data(), value.size());
+    }
+
+    TextureRecord AppendTexture(const Texture& texture) {
+        TextureRecord record{};
+        record.name = AppendString(texture._name);
+        record.uri = AppendString(texture._image_uri);
+        if(texture._cache_key == 0) {
+            record.pixels = AppendArray(texture._image_data);
+        } else {
+            // written once per image
+            auto found = _shared_pixels.find(texture._cache_key);
+            if(found == _shared_pixels.end()) {
+                found = _shared_pixels.emplace(texture._cache_key, AppendArray(texture._image_data)).first;
+            }
+            record.pixels = found->second;
+        }
+        record.cache_key = texture._cache_key;
+        record.width = texture._image_width;
+        record.height = texture._image_height;
+        record.mip_levels = texture._mip_levels;
+        record.wrap_s = texture._sampler_wrap_s;
+        record.wrap_t = texture._sampler_wrap_t;
+        record.min_filter = texture._sampler_min_filter;
+        record.mag_filter = texture._sampler_mag_filter;
+        record.compressed_format = texture._compressed_format;
+        return record;
+    }
+
+    std::vector<u_char>& GetBytes() { return _bytes; }
+
+private:
+    std::vector<u_char> _bytes;
+    std::unordered_map<uint64_t, BlobRef> _shared_pixels;
+};
+
+// Builds the engine data from a mapped cache file. Every blob is bounds checked against the file.
+class CacheReader
+{
+public:
+    explicit CacheReader(std::shared_ptr<MappedFile> file) : _file(std::move(file)) {}
+
+    bool IsValid(const BlobRef& blob, size_t element_size) const {
+        return blob.offset <= _file->GetSize()
+               && blob.size <= _file->GetSize() - blob.offset
+               && blob.offset % BLOB_ALIGNMENT == 0
+               && blob.size % element_size == 0;
+    }
+
+    template<typename T>
+    bool ReadArray(const BlobRef& blob, SharedArray<T>& array) const {
+        if(!IsValid(blob, sizeof(T))) {
+            return false;
+        }
+        if(blob.size == 0) {
+            array = SharedArray<T>();
+        } else {
+            array = SharedArray<T>::View(_file,
+                                         reinterpret_cast<const T*>(_file->GetData() + blob.offset),
+                                         blob.size / sizeof(T));
+        }
+        return true;
+    }
+
+    bool ReadIndices(const BlobRef& blob, uint16_t index_size, IndexArray& indices) const {
+        if(index_size == sizeof(uint16_t)) {
+            SharedArray<uint16_t> values;
+            const bool read = ReadArray(blob, values);
+            indices = std::move(values);
+            return read;
+        }
+        SharedArray<uint32_t> values;
+        const bool read = index_size == sizeof(uint32_t) && ReadArray(blob, values);
+        indices = std::move(values);
+        return read;
+    }
+
+    bool ReadString(const BlobRef& blob, std::string& value) const {
+        if(!IsValid(blob, 1)) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(_file->GetData() + blob.offset), blob.size);
+        return true;
+    }
+
+    bool ReadTexture(const TextureRecord& record, Texture& texture) const {
+        // the pixels must hold exactly the mip chain the record describes, as it's uploaded as is
+        if(record.width < 0 || record.height < 0 || record.mip_levels < 1 || record.mip_levels > 32
+           || (record.compressed_format != 0 && TextureAsset::getLevelSize(record.compressed_format, 1, 1, 0) == 0)) {
+            return false;
+        }
+        uint64_t chain_size = 0;
+        for(int32_t level = 0; level < record.mip_levels; ++level) {
+            chain_size += TextureAsset::getLevelSize(record.compressed_format, record.width, record.height, level);
+        }
+        if(record.pixels.size != 0 && record.pixels.size != chain_size) {
+            return false;
+        }
+        texture._image_width = record.width;
+        texture._image_height = record.height;
+        texture._mip_levels = record.mip_levels;
+        texture._compressed_format = record.compressed_format;
+        texture._sampler_wrap_s = record.wrap_s;
+        texture._sampler_wrap_t = record.wrap_t;
+        texture._sampler_min_filter = record.min_filter;
+        texture._sampler_mag_filter = record.mag_filter;
+        texture._cache_key = record.cache_key;
+        return ReadString(record.name, texture._name)
+               && ReadString(record.uri, texture._image_uri)
+               && ReadArray(record.pixels, texture._image_data);
+    }
+
+private:
+    std::shared_ptr<MappedFile> _file;
+};
+
+} // namespace
+
+bool MeshCache::HashSourceAsset(const std::string& resource_path, const MeshLoadOptions& options, uint64_t& hash)
+{
+    hash = FNV_OFFSET_BASIS;
+    std::vector<std::string> external_uris;
+    bool ok = VisitFile(resource_path, [&](const unsigned char* data, size_t size) {
+        hash = HashBytes(data, size, hash);
+        external_uris = FindExternalUris(data, size);
+    });
+    if(!ok) {
+        return false;
+    }
+
+    auto separator = resource_path.find_last_of('/');
+    std::string base_dir = separator == std::string::npos ? "" : resource_path.substr(0, separator + 1);
+    for(const auto& uri : external_uris) {
+        // a missing file fails the load anyway, hashing its name is enough
+        hash = HashBytes(uri.data(), uri.size(), hash);
+        VisitFile(base_dir + uri, [&](const unsigned char* data, size_t size) {
+            hash = HashBytes(data, size, hash);
+        });
+        // an image's KTX2 version, loaded instead of it
+        const size_t extension = uri.find_last_of('.');
+        if(extension != std::string::npos) {
+            VisitFile(base_dir + uri.substr(0, extension) + ".ktx2", [&](const unsigned char* data, size_t size) {
+                hash = HashBytes(data, size, hash);
+            });
+        }
+    }
+
+    // only the vertex layout, the compressed formats the KTX2 images may use, the levels of detail, the
+    // mesh optimization and the meshlets change the cached data. Referencing the source buffers only
+    // does with the optimization, which then keeps the vertex order.
+    const auto vertex_layout = static_cast<int32_t>(options.vertex_layout);
+    hash = HashBytes(&vertex_layout, sizeof(vertex_layout), hash);
+    hash = HashBytes(options.compressed_texture_formats.data(),
+                     options.compressed_texture_formats.size() * sizeof(GLenum), hash);
+    hash = HashBytes(options.lod_errors.data(), options.lod_errors.size() * sizeof(float), hash);
+    const auto optimize_meshes = static_cast<uint8_t>(options.optimize_meshes);
+    hash = HashBytes(&optimize_meshes, sizeof(optimize_meshes), hash);
+    const auto reorder_vertices = static_cast<uint8_t>(options.optimize_meshes && !options.reference_source_buffers);
+    hash = HashBytes(&reorder_vertices, sizeof(reorder_vertices), hash);
+    const auto build_meshlets = static_cast<uint8_t>(options.build_meshlets);
+    hash = HashBytes(&build_meshlets, sizeof(build_meshlets), hash);
+    return true;
+}
+
+std::string MeshCache::GetCachePath(const std::string& cache_directory,
+                                    const std::string& resource_path,
+                                    const MeshLoadOptions& options)
+{
+    std::string file_name = resource_path;
+    for(auto& c : file_name) {
+        if(c == '/' || c == '\\' || c == ':') {
+            c = '_';
+        }
+    }
+    // one file per vertex layout, so switching layouts doesn't keep rewriting the same file
+    file_name += "." + std::to_string(static_cast<int>(options.vertex_layout)) + ".meshcache";
+    if(cache_directory.empty() || cache_directory.back() == '/') {
+        return cache_directory + file_name;
+    }
+    return cache_directory + "/" + file_name;
+}
+
+std::unique_ptr<Model> MeshCache::Read(const std::string& cache_path, uint64_t source_hash)
+{
+    auto file = MappedFile::Open(cache_path);
+    if(!file || file->GetSize() < sizeof(FileHeader)) {
+        return nullptr;
+    }
+
+    FileHeader header{};
+    memcpy(&header, file->GetData(), sizeof(header));
+    if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+       || header.version != VERSION
+       || header.source_hash != source_hash
+       || header.file_size != file->GetSize()
+       || header.mesh_count > (file->GetSize() - sizeof(FileHeader)) / sizeof(MeshRecord)) {
+        return nullptr;
+    }
+
+    CacheReader reader(file);
+    auto model = std::make_unique<Model>();
+    std::vector<std::shared_ptr<ModelMesh>> meshes;
+    const auto* records = file->GetData() + sizeof(FileHeader);
+    for(uint32_t i = 0; i < header.mesh_count; ++i) {
+        MeshRecord record{};
+        memcpy(&record, records + i * sizeof(MeshRecord), sizeof(record));
+        if(record.vertex_layout < static_cast<int32_t>(VertexLayout::Separate)
+           || record.vertex_layout > static_cast<int32_t>(VertexLayout::PackedQuantized)) {
+            aout << "Err: malformed mesh cache " << cache_path << std::endl;
+            return nullptr;
+        }
+
+        auto mesh = std::make_shared<ModelMesh>();
+        memcpy(&mesh->_position_offset, record.position_offset, sizeof(record.position_offset));
+        memcpy(&mesh->_position_scale, record.position_scale, sizeof(record.position_scale));
+        memcpy(&mesh->_bounding_box.min, record.bbox_min, sizeof(record.bbox_min));
+        memcpy(&mesh->_bounding_box.max, record.bbox_max, sizeof(record.bbox_max));
+        memcpy(&mesh->_bounding_sphere.center, record.bsphere_center, sizeof(record.bsphere_center));
+        mesh->_bounding_sphere.radius = record.bsphere_radius;
+        mesh->_vertex_layout = static_cast<VertexLayout>(record.vertex_layout);
+        SharedArray<MeshLod> lods;
+        SharedArray<Meshlet> meshlets;
+        SharedArray<SubmeshRecord> submeshes;
+        bool ok = reader.ReadArray(record.vertices, mesh->_vertices)
+                  && reader.ReadIndices(record.indices, record.index_size, mesh->_indices)
+                  && reader.ReadArray(record.normals, mesh->_normals)
+                  && reader.ReadArray(record.tangents, mesh->_tangents)
+                  && reader.ReadArray(record.tex_coords, mesh->_tex_coords)
+                  && reader.ReadArray(record.packed_vertices, mesh->_packed_vertices)
+                  && reader.ReadIndices(record.lod_indices, record.lod_index_size, mesh->_lod_indices)
+                  && reader.ReadArray(record.lods, lods)
+                  && reader.ReadArray(record.meshlets, meshlets)
+                  && reader.ReadArray(record.submeshes, submeshes);
+        for(const auto& submesh_record : submeshes) {
+            Submesh submesh;
+            submesh.first_index = submesh_record.first_index;
+            submesh.index_count = submesh_record.index_count;
+            submesh.first_meshlet = submesh_record.first_meshlet;
+            submesh.meshlet_count = submesh_record.meshlet_count;
+            auto& material = submesh.material;
+            memcpy(&material._base_color_factor, submesh_record.base_color_factor, sizeof(submesh_record.base_color_factor));
+            memcpy(&material._emissive_factor, submesh_record.emissive_factor, sizeof(submesh_record.emissive_factor));
+            material._metallic_factor = submesh_record.metallic_factor;
+            material._roughness_factor = submesh_record.roughness_factor;
+            ok = ok && reader.ReadString(submesh_record.material_name, material._name)
+                 && reader.ReadTexture(submesh_record.base_color_texture, material._pbr_base_color_texture)
+                 && reader.ReadTexture(submesh_record.normal_texture, material._normal_texture)
+                 && size_t(submesh.first_index) + submesh.index_count <= mesh->_indices.size()
+                 && size_t(submesh.first_meshlet) + submesh.meshlet_count <= meshlets.size();
+            mesh->_submeshes.push_back(std::move(submesh));
+        }
+        // a level of detail has a range per submesh
+        ok = ok && (submeshes.empty() ? lods.empty() : lods.size() % submeshes.size() == 0);
+        if(!ok) {
+            aout << "Err: malformed mesh cache " << cache_path << std::endl;
+            return nullptr;
+        }
+        for(const auto& lod : lods) {
+            if(size_t(lod.first_index) + lod.index_count > mesh->_lod_indices.size()) {
+                aout << "Err: malformed mesh cache " << cache_path << std::endl;
+                return nullptr;
+            }
+        }
+        for(const auto& meshlet : meshlets) {
+            if(size_t(meshlet.first_index) + meshlet.index_count > mesh->_indices.size()) {
+                aout << "Err: malformed mesh cache " << cache_path << std::endl;
+                return nullptr;
+            }
+        }
+        mesh->_lods.assign(lods.begin(), lods.end());
+        mesh->_meshlets.assign(meshlets.begin(), meshlets.end());
+        meshes.emplace_back(std::move(mesh));
+    }
+
+    // rebuild the node hierarchy, and which node draws which mesh
+    SharedArray<NodeRecord> node_records;
+    SharedArray<InstanceRecord> instance_records;
+    if(!reader.ReadArray(header.nodes, node_records) || !reader.ReadArray(header.instances, instance_records)) {
+        aout << "Err: malformed mesh cache " << cache_path << std::endl;
+        return nullptr;
+    }
+    std::vector<ModelNode*> nodes;
+    for(const auto& record : node_records) {
+        std::string name;
+        if(record.parent >= static_cast<int32_t>(nodes.size()) || !reader.ReadString(record.name, name)) {
+            aout << "Err: malformed mesh cache " << cache_path << std::endl;
+            return nullptr;
+        }
+        auto* node = model->AddNode(name, record.parent >= 0 ? nodes[record.parent] : nullptr);
+        glm::mat4 local_transform;
+        memcpy(&local_transform, record.local_transform, sizeof(record.local_transform));
+        node->GetTransform().SetLocalMatrix(local_transform);
+        nodes.push_back(node);
+    }
+    for(const auto& record : instance_records) {
+        if(record.node >= static_cast<int32_t>(nodes.size()) || record.mesh >= meshes.size()) {
+            aout << "Err: malformed mesh cache " << cache_path << std::endl;
+            return nullptr;
+        }
+        model->AddMesh(meshes[record.mesh], record.node >= 0 ? nodes[record.node] : nullptr);
+    }
+    return model;
+}
+
+bool MeshCache::Write(Model& model, const std::string& cache_path, uint64_t source_hash)
+{
+    const auto& meshes = model.GetMeshes();
+    CacheWriter writer(sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord));
+
+    // textures are stored with all their mip levels, so uploading them doesn't need glGenerateMipmap.
+    // Textures sharing an image share its mip chain too.
+    std::unordered_map<uint64_t, const Texture*> mipmapped_images;
+    auto generate_mip_chain = [&mipmapped_images](Texture& texture) {
+        if(texture._cache_key != 0) {
+            auto found = mipmapped_images.find(texture._cache_key);
+            if(found != mipmapped_images.end()) {
+                texture._image_data = found->second->_image_data;
+                texture._mip_levels = found->second->_mip_levels;
+                return;
+            }
+            mipmapped_images[texture._cache_key] = &texture;
+        }
+        texture.GenerateMipChain();
+        texture._image_data.Share();
+    };
+
+    std::vector<MeshRecord> records(meshes.size());
+    for(size_t i = 0; i < meshes.size(); ++i) {
+        auto& mesh = *meshes[i];
+        std::vector<SubmeshRecord> submesh_records(mesh._submeshes.size());
+        for(size_t j = 0; j < mesh._submeshes.size(); ++j) {
+            auto& submesh = mesh._submeshes[j];
+            auto& material = submesh.material;
+            generate_mip_chain(material._pbr_base_color_texture);
+            generate_mip_chain(material._normal_texture);
+
+            auto& submesh_record = submesh_records[j];
+            submesh_record.first_index = submesh.first_index;
+            submesh_record.index_count = submesh.index_count;
+            submesh_record.first_meshlet = submesh.first_meshlet;
+            submesh_record.meshlet_count = submesh.meshlet_count;
+            submesh_record.material_name = writer.AppendString(material._name);
+            memcpy(submesh_record.base_color_factor, &material._base_color_factor, sizeof(submesh_record.base_color_factor));
+            memcpy(submesh_record.emissive_factor, &material._emissive_factor, sizeof(submesh_record.emissive_factor));
+            submesh_record.metallic_factor = material._metallic_factor;
+            submesh_record.roughness_factor = material._roughness_factor;
+            submesh_record.base_color_texture = writer.AppendTexture(material._pbr_base_color_texture);
+            submesh_record.normal_texture = writer.AppendTexture(material._normal_texture);
+        }
+
+        auto& record = records[i];
+        memcpy(record.position_offset, &mesh._position_offset, sizeof(record.position_offset));
+        memcpy(record.position_scale, &mesh._position_scale, sizeof(record.position_scale));
+        memcpy(record.bbox_min, &mesh._bounding_box.min, sizeof(record.bbox_min));
+        memcpy(record.bbox_max, &mesh._bounding_box.max, sizeof(record.bbox_max));
+        memcpy(record.bsphere_center, &mesh._bounding_sphere.center, sizeof(record.bsphere_center));
+        record.bsphere_radius = mesh._bounding_sphere.radius;
+        record.vertex_layout = static_cast<int32_t>(mesh._vertex_layout);
+        record.vertices = writer.AppendArray(mesh._vertices);
+        record.index_size = static_cast<uint16_t>(mesh._indices.GetIndexSize());
+        record.indices = writer.AppendArray(mesh._indices);
+        record.normals = writer.AppendArray(mesh._normals);
+        record.tangents = writer.AppendArray(mesh._tangents);
+        record.tex_coords = writer.AppendArray(mesh._tex_coords);
+        record.packed_vertices = writer.AppendArray(mesh._packed_vertices);
+        record.lod_index_size = static_cast<uint16_t>(mesh._lod_indices.GetIndexSize());
+        record.lod_indices = writer.AppendArray(mesh._lod_indices);
+        record.lods = writer.AppendArray(mesh._lods);
+        record.meshlets = writer.AppendArray(mesh._meshlets);
+        record.submeshes = writer.AppendArray(submesh_records);
+    }
+
+    // the node hierarchy, and which node draws which mesh, by index. -1 stands for the model itself.
+    std::unordered_map<const SceneNode*, int32_t> node_indices = {{&model, -1}};
+    std::vector<NodeRecord> node_records;
+    for(const auto& node : model.GetNodes()) {
+        NodeRecord record{};
+        const glm::mat4 local_transform = node->GetTransform().GetLocalMatrix();
+        memcpy(record.local_transform, &local_transform, sizeof(record.local_transform));
+        record.parent = node_indices.at(node->GetParent());
+        record.name = writer.AppendString(node->GetName());
+        node_indices[node.get()] = static_cast<int32_t>(node_records.size());
+        node_records.push_back(record);
+    }
+    std::vector<InstanceRecord> instance_records;
+    for(const auto& instance : model.GetMeshInstances()) {
+        InstanceRecord record{};
+        record.node = node_indices.at(instance.node);
+        record.mesh = static_cast<uint32_t>(std::find(meshes.begin(), meshes.end(), instance.mesh) - meshes.begin());
+        instance_records.push_back(record);
+    }
+    const BlobRef nodes_blob = writer.AppendArray(node_records);
+    const BlobRef instances_blob = writer.AppendArray(instance_records);
+
+    auto& bytes = writer.GetBytes();
+    FileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.source_hash = source_hash;
+    header.file_size = bytes.size();
+    header.mesh_count = static_cast<uint32_t>(meshes.size());
+    header.nodes = nodes_blob;
+    header.instances = instances_blob;
+    memcpy(bytes.data(), &header, sizeof(header));
+    if(!records.empty()) {
+        memcpy(bytes.data() + sizeof(FileHeader), records.data(), records.size() * sizeof(MeshRecord));
+    }
+
+    // write to a temporary file and rename it, so a reader never maps a partially written cache
+    const std::string temporary_path = cache_path + ".tmp";
+    FILE* file = fopen(temporary_path.c_str(), "wb");
+    if(file == nullptr) {
+        aout << "Warn: can't write mesh cache " << cache_path << std::endl;
+        return false;
+    }
+    const bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    const bool closed = fclose(file) == 0;
+    if(!written || !closed || rename(temporary_path.c_str(), cache_path.c_str()) != 0) {
+        remove(temporary_path.c_str());
+        aout << "Warn: can't write mesh cache " << cache_path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef MY_MOBILE_APP_MESHCACHE_H
+#define MY_MOBILE_APP_MESHCACHE_H
+
+#include "MeshModelLoaderBase.h"
+#include "Model.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*!
+ * Engine-native binary cache of loaded mesh models.
+ *
+ * A cache file holds the node hierarchy of the model, and the final vertex streams, indices,
+ * tangents, packed vertices, levels of detail, meshlets and fully mipped RGBA8 textures of every
+ * mesh, so loading it is one memory mapping that the meshes and textures reference in place: no
+ * glTF parsing, image decoding, tangent generation, mesh optimization, level of detail or meshlet
+ * generation.
+ *
+ * Files are stamped with a format version and a hash of the source asset, and are ignored when
+ * either doesn't match. They are written in native byte order, they are meant to stay on the
+ * device that wrote them.
+ */
+class MeshCache
+{
+public:
+    // bump whenever the file layout, or the meaning of the cached data, changes
+    static constexpr uint32_t VERSION = 12;
+
+    /*!
+     * Hashes the source asset, the external files (buffers, images) it references, and the load
+     * options that change the cached data.
+     * @return false if the asset can't be read
+     */
+    static bool HashSourceAsset(const std::string& resource_path, const MeshLoadOptions& options, uint64_t& hash);
+
+    /*!
+     * @return the path of the cache file for the given asset and options, inside cache_directory
+     */
+    static std::string GetCachePath(const std::string& cache_directory,
+                                    const std::string& resource_path,
+                                    const MeshLoadOptions& options);
+
+    /*!
+     * Maps a cache file and builds the model from it.
+     * @return the model, or null if the file is missing, malformed, from another format version or
+     *         from another source asset
+     */
+    static std::unique_ptr<Model> Read(const std::string& cache_path, uint64_t source_hash);
+
+    /*!
+     * Writes the model to a cache file. Generates the mip chain of the model's textures, if they
+     * don't have one yet.
+     * @return false if the file couldn't be written
+     */
+    static bool Write(Model& model, const std::string& cache_path, uint64_t source_hash);
+};
+
+#endif //MY_MOBILE_APP_MESHCACHE_H
@@ -1,14 +1,89 @@
 #include "MeshModelBuilder.h"
 #include "GltfMeshModelLoader.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
 
+#include <cmath>
 #include <memory>
 
 
-std::unique_ptr <Model> MeshModelBuilder::CreateMeshModel(const std::string &resource_path)
+std::unique_ptr <Model> MeshModelBuilder::CreateMeshModel(
+        const std::string &resource_path,
+        const MeshLoadOptions& options)
 {
-    GltfMeshModelLoader model_loader;
+    uint64_t source_hash = 0;
+    std::string cache_path;
+    if(!options.cache_directory.empty() && MeshCache::HashSourceAsset(resource_path, options, source_hash)) {
+        cache_path = MeshCache::GetCachePath(options.cache_directory, resource_path, options);
+        if(auto cached_model = MeshCache::Read(cache_path, source_hash)) {
+            return cached_model;
+        }
+    }
+
+    GltfMeshModelLoader model_loader(options);
 
     auto mesh_model = model_loader.LoadModel(resource_path);
 
+    // cache the loaded model for the next launch
+    if(mesh_model && !cache_path.empty()) {
+        MeshCache::Write(*mesh_model, cache_path, source_hash);
+    }
+
     return mesh_model;
 }
+
+std::future<std::unique_ptr<Model>> MeshModelBuilder::CreateMeshModelAsync(
+        const std::string& resource_path,
+        const MeshLoadOptions& options)
+{
+    return JobSystem::GetShared().Submit([resource_path, options]() {
+        return CreateMeshModel(resource_path, options);
+    });
+}
+
+std::unique_ptr<Model> MeshModelBuilder::CreatePlaceholderModel()
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> tex_coords;
+    std::vector<Index> indices;
+
+    // a unit cube centered on the origin, four vertices per face so each face gets its own normal.
+    const glm::vec3 face_normals[] = {
+            glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+            glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+            glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+    };
+    for(const auto& normal : face_normals) {
+        // two axes spanning the face, with u x v = normal so the faces wind counter-clockwise
+        const glm::vec3 u = std::abs(normal.y) > 0.5f ? glm::vec3(0.0f, 0.0f, normal.y) : glm::vec3(-normal.z, 0.0f, normal.x);
+        const glm::vec3 v = glm::cross(normal, u);
+        const auto first = static_cast<Index>(vertices.size());
+        const glm::vec2 corners[] = {glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(1, 1), glm::vec2(0, 1)};
+        for(const auto& corner : corners) {
+            vertices.push_back(0.5f * (normal + (corner.x * 2.0f - 1.0f) * u + (corner.y * 2.0f - 1.0f) * v));
+            normals.push_back(normal);
+            tex_coords.push_back(corner);
+        }
+        const Index face_indices[] = {0, 1, 2, 0, 2, 3};
+        for(auto index : face_indices) {
+            indices.push_back(static_cast<Index>(first + index));
+        }
+    }
+
+    auto mesh = std::make_shared<ModelMesh>();
+    mesh->_vertices = std::move(vertices);
+    mesh->_normals = std::move(normals);
+    mesh->_tex_coords = std::move(tex_coords);
+    mesh->_indices = IndexArray(std::move(indices), mesh->_vertices.size());
+    Submesh submesh;
+    submesh.index_count = static_cast<uint32_t>(mesh->_indices.size());
+    submesh.material._name = "placeholder";
+    mesh->_submeshes.push_back(std::move(submesh));
+    mesh->ComputeBounds();
+    mesh->ComputeTangentSpace();
+
+    auto model = std::make_unique<Model>();
+    model->AddMesh(mesh);
+    return model;
+}
@@ -4,13 +4,31 @@
 #include "MeshModelLoaderBase.h"
 #include "Model.h"
 
+#include <future>
 #include <memory>
 
 class MeshModelBuilder
 {
 public:
 
-    static std::unique_ptr<Model> CreateMeshModel(const std::string& resource_path);
+    static std::unique_ptr<Model> CreateMeshModel(
+            const std::string& resource_path,
+            const MeshLoadOptions& options = MeshLoadOptions());
+
+    /*!
+     * Loads a model in the background, on the shared job system: parsing, image decoding and tangent
+     * generation all happen off the calling thread. The model's gpu resources are created later, by
+     * the renderer (see RenderObject::ApplyMeshModel).
+     * @return a future with the model, or with null if loading failed
+     */
+    static std::future<std::unique_ptr<Model>> CreateMeshModelAsync(
+            const std::string& resource_path,
+            const MeshLoadOptions& options = MeshLoadOptions());
+
+    /*!
+     * @return a small untextured cube, to draw while the actual model is loading
+     */
+    static std::unique_ptr<Model> CreatePlaceholderModel();
 
 };
 
@@ -4,13 +4,53 @@
 #include "Model.h"
 
 #include <string>
+#include <vector>
+
+/*!
+ * Options controlling how a loader builds the engine meshes.
+ */
+struct MeshLoadOptions
+{
+    // layout of the vertex data uploaded to the gpu. The packed layouts roughly halve vertex memory
+    // and vertex-fetch bandwidth.
+    VertexLayout vertex_layout = VertexLayout::Separate;
+    // reference vertex attributes and indices directly inside the loaded asset buffers (or, for .glb
+    // files, inside the memory-mapped file) instead of copying them into each mesh. This keeps the
+    // whole source buffer alive for as long as any mesh uses it.
+    bool reference_source_buffers = false;
+    // directory of the engine's binary mesh cache (see MeshCache). When set, a model is loaded from
+    // its cache file if it's up to date with the source asset, and the cache file is written after
+    // loading the source asset otherwise. Empty disables the cache.
+    std::string cache_directory;
+    // the compressed texture formats the gpu samples, see TextureAsset::getCompressedTextureFormats().
+    // An image with a KTX2 version next to it (same path, .ktx2 extension) is loaded from it, mip
+    // chain included, rather than decoded, if it's in one of these formats or uncompressed.
+    std::vector<GLenum> compressed_texture_formats;
+    // the levels of detail generated per mesh, besides the full one, by their target error relative
+    // to the mesh's bounding radius, e.g. {0.005, 0.01, 0.02}. Each level halves the previous one's
+    // triangles, unless that takes more than its error. Empty generates none.
+    std::vector<float> lod_errors;
+    // reorder each mesh's triangles and vertices for the gpu's vertex cache, overdraw and vertex
+    // fetch (see MeshOptimizer). The meshes then own their indices and vertex streams rather than
+    // reference the source buffers. With reference_source_buffers, only the triangles are
+    // reordered: the vertex streams stay in the source buffers, in their order.
+    bool optimize_meshes = true;
+    // split each mesh's triangles in meshlets (see Meshlet), which the renderer culls one by one
+    // against the view and by the way they face: worth it for dense meshes seen from one side at a
+    // time, whose instances are then drawn one by one though.
+    bool build_meshlets = false;
+};
 
 class MeshModelLoaderBase
 {
 public:
+    explicit MeshModelLoaderBase(const MeshLoadOptions& options = MeshLoadOptions()) : _options(options) {}
+    virtual ~MeshModelLoaderBase() = default;
 
     virtual std::unique_ptr<Model> LoadModel(const std::string &resource_path) = 0;
 
+protected:
+    MeshLoadOptions _options;
 };
 
 
@@ -0,0 +1,258 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+/*!
+ * A FIFO post-transform cache: a vertex is in it until cache_size more vertices got shaded.
+ */
+class VertexCache
+{
+public:
+    VertexCache(size_t vertex_count, int cache_size)
+    : _timestamps(vertex_count, 0)
+    , _cache_size(static_cast<size_t>(cache_size))
+    , _time(static_cast<size_t>(cache_size) + 1) {}
+
+    // @return true if the vertex had to be shaded
+    inline bool Use(Index vertex) {
+        if(_time - _timestamps[vertex] <= _cache_size) {
+            return false;
+        }
+        _timestamps[vertex] = _time++;
+        return true;
+    }
+
+    // evicts every vertex
+    inline void Flush() {
+        _time += _cache_size + 1;
+    }
+
+private:
+    std::vector<size_t> _timestamps;
+    size_t _cache_size;
+    size_t _time;
+};
+
+/*!
+ * The triangles using each vertex: those of vertex v are triangles[offsets[v]] to
+ * triangles[offsets[v + 1]] excluded.
+ */
+void BuildVertexTriangles(const Index* indices, size_t index_count, size_t vertex_count,
+                          std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+{
+    offsets.assign(vertex_count + 1, 0);
+    for(size_t i = 0; i < index_count; ++i) {
+        offsets[indices[i] + 1] += 1;
+    }
+    for(size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    triangles.resize(index_count);
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < index_count; ++i) {
+        triangles[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+} // namespace
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const Index* indices, size_t index_count,
+                                                                        size_t vertex_count, int cache_size)
+{
+    VertexCacheStatistics statistics;
+    statistics.triangle_count = index_count / 3;
+    VertexCache cache(vertex_count, cache_size);
+    std::vector<char> used(vertex_count, 0);
+    for(size_t i = 0; i < index_count; ++i) {
+        statistics.miss_count += cache.Use(indices[i]) ? 1 : 0;
+        if(!used[indices[i]]) {
+            used[indices[i]] = 1;
+            statistics.vertex_count += 1;
+        }
+    }
+    return statistics;
+}
+
+std::vector<Index> MeshOptimizer::OptimizeVertexCache(const Index* indices, size_t index_count, size_t vertex_count,
+                                                      int cache_size)
+{
+    std::vector<Index> result;
+    result.reserve(index_count);
+    if(index_count < 3) {
+        return result;
+    }
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> vertex_triangles;
+    BuildVertexTriangles(indices, index_count, vertex_count, offsets, vertex_triangles);
+    // the triangles left to emit around each vertex
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for(size_t v = 0; v < vertex_count; ++v) {
+        live_triangles[v] = offsets[v + 1] - offsets[v];
+    }
+    std::vector<char> emitted(index_count / 3, 0);
+    // the time each vertex last entered the cache: it's in the cache while time - timestamp <= cache_size
+    std::vector<size_t> timestamps(vertex_count, 0);
+    size_t time = static_cast<size_t>(cache_size) + 1;
+    // the vertices emitted, to fall back on when the fanning vertex's neighbours are all done
+    std::vector<Index> dead_ends;
+    std::vector<Index> candidates;
+    size_t cursor = 0;
+
+    // fan around a vertex, emitting all its triangles, then move on to the neighbour most likely to
+    // still be in the cache once its own triangles are emitted
+    auto next_live_vertex = [&]() -> long {
+        while(!dead_ends.empty()) {
+            const Index vertex = dead_ends.back();
+            dead_ends.pop_back();
+            if(live_triangles[vertex] > 0) {
+                return vertex;
+            }
+        }
+        for(; cursor < vertex_count; ++cursor) {
+            if(live_triangles[cursor] > 0) {
+                return static_cast<long>(cursor);
+            }
+        }
+        return -1;
+    };
+    long fanning = next_live_vertex();
+    while(fanning >= 0) {
+        candidates.clear();
+        for(uint32_t j = offsets[fanning]; j < offsets[fanning + 1]; ++j) {
+            const uint32_t triangle = vertex_triangles[j];
+            if(emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = 1;
+            for(int k = 0; k < 3; ++k) {
+                const Index vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                dead_ends.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex] -= 1;
+                if(time - timestamps[vertex] > static_cast<size_t>(cache_size)) {
+                    timestamps[vertex] = time++;
+                }
+            }
+        }
+
+        // a candidate still in the cache after its remaining triangles add up to 2 vertices each,
+        // the oldest first; any live one otherwise
+        long best = -1;
+        long best_priority = -1;
+        for(Index vertex : candidates) {
+            if(live_triangles[vertex] == 0) {
+                continue;
+            }
+            long priority = 0;
+            const size_t age = time - timestamps[vertex];
+            if(age + 2 * live_triangles[vertex] <= static_cast<size_t>(cache_size)) {
+                priority = static_cast<long>(age);
+            }
+            if(priority > best_priority) {
+                best = vertex;
+                best_priority = priority;
+            }
+        }
+        fanning = best >= 0 ? best : next_live_vertex();
+    }
+    return result;
+}
+
+std::vector<Index> MeshOptimizer::OptimizeOverdraw(const Index* indices, size_t index_count, const glm::vec3* positions,
+                                                   size_t vertex_count, float threshold, int cache_size)
+{
+    const size_t triangle_count = index_count / 3;
+    if(triangle_count < 2) {
+        return std::vector<Index>(indices, indices + index_count);
+    }
+
+    // split where the cluster so far costs no more cache misses per triangle than the threshold
+    // allows. Each cluster then starts with a cold cache, as it may be drawn after any other.
+    const float cluster_acmr = AnalyzeVertexCache(indices, index_count, vertex_count, cache_size).GetAcmr() * threshold;
+    std::vector<size_t> cluster_starts = {0};
+    VertexCache cache(vertex_count, cache_size);
+    size_t cluster_misses = 0;
+    for(size_t t = 0; t + 1 < triangle_count; ++t) {
+        for(int k = 0; k < 3; ++k) {
+            cluster_misses += cache.Use(indices[t * 3 + k]) ? 1 : 0;
+        }
+        if(float(cluster_misses) <= cluster_acmr * float(t + 1 - cluster_starts.back())) {
+            cluster_starts.push_back(t + 1);
+            cluster_misses = 0;
+            cache.Flush();
+        }
+    }
+    cluster_starts.push_back(triangle_count);
+
+    // the area weighted centroid and normal of each cluster, and of the mesh
+    struct Cluster {
+        size_t start;
+        size_t end;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        float sort_value;
+    };
+    std::vector<Cluster> clusters;
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for(size_t c = 0; c + 1 < cluster_starts.size(); ++c) {
+        Cluster cluster{cluster_starts[c], cluster_starts[c + 1], glm::vec3(0.0f), glm::vec3(0.0f), 0.0f};
+        float area = 0.0f;
+        for(size_t t = cluster.start; t < cluster.end; ++t) {
+            const glm::vec3& p0 = positions[indices[t * 3]];
+            const glm::vec3& p1 = positions[indices[t * 3 + 1]];
+            const glm::vec3& p2 = positions[indices[t * 3 + 2]];
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float triangle_area = glm::length(normal);
+            cluster.centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            cluster.normal += normal;
+            area += triangle_area;
+        }
+        mesh_centroid += cluster.centroid;
+        mesh_area += area;
+        cluster.centroid = area > 0.0f ? cluster.centroid / area : positions[indices[cluster.start * 3]];
+        clusters.push_back(cluster);
+    }
+    mesh_centroid = mesh_area > 0.0f ? mesh_centroid / mesh_area : glm::vec3(0.0f);
+
+    // clusters facing away from the center are on the outside: drawn first, they hide the others
+    for(auto& cluster : clusters) {
+        const float length = glm::length(cluster.normal);
+        cluster.sort_value = length > 0.0f ? glm::dot(cluster.centroid - mesh_centroid, cluster.normal / length) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster& a, const Cluster& b) { return a.sort_value > b.sort_value; });
+
+    std::vector<Index> result;
+    result.reserve(index_count);
+    for(const auto& cluster : clusters) {
+        result.insert(result.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+    }
+    return result;
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(Index* indices, size_t index_count, size_t vertex_count)
+{
+    constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertex_count, UNUSED);
+    std::vector<uint32_t> order;
+    order.reserve(vertex_count);
+    for(size_t i = 0; i < index_count; ++i) {
+        if(remap[indices[i]] == UNUSED) {
+            remap[indices[i]] = static_cast<uint32_t>(order.size());
+            order.push_back(indices[i]);
+        }
+        indices[i] = static_cast<Index>(remap[indices[i]]);
+    }
+    for(size_t v = 0; v < vertex_count; ++v) {
+        if(remap[v] == UNUSED) {
+            order.push_back(static_cast<uint32_t>(v));
+        }
+    }
+    return order;
+}
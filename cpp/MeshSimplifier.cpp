@@ -0,0 +1,265 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+/*!
+ * The sum of the squared distances to a set of planes, weighted by area: Q(p) = p^T A p + 2 b.p + c
+ * with A symmetric, stored as its upper triangle.
+ */
+struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    // adds the plane through point with the given unit normal
+    void AddPlane(const glm::vec3& normal, const glm::vec3& point, double plane_weight) {
+        const double n0 = normal.x, n1 = normal.y, n2 = normal.z;
+        const double d = -(n0 * point.x + n1 * point.y + n2 * point.z);
+        a00 += plane_weight * n0 * n0;
+        a01 += plane_weight * n0 * n1;
+        a02 += plane_weight * n0 * n2;
+        a11 += plane_weight * n1 * n1;
+        a12 += plane_weight * n1 * n2;
+        a22 += plane_weight * n2 * n2;
+        b0 += plane_weight * n0 * d;
+        b1 += plane_weight * n1 * d;
+        b2 += plane_weight * n2 * d;
+        c += plane_weight * d * d;
+        weight += plane_weight;
+    }
+
+    void Add(const Quadric& other) {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02;
+        a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // the mean squared distance of the point to the planes
+    double Error(const glm::vec3& point) const {
+        const double x = point.x, y = point.y, z = point.z;
+        const double error = a00 * x * x + a11 * y * y + a22 * z * z
+                             + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                             + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3& position) const {
+        uint32_t bits[3];
+        memcpy(bits, &position, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+// moving vertex `from` onto vertex `to`, a wedge of the other end of one of its edges
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+};
+
+inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+} // namespace
+
+std::vector<Index> MeshSimplifier::Simplify(const Index* indices,
+                                            size_t index_count,
+                                            const glm::vec3* positions,
+                                            size_t vertex_count,
+                                            size_t target_index_count,
+                                            float target_error,
+                                            float& result_error)
+{
+    std::vector<Index> result(indices, indices + index_count);
+    result_error = 0.0f;
+    if(index_count <= target_index_count) {
+        return result;
+    }
+
+    // weld the vertices sharing a position: the first of them stands for all of them
+    std::vector<uint32_t> welded(vertex_count);
+    std::vector<uint32_t> wedge_counts(vertex_count, 0);
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> first_vertices;
+    for(size_t i = 0; i < vertex_count; ++i) {
+        // + 0 turns -0 into 0, which compares equal but hashes differently
+        welded[i] = first_vertices.emplace(positions[i] + 0.0f, static_cast<uint32_t>(i)).first->second;
+        wedge_counts[welded[i]] += 1;
+    }
+
+    // lock the seams, and the border and non-manifold edges: every edge of a closed manifold is used
+    // once in each direction
+    std::vector<char> locked(vertex_count, 0);
+    for(size_t i = 0; i < vertex_count; ++i) {
+        locked[welded[i]] |= wedge_counts[welded[i]] > 1;
+    }
+    std::unordered_map<uint64_t, int> edge_uses;
+    for(size_t i = 0; i < result.size(); ++i) {
+        const size_t next = i - i % 3 + (i + 1) % 3;
+        edge_uses[EdgeKey(welded[result[i]], welded[result[next]])] += 1;
+    }
+    for(const auto& edge : edge_uses) {
+        const uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+        const uint32_t b = static_cast<uint32_t>(edge.first);
+        const auto reverse = edge_uses.find(EdgeKey(b, a));
+        if(edge.second != 1 || reverse == edge_uses.end() || reverse->second != 1) {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    // every vertex starts with the planes of its triangles
+    std::vector<Quadric> quadrics(vertex_count);
+    for(size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3& p0 = positions[result[i]];
+        const glm::vec3 normal = glm::cross(positions[result[i + 1]] - p0, positions[result[i + 2]] - p0);
+        const float length = glm::length(normal);
+        if(length > 0.0f) {
+            for(int k = 0; k < 3; ++k) {
+                quadrics[welded[result[i + k]]].AddPlane(normal / length, p0, 0.5 * length);
+            }
+        }
+    }
+
+    const double error_limit = double(target_error) * double(target_error);
+    double max_error = 0.0;
+    size_t triangle_count = result.size() / 3;
+    const size_t target_triangle_count = target_index_count / 3;
+    std::vector<uint32_t> collapse_targets(vertex_count);
+    std::vector<char> touched(vertex_count);
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+    std::vector<uint32_t> vertex_triangles;
+
+    // passes of independent collapses, cheapest first, until the target or the error limit is reached
+    while(triangle_count > target_triangle_count) {
+        collapses.clear();
+        for(size_t i = 0; i < result.size(); ++i) {
+            const uint32_t wedges[2] = {result[i], result[i - i % 3 + (i + 1) % 3]};
+            for(int end = 0; end < 2; ++end) {
+                const uint32_t from = welded[wedges[end]];
+                const uint32_t to = wedges[1 - end];
+                if(locked[from] || from == welded[to]) {
+                    continue;
+                }
+                Quadric quadric = quadrics[from];
+                quadric.Add(quadrics[welded[to]]);
+                const double error = quadric.Error(positions[to]);
+                if(error <= error_limit) {
+                    collapses.push_back({from, to, error});
+                }
+            }
+        }
+        if(collapses.empty()) {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.error != b.error ? a.error < b.error : (a.from != b.from ? a.from < b.from : a.to < b.to);
+        });
+
+        // the triangles around each vertex
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for(Index index : result) {
+            triangle_offsets[welded[index] + 1] += 1;
+        }
+        for(size_t i = 0; i < vertex_count; ++i) {
+            triangle_offsets[i + 1] += triangle_offsets[i];
+        }
+        vertex_triangles.resize(result.size());
+        {
+            std::vector<uint32_t> filled(triangle_offsets.begin(), triangle_offsets.end() - 1);
+            for(size_t i = 0; i < result.size(); ++i) {
+                vertex_triangles[filled[welded[result[i]]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        for(size_t i = 0; i < vertex_count; ++i) {
+            collapse_targets[i] = static_cast<uint32_t>(i);
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t collapsed = 0;
+        for(const auto& collapse : collapses) {
+            if(triangle_count <= target_triangle_count) {
+                break;
+            }
+            const uint32_t to = welded[collapse.to];
+            if(touched[collapse.from] || touched[to]) {
+                continue;
+            }
+
+            // reject collapses folding a triangle over: its normal may not turn by more than ~75 degrees
+            bool flips = false;
+            size_t removed = 0;
+            for(uint32_t j = triangle_offsets[collapse.from]; j < triangle_offsets[collapse.from + 1] && !flips; ++j) {
+                const Index* triangle = &result[size_t(vertex_triangles[j]) * 3];
+                glm::vec3 corners[3];
+                bool has_to = false;
+                for(int k = 0; k < 3; ++k) {
+                    corners[k] = positions[triangle[k]];
+                    has_to |= welded[triangle[k]] == to;
+                }
+                if(has_to) {
+                    // the collapse removes it
+                    ++removed;
+                    continue;
+                }
+                const glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                for(int k = 0; k < 3; ++k) {
+                    if(welded[triangle[k]] == collapse.from) {
+                        corners[k] = positions[collapse.to];
+                    }
+                }
+                const glm::vec3 moved_normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                flips = glm::dot(normal, moved_normal) <= 0.25f * glm::length(normal) * glm::length(moved_normal);
+            }
+            if(flips) {
+                continue;
+            }
+
+            collapse_targets[collapse.from] = collapse.to;
+            quadrics[to].Add(quadrics[collapse.from]);
+            max_error = std::max(max_error, collapse.error);
+            // its triangles change: leave their vertices alone until the next pass
+            for(uint32_t j = triangle_offsets[collapse.from]; j < triangle_offsets[collapse.from + 1]; ++j) {
+                for(int k = 0; k < 3; ++k) {
+                    touched[welded[result[size_t(vertex_triangles[j]) * 3 + k]]] = 1;
+                }
+            }
+            triangle_count -= std::min(removed, triangle_count);
+            ++collapsed;
+        }
+        if(collapsed == 0) {
+            break;
+        }
+
+        // move the collapsed vertices, and drop the triangles that became degenerate. A collapsed
+        // vertex has no other wedge, so its index can be replaced everywhere.
+        size_t kept = 0;
+        for(size_t i = 0; i < result.size(); i += 3) {
+            const Index triangle[3] = {static_cast<Index>(collapse_targets[result[i]]),
+                                       static_cast<Index>(collapse_targets[result[i + 1]]),
+                                       static_cast<Index>(collapse_targets[result[i + 2]])};
+            if(welded[triangle[0]] != welded[triangle[1]] && welded[triangle[1]] != welded[triangle[2]]
+               && welded[triangle[2]] != welded[triangle[0]]) {
+                std::copy(triangle, triangle + 3, result.begin() + kept);
+                kept += 3;
+            }
+        }
+        result.resize(kept);
+        triangle_count = kept / 3;
+    }
+
+    result_error = static_cast<float>(std::sqrt(max_error));
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef MY_MOBILE_APP_MESHSIMPLIFIER_H
+#define MY_MOBILE_APP_MESHSIMPLIFIER_H
+
+#include "Utility.h"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/*!
+ * Simplifies triangle meshes by quadric error edge collapses (Garland and Heckbert).
+ *
+ * Every vertex accumulates the planes of its triangles in a quadric, which measures the squared
+ * distance of a point to them. Edges are collapsed cheapest first, moving one end onto the other,
+ * so the simplified triangles draw a subset of the original vertices: a level of detail only needs
+ * its own indices.
+ *
+ * Vertices sharing a position (e.g. across a uv seam) are welded for the topology, but vertices on
+ * a seam or on the border of the mesh stay where they are, so its outline and its texture mapping
+ * don't tear.
+ */
+class MeshSimplifier
+{
+public:
+    /*!
+     * @param indices a triangle list
+     * @param positions the vertex positions the indices refer to
+     * @param target_index_count stop once at most this many indices are left
+     * @param target_error the largest distance the simplified surface may get off the original one,
+     *                     in the positions' space
+     * @param result_error set to the largest error of the collapses made
+     * @return the simplified triangle list, referring to the same vertices
+     */
+    static std::vector<Index> Simplify(const Index* indices,
+                                       size_t index_count,
+                                       const glm::vec3* positions,
+                                       size_t vertex_count,
+                                       size_t target_index_count,
+                                       float target_error,
+                                       float& result_error);
+};
+
+#endif //MY_MOBILE_APP_MESHSIMPLIFIER_H
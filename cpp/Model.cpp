@@ -1,4 +1,12 @@
 #include "Model.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 
 void ModelMesh::ComputeTangentSpace()
@@ -25,7 +33,7 @@ void ModelMesh::ComputeTangentSpace()
     if (!_indices.empty()) {
         assert(_indices.size() % 3 == 0);
         for (decltype(totalIndices) i = 0; i < totalIndices; i += 3) {
-            glm::ivec3 triangle(_indices.at(i), _indices.at(i + 1), _indices.at(i + 2));
+            glm::ivec3 triangle(_indices[i], _indices[i + 1], _indices[i + 2]);
             ComputeTangentSpaceHelper(triangle, hasValidNormals, tangentAverager);
         }
     } else {
@@ -36,12 +44,14 @@ void ModelMesh::ComputeTangentSpace()
         }
     }
 
+    auto& tangents = _tangents.Edit();
     for (decltype(totalVertices) i = 0; i < totalVertices; ++i) {
-        auto& tangent_ref = _tangents.at(i);
-        tangent_ref = glm::normalize(_tangents.at(i) / static_cast<float>(tangentAverager[i]));
+        auto& tangent_ref = tangents.at(i);
+        tangent_ref = glm::normalize(tangents.at(i) / static_cast<float>(tangentAverager[i]));
         tangent_ref.w = 1.0;
         if (!hasValidNormals) {
-            _normals.at(i) = glm::normalize(_normals.at(i) / static_cast<float>(tangentAverager[i]));
+            auto& normal_ref = _normals.Edit().at(i);
+            normal_ref = glm::normalize(normal_ref / static_cast<float>(tangentAverager[i]));
         }
     }
 }
@@ -66,12 +76,536 @@ void ModelMesh::ComputeTangentSpaceHelper(glm::ivec3 triangleVertexIndices, bool
             tangent = glm::cross(bitangent, currentNormal);
         } else {
             tangent = (deltaPos21 - bitangent * deltaUV21.y) / deltaUV21.x;
-            _normals.at(i) += glm::cross(tangent, bitangent);
+            _normals.Edit().at(i) += glm::cross(tangent, bitangent);
         }
 
         glm::vec4 add_tangent = glm::vec4(tangent, 0);
-        _tangents.at(i) += add_tangent;
+        _tangents.Edit().at(i) += add_tangent;
 
         ++averager[i];
     }
 }
+
+void ModelMesh::ComputeBounds()
+{
+    _bounding_box = BoundingBox();
+    for(const auto& vertex : _vertices) {
+        _bounding_box.Extend(vertex);
+    }
+    // centered on the box, which is at most a little looser than the minimal sphere
+    _bounding_sphere = BoundingSphere();
+    if(!_bounding_box.IsEmpty()) {
+        _bounding_sphere.center = _bounding_box.GetCenter();
+        float radius_squared = 0.0f;
+        for(const auto& vertex : _vertices) {
+            const glm::vec3 offset = vertex - _bounding_sphere.center;
+            radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+        }
+        _bounding_sphere.radius = std::sqrt(radius_squared);
+    }
+}
+
+void ModelMesh::SetBounds(const BoundingBox& box)
+{
+    _bounding_box = box;
+    _bounding_sphere = BoundingSphere();
+    if(!box.IsEmpty()) {
+        _bounding_sphere.center = box.GetCenter();
+        _bounding_sphere.radius = glm::length(box.GetExtents());
+    }
+}
+
+void ModelMesh::PackVertices(VertexLayout layout)
+{
+    _vertex_layout = layout;
+    _packed_vertices = std::vector<u_char>();
+    _position_offset = glm::vec3(0.0f);
+    _position_scale = glm::vec3(1.0f);
+    if(layout == VertexLayout::Separate) {
+        return;
+    }
+
+    const auto vertex_count = _vertices.size();
+    auto packed_normal = [this](size_t i) {
+        return i < _normals.size() ? glm::packSnorm3x10_1x2(glm::vec4(_normals[i], 0.0f)) : 0u;
+    };
+    auto packed_tangent = [this](size_t i) {
+        return i < _tangents.size() ? glm::packSnorm3x10_1x2(_tangents[i]) : 0u;
+    };
+    auto pack_uv = [this](size_t i, uint16_t uv[2]) {
+        glm::vec2 tex_coord = i < _tex_coords.size() ? _tex_coords[i] : glm::vec2(0.0f);
+        uv[0] = glm::packHalf1x16(tex_coord.x);
+        uv[1] = glm::packHalf1x16(tex_coord.y);
+    };
+
+    if(layout == VertexLayout::Packed) {
+        auto& packed_bytes = _packed_vertices.Edit();
+        packed_bytes.resize(vertex_count * sizeof(PackedVertex));
+        auto* packed = reinterpret_cast<PackedVertex*>(packed_bytes.data());
+        for(size_t i = 0; i < vertex_count; ++i) {
+            packed[i].position = _vertices[i];
+            packed[i].normal = packed_normal(i);
+            packed[i].tangent = packed_tangent(i);
+            pack_uv(i, packed[i].uv);
+        }
+        return;
+    }
+
+    // quantize the positions relative to the mesh bounds: the box center maps to 0, its faces to -1/+1
+    glm::vec3 bbox_min(std::numeric_limits<float>::max());
+    glm::vec3 bbox_max(std::numeric_limits<float>::lowest());
+    for(const auto& vertex : _vertices) {
+        bbox_min = glm::min(bbox_min, vertex);
+        bbox_max = glm::max(bbox_max, vertex);
+    }
+    if(vertex_count > 0) {
+        _position_offset = (bbox_min + bbox_max) * 0.5f;
+        // avoid a zero scale on flat meshes
+        _position_scale = glm::max((bbox_max - bbox_min) * 0.5f, glm::vec3(1e-6f));
+    }
+
+    auto& quantized_bytes = _packed_vertices.Edit();
+    quantized_bytes.resize(vertex_count * sizeof(QuantizedVertex));
+    auto* quantized = reinterpret_cast<QuantizedVertex*>(quantized_bytes.data());
+    for(size_t i = 0; i < vertex_count; ++i) {
+        const glm::vec3 position = (_vertices[i] - _position_offset) / _position_scale;
+        quantized[i].position[0] = static_cast<int16_t>(glm::packSnorm1x16(position.x));
+        quantized[i].position[1] = static_cast<int16_t>(glm::packSnorm1x16(position.y));
+        quantized[i].position[2] = static_cast<int16_t>(glm::packSnorm1x16(position.z));
+        quantized[i].position[3] = 0;
+        quantized[i].normal = packed_normal(i);
+        quantized[i].tangent = packed_tangent(i);
+        pack_uv(i, quantized[i].uv);
+    }
+}
+
+namespace {
+
+// reorders a vertex stream to order[new vertex] = old vertex, unless it isn't one per vertex
+template<typename T>
+void ReorderVertices(SharedArray<T>& stream, const std::vector<uint32_t>& order)
+{
+    if(stream.size() != order.size()) {
+        return;
+    }
+    std::vector<T> reordered(order.size());
+    for(size_t i = 0; i < order.size(); ++i) {
+        reordered[i] = stream[order[i]];
+    }
+    stream = std::move(reordered);
+}
+
+// the bounds and normal cone of a meshlet's triangles
+void ComputeMeshletBounds(Meshlet& meshlet, const Index* indices, const glm::vec3* positions)
+{
+    BoundingBox box;
+    for(uint32_t i = 0; i < meshlet.index_count; ++i) {
+        box.Extend(positions[indices[meshlet.first_index + i]]);
+    }
+    meshlet.bounds.center = box.GetCenter();
+    float radius_squared = 0.0f;
+    for(uint32_t i = 0; i < meshlet.index_count; ++i) {
+        const glm::vec3 offset = positions[indices[meshlet.first_index + i]] - meshlet.bounds.center;
+        radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+    }
+    meshlet.bounds.radius = std::sqrt(radius_squared);
+
+    // the cone around the average of the (front facing, counter-clockwise) triangle normals
+    std::vector<glm::vec3> normals;
+    glm::vec3 normal_sum(0.0f);
+    for(uint32_t i = 0; i < meshlet.index_count; i += 3) {
+        const glm::vec3& p0 = positions[indices[meshlet.first_index + i]];
+        const glm::vec3& p1 = positions[indices[meshlet.first_index + i + 1]];
+        const glm::vec3& p2 = positions[indices[meshlet.first_index + i + 2]];
+        const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        // degenerate triangles are never drawn, whichever way they face
+        if(length > 0.0f) {
+            normals.push_back(normal / length);
+            normal_sum += normals.back();
+        }
+    }
+    meshlet.cone_axis = glm::vec3(0.0f);
+    meshlet.cone_cutoff = 2.0f;
+    const float sum_length = glm::length(normal_sum);
+    if(normals.empty() || sum_length <= 0.0f) {
+        return;
+    }
+    meshlet.cone_axis = normal_sum / sum_length;
+    float min_dot = 1.0f;
+    for(const auto& normal : normals) {
+        min_dot = std::min(min_dot, glm::dot(normal, meshlet.cone_axis));
+    }
+    // a cone of half angle a: every triangle faces away from directions within 90 - a degrees of the
+    // axis, whose cosine is sin(a). Cones of 90 degrees or more never do.
+    if(min_dot > 0.0f) {
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+}
+
+} // namespace
+
+void ModelMesh::Optimize(bool reorder_vertices)
+{
+    const size_t vertex_count = _vertices.size();
+    if(_indices.size() < 3 || _indices.size() % 3 != 0) {
+        return;
+    }
+    for(Index index : _indices) {
+        if(index >= vertex_count) {
+            return;
+        }
+    }
+
+    // the triangles are only reordered within their submesh, which keeps the submeshes' ranges
+    std::vector<Index> indices = _indices.ToVector();
+    for(const auto& submesh : _submeshes) {
+        if(submesh.index_count % 3 != 0 || submesh.first_index + size_t(submesh.index_count) > indices.size()) {
+            continue;
+        }
+        Index* range = indices.data() + submesh.first_index;
+        auto ordered = MeshOptimizer::OptimizeVertexCache(range, submesh.index_count, vertex_count);
+        ordered = MeshOptimizer::OptimizeOverdraw(ordered.data(), ordered.size(), _vertices.data(), vertex_count);
+        std::copy(ordered.begin(), ordered.end(), range);
+    }
+    if(!reorder_vertices) {
+        _indices = IndexArray(std::move(indices), vertex_count);
+        return;
+    }
+    const auto order = MeshOptimizer::OptimizeVertexFetch(indices.data(), indices.size(), vertex_count);
+    _indices = IndexArray(std::move(indices), vertex_count);
+    ReorderVertices(_vertices, order);
+    ReorderVertices(_normals, order);
+    ReorderVertices(_tangents, order);
+    ReorderVertices(_tex_coords, order);
+}
+
+void ModelMesh::BuildMeshlets()
+{
+    _meshlets.clear();
+    const size_t vertex_count = _vertices.size();
+    const size_t triangle_count = _indices.size() / 3;
+    if(triangle_count == 0 || _indices.size() % 3 != 0) {
+        return;
+    }
+    const std::vector<Index> source = _indices.ToVector();
+    for(Index index : source) {
+        if(index >= vertex_count) {
+            return;
+        }
+    }
+    for(const auto& submesh : _submeshes) {
+        if(submesh.first_index % 3 != 0 || submesh.index_count % 3 != 0
+           || submesh.first_index + size_t(submesh.index_count) > _indices.size()) {
+            return;
+        }
+    }
+
+    // the triangles using each vertex: those of vertex v are vertex_triangles[offsets[v]] to
+    // vertex_triangles[offsets[v + 1]] excluded
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for(Index index : source) {
+        offsets[index + 1] += 1;
+    }
+    for(size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> vertex_triangles(_indices.size());
+    {
+        std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < _indices.size(); ++i) {
+            vertex_triangles[filled[source[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+    std::vector<glm::vec3> centroids(triangle_count);
+    std::vector<glm::vec3> normals(triangle_count);
+    for(size_t t = 0; t < triangle_count; ++t) {
+        const glm::vec3& p0 = _vertices[source[t * 3]];
+        const glm::vec3& p1 = _vertices[source[t * 3 + 1]];
+        const glm::vec3& p2 = _vertices[source[t * 3 + 2]];
+        centroids[t] = (p0 + p1 + p2) / 3.0f;
+        const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // grow each meshlet from a seed triangle over its neighbours, picking the one adding the fewest
+    // vertices, then the nearest and best aligned one: compact patches that share their vertices
+    // and face about the same way, which makes for small bounds and narrow cones
+    constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> vertex_meshlet(vertex_count, NONE);
+    std::vector<char> emitted(triangle_count, 0);
+    std::vector<uint32_t> candidates;
+    std::vector<Index> indices;
+    indices.reserve(_indices.size());
+    std::vector<Index> local_indices;
+    std::vector<Index> local_vertices;
+    // each submesh's meshlets in turn: a submesh's triangles stay a range of _indices
+    for(auto& submesh : _submeshes) {
+        const size_t first_triangle = submesh.first_index / 3;
+        const size_t end_triangle = first_triangle + submesh.index_count / 3;
+        submesh.first_index = static_cast<uint32_t>(indices.size());
+        submesh.first_meshlet = static_cast<uint32_t>(_meshlets.size());
+        size_t seed = first_triangle;
+        while(true) {
+            while(seed < end_triangle && emitted[seed]) {
+                ++seed;
+            }
+            if(seed == end_triangle) {
+                break;
+            }
+            const auto current = static_cast<uint32_t>(_meshlets.size());
+            Meshlet meshlet;
+            meshlet.first_index = static_cast<uint32_t>(indices.size());
+            size_t meshlet_vertices = 0;
+            glm::vec3 centroid_sum(0.0f);
+            glm::vec3 normal_sum(0.0f);
+            candidates.clear();
+
+            auto new_vertices = [&](size_t triangle) {
+                const Index* vertices = source.data() + triangle * 3;
+                return size_t(vertex_meshlet[vertices[0]] != current)
+                       + size_t(vertex_meshlet[vertices[1]] != current && vertices[1] != vertices[0])
+                       + size_t(vertex_meshlet[vertices[2]] != current && vertices[2] != vertices[0]
+                                && vertices[2] != vertices[1]);
+            };
+            size_t next = seed;
+            while(next != NONE) {
+                const Index* vertices = source.data() + next * 3;
+                meshlet_vertices += new_vertices(next);
+                for(size_t k = 0; k < 3; ++k) {
+                    if(vertex_meshlet[vertices[k]] != current) {
+                        vertex_meshlet[vertices[k]] = current;
+                        for(uint32_t j = offsets[vertices[k]]; j < offsets[vertices[k] + 1]; ++j) {
+                            if(!emitted[vertex_triangles[j]]) {
+                                candidates.push_back(vertex_triangles[j]);
+                            }
+                        }
+                    }
+                }
+                emitted[next] = 1;
+                indices.insert(indices.end(), vertices, vertices + 3);
+                meshlet.index_count += 3;
+                centroid_sum += centroids[next];
+                normal_sum += normals[next];
+                if(meshlet.index_count / 3 == Meshlet::MAX_TRIANGLES) {
+                    break;
+                }
+
+                const glm::vec3 centroid = centroid_sum / float(meshlet.index_count / 3);
+                const float normal_length = glm::length(normal_sum);
+                const glm::vec3 normal = normal_length > 0.0f ? normal_sum / normal_length : glm::vec3(0.0f);
+                next = NONE;
+                size_t best_new_vertices = 4;
+                float best_score = std::numeric_limits<float>::max();
+                size_t kept = 0;
+                for(uint32_t candidate : candidates) {
+                    // meshlets don't cross submeshes, whose materials differ
+                    if(emitted[candidate] || candidate < first_triangle || candidate >= end_triangle) {
+                        continue;
+                    }
+                    candidates[kept++] = candidate;
+                    const size_t added = new_vertices(candidate);
+                    if(meshlet_vertices + added > Meshlet::MAX_VERTICES || added > best_new_vertices) {
+                        continue;
+                    }
+                    const float score = glm::length(centroids[candidate] - centroid)
+                                        * (2.0f - glm::dot(normals[candidate], normal));
+                    if(added < best_new_vertices || score < best_score) {
+                        next = candidate;
+                        best_new_vertices = added;
+                        best_score = score;
+                    }
+                }
+                candidates.resize(kept);
+            }
+
+            // the meshlet's triangles in vertex cache order, numbering its vertices locally to keep it cheap
+            local_indices.clear();
+            local_vertices.clear();
+            for(uint32_t i = 0; i < meshlet.index_count; ++i) {
+                const Index vertex = indices[meshlet.first_index + i];
+                auto found = std::find(local_vertices.begin(), local_vertices.end(), vertex);
+                local_indices.push_back(static_cast<Index>(found - local_vertices.begin()));
+                if(found == local_vertices.end()) {
+                    local_vertices.push_back(vertex);
+                }
+            }
+            const auto ordered = MeshOptimizer::OptimizeVertexCache(local_indices.data(), local_indices.size(),
+                                                                    local_vertices.size());
+            for(uint32_t i = 0; i < meshlet.index_count; ++i) {
+                indices[meshlet.first_index + i] = local_vertices[ordered[i]];
+            }
+
+            ComputeMeshletBounds(meshlet, indices.data(), _vertices.data());
+            _meshlets.push_back(meshlet);
+        }
+        submesh.index_count = static_cast<uint32_t>(indices.size()) - submesh.first_index;
+        submesh.meshlet_count = static_cast<uint32_t>(_meshlets.size()) - submesh.first_meshlet;
+    }
+    _indices = IndexArray(std::move(indices), vertex_count);
+}
+
+void ModelMesh::GenerateLods(const std::vector<float>& target_errors)
+{
+    _lod_indices = IndexArray();
+    _lods.clear();
+    if(_indices.empty() || _submeshes.empty() || _bounding_box.IsEmpty()) {
+        return;
+    }
+    for(const auto& submesh : _submeshes) {
+        if(submesh.first_index + size_t(submesh.index_count) > _indices.size()) {
+            return;
+        }
+    }
+
+    // each level simplifies each submesh's previous level to half its triangles. Their errors add
+    // up, so a level may only add what's left of its target error. The submeshes are simplified
+    // apart, with their borders kept, so that their materials don't bleed into each other's.
+    const size_t submesh_count = _submeshes.size();
+    const std::vector<Index> mesh_indices = _indices.ToVector();
+    std::vector<Index> lod_indices;
+    // each submesh's previous level, as a range of _indices, or of lod_indices once it has levels
+    std::vector<MeshLod> previous(submesh_count);
+    for(size_t i = 0; i < submesh_count; ++i) {
+        previous[i].first_index = _submeshes[i].first_index;
+        previous[i].index_count = _submeshes[i].index_count;
+    }
+    size_t previous_total = _indices.size();
+    float previous_error = 0.0f;
+    for(float target_error : target_errors) {
+        if(_lods.size() == MeshLod::MAX_LEVELS * submesh_count) {
+            break;
+        }
+        const float error_left = target_error * _bounding_sphere.radius - previous_error;
+        if(error_left <= 0.0f) {
+            continue;
+        }
+        std::vector<MeshLod> level = previous;
+        std::vector<Index> level_indices;
+        size_t total = 0;
+        float level_error = 0.0f;
+        for(size_t i = 0; i < submesh_count; ++i) {
+            const Index* indices = (_lods.empty() ? mesh_indices.data() : lod_indices.data()) + previous[i].first_index;
+            const size_t index_count = previous[i].index_count;
+            float error = 0.0f;
+            auto simplified = MeshSimplifier::Simplify(indices, index_count, _vertices.data(), _vertices.size(),
+                                                       index_count / 6 * 3, error_left, error);
+            // a submesh that doesn't simplify any further within the error keeps its previous level
+            if(simplified.empty() || simplified.size() > index_count * 9 / 10) {
+                simplified.assign(indices, indices + index_count);
+                error = 0.0f;
+            } else {
+                simplified = MeshOptimizer::OptimizeVertexCache(simplified.data(), simplified.size(), _vertices.size());
+            }
+            level[i].first_index = static_cast<uint32_t>(lod_indices.size() + level_indices.size());
+            level[i].index_count = static_cast<uint32_t>(simplified.size());
+            level_indices.insert(level_indices.end(), simplified.begin(), simplified.end());
+            total += simplified.size();
+            level_error = std::max(level_error, error);
+        }
+        // not worth a level: the mesh doesn't simplify any further within the error
+        if(total == 0 || total > previous_total * 9 / 10) {
+            break;
+        }
+
+        for(auto& lod : level) {
+            lod.error = previous_error + level_error;
+            _lods.push_back(lod);
+        }
+        lod_indices.insert(lod_indices.end(), level_indices.begin(), level_indices.end());
+        previous = std::move(level);
+        previous_total = total;
+        previous_error += level_error;
+    }
+    _lod_indices = IndexArray(std::move(lod_indices), _vertices.size());
+}
+
+void ModelMesh::GetLodRange(int lod, size_t submesh, size_t& first_index, size_t& index_count) const
+{
+    if(lod <= 0 || lod > GetLodCount()) {
+        first_index = _submeshes[submesh].first_index;
+        index_count = _submeshes[submesh].index_count;
+    } else {
+        const auto& level = _lods[(lod - 1) * _submeshes.size() + submesh];
+        first_index = _indices.size() + level.first_index;
+        index_count = level.index_count;
+    }
+}
+
+size_t ModelMesh::GetTriangleCount(int lod) const
+{
+    size_t index_count = 0;
+    for(size_t i = 0; i < _submeshes.size(); ++i) {
+        size_t first = 0;
+        size_t count = 0;
+        GetLodRange(lod, i, first, count);
+        index_count += count;
+    }
+    return index_count / 3;
+}
+
+void Texture::GenerateMipChain()
+{
+    if(_mip_levels != 1 || _compressed_format != 0 || _image_width <= 0 || _image_height <= 0
+       || _image_data.size() != static_cast<size_t>(_image_width) * _image_height * 4) {
+        return;
+    }
+
+    auto& pixels = _image_data.Edit();
+    size_t level_offset = 0;
+    int width = _image_width;
+    int height = _image_height;
+    while(width > 1 || height > 1) {
+        const int next_width = std::max(width / 2, 1);
+        const int next_height = std::max(height / 2, 1);
+        const size_t next_offset = level_offset + static_cast<size_t>(width) * height * 4;
+        pixels.resize(next_offset + static_cast<size_t>(next_width) * next_height * 4);
+
+        // average the (up to) 2x2 source texels under each destination texel
+        const u_char* source = pixels.data() + level_offset;
+        u_char* destination = pixels.data() + next_offset;
+        for(int y = 0; y < next_height; ++y) {
+            const int y0 = std::min(y * 2, height - 1);
+            const int y1 = std::min(y * 2 + 1, height - 1);
+            for(int x = 0; x < next_width; ++x) {
+                const int x0 = std::min(x * 2, width - 1);
+                const int x1 = std::min(x * 2 + 1, width - 1);
+                for(int c = 0; c < 4; ++c) {
+                    const int sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c]
+                                    + source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+                    destination[(y * next_width + x) * 4 + c] = static_cast<u_char>((sum + 2) / 4);
+                }
+            }
+        }
+
+        level_offset = next_offset;
+        width = next_width;
+        height = next_height;
+        ++_mip_levels;
+    }
+}
+
+ModelNode* Model::AddNode(const std::string& name, SceneNode* parent)
+{
+    _nodes.emplace_back(std::make_unique<ModelNode>(name));
+    auto* node = _nodes.back().get();
+    (parent ? parent : this)->AddChild(node);
+    return node;
+}
+
+void Model::AddMesh(const std::shared_ptr<ModelMesh>& mesh, SceneNode* node)
+{
+    if(std::find(_meshes.begin(), _meshes.end(), mesh) == _meshes.end()) {
+        _meshes.emplace_back(mesh);
+    }
+    _mesh_instances.push_back({node ? node : this, mesh});
+}
+
+void Model::RemoveMesh(const std::shared_ptr<ModelMesh>& mesh)
+{
+    _meshes.erase(std::remove(_meshes.begin(), _meshes.end(), mesh), _meshes.end());
+    _mesh_instances.erase(std::remove_if(_mesh_instances.begin(), _mesh_instances.end(),
+                                         [&mesh](const MeshInstance& instance) { return instance.mesh == mesh; }),
+                          _mesh_instances.end());
+}
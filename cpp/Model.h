@@ -1,8 +1,13 @@
 #ifndef ANDROIDGLINVESTIGATIONS_MODEL_H
 #define ANDROIDGLINVESTIGATIONS_MODEL_H
 
+#include <memory>
+#include <string>
 #include <vector>
+#include "IndexArray.h"
+#include "SharedArray.h"
 #include "TextureAsset.h"
+#include "scene/BoundingVolume.h"
 #include "scene/SceneNode.h"
 #include "Utility.h"
 
@@ -23,10 +28,20 @@ namespace Sampler {
 
 struct Texture {
     std::string _name;
-    std::vector<u_char> _image_data;
+    // RGBA8 pixels, or compressed blocks, of _mip_levels levels, largest first. Each level is half
+    // the size of the previous one (at least 1 pixel). May reference a memory-mapped mesh cache, or an image shared with other
+    // textures, rather than own a copy. Released once uploaded.
+    SharedArray<u_char> _image_data;
     std::string _image_uri;
     int _image_width = 0;
     int _image_height = 0;
+    int _mip_levels = 1;
+    // 0 for RGBA8 pixels, otherwise the GL format of the compressed blocks, e.g. ETC2 or ASTC from a
+    // KTX2 file (see TextureAsset::getCompressedBlockSize)
+    GLenum _compressed_format = 0;
+    // the TextureCache key of the image, 0 if it's not shared. Textures with the same key and sampler
+    // share one gl texture.
+    uint64_t _cache_key = 0;
     // this is the gl resource id, which must be created by the renderer.
     GLuint _id = -1;
     // how the texture coordinates are sampled when they fall outside the range [0,1]
@@ -38,12 +53,24 @@ struct Texture {
     // the mag filter determines how a texture is magnified (zoomed in) when it's rendered on a surface where the
     // texture's resolution is lower than the screen's resolution for that area.
     GLint _sampler_mag_filter = Sampler::FILTER_NONE;
+
+    // Appends the remaining mip levels to a single-level RGBA8 image, box filtering each from the
+    // previous one.
+    void GenerateMipChain();
 };
 
 struct Material {
     std::string _name;
     Texture _pbr_base_color_texture;
     Texture _normal_texture;
+    // the glTF pbrMetallicRoughness factors, and the emissive factor. The defaults are glTF's.
+    glm::vec4 _base_color_factor = glm::vec4(1.0f); // multiplies the base color texture
+    float _metallic_factor = 1.0f;
+    float _roughness_factor = 1.0f;
+    glm::vec3 _emissive_factor = glm::vec3(0.0f);
+    // the material's block in the renderer's material uniform buffer, created from the factors by
+    // the renderer. -1 until then.
+    int _uniform_block_slot = -1;
 };
 
 struct MaterialUBO
@@ -52,39 +79,243 @@ struct MaterialUBO
     float specular_power = 300.0f;
     glm::vec4 specular_color = glm::vec4(0.5, 0.5, 0.5, 1.0); // percents of reflectivity;
     glm::vec4 ambient_color = glm::vec4(1.0); // noon/daylight
-    glm::vec4 diffuse_color = glm::vec4(1.0);
+    glm::vec4 diffuse_color = glm::vec4(1.0); // alpha included
+    glm::vec4 emissive_color = glm::vec4(0.0);
+};
+
+/*!
+ * How a mesh's vertices are laid out in its gpu vertex buffer.
+ */
+enum class VertexLayout : int
+{
+    // four separate streams of floats: position, normal, tangent and uv (48 bytes per vertex).
+    Separate = 0,
+    // one interleaved stream of PackedVertex: float position, 10:10:10:2 normal and tangent,
+    // half float uv (24 bytes per vertex).
+    Packed = 1,
+    // one interleaved stream of QuantizedVertex: as Packed, but with 16-bit normalized positions
+    // dequantized in the shader with the mesh's position offset and scale (20 bytes per vertex).
+    PackedQuantized = 2,
+};
+
+struct PackedVertex {
+    glm::vec3 position;
+    uint32_t normal;    // snorm 10:10:10, w unused
+    uint32_t tangent;   // snorm 10:10:10, w holds the bitangent sign
+    uint16_t uv[2];     // half floats
+};
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must be tightly packed");
+
+struct QuantizedVertex {
+    int16_t position[4]; // snorm16, relative to the mesh bounds. w is padding, to keep 4-byte alignment.
+    uint32_t normal;     // snorm 10:10:10, w unused
+    uint32_t tangent;    // snorm 10:10:10, w holds the bitangent sign
+    uint16_t uv[2];      // half floats
+};
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must be tightly packed");
+
+/*!
+ * A simplified version of a mesh, drawing a subset of its vertices.
+ */
+struct MeshLod {
+    // the most levels a mesh may have besides the full one, as draw sort keys hold 3 bits of level
+    static constexpr int MAX_LEVELS = 7;
+
+    // its triangles, in the mesh's _lod_indices
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    // how far its surface may be off the full mesh's, in the mesh's local space
+    float error = 0.0f;
+};
+
+/*!
+ * A cluster of a mesh's triangles, culled on its own when it's outside the view or when all its
+ * triangles face away from the camera.
+ */
+struct Meshlet
+{
+    // the most vertices and triangles of a meshlet
+    static constexpr size_t MAX_VERTICES = 64;
+    static constexpr size_t MAX_TRIANGLES = 124;
+
+    // its triangles, in the mesh's _indices
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    // the bounds of its triangles, in the mesh's local space
+    BoundingSphere bounds;
+    // the cone its triangles' normals are in: its axis, and the sine of its half angle. Above 1 when
+    // the cone is too wide for a viewpoint to see all of them from behind.
+    glm::vec3 cone_axis = glm::vec3(0.0f);
+    float cone_cutoff = 2.0f;
+
+    /*!
+     * @param viewpoint a point in the mesh's local space, e.g. the camera's position
+     * @return true if the viewpoint only sees the back of every triangle, as far as the cone and the
+     * bounds tell
+     */
+    inline bool IsBackfacing(const glm::vec3& viewpoint) const {
+        const glm::vec3 direction = bounds.center - viewpoint;
+        return glm::dot(direction, cone_axis) >= cone_cutoff * glm::length(direction) + bounds.radius;
+    }
+};
+
+/*!
+ * A range of a mesh's triangles drawn with a material of its own, e.g. one of a glTF mesh's
+ * primitives. The submeshes of a mesh share its vertex streams and index buffer.
+ */
+struct Submesh
+{
+    // its triangles, in the mesh's _indices
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    // its meshlets, in the mesh's _meshlets
+    uint32_t first_meshlet = 0;
+    uint32_t meshlet_count = 0;
+    Material material;
 };
 
 struct ModelMesh {
-    std::vector<glm::vec3> _vertices;
-    std::vector<Index> _indices;
-    std::vector<glm::vec3> _normals;
-    std::vector<glm::vec4> _tangents;
-    std::vector<glm::vec2> _tex_coords;
-    Material _material;
-    glm::mat4 _model_transform = glm::mat4(1.0f);
+    // cpu vertex streams and indices. These may reference the loaded asset's buffers rather than own
+    // a copy, use Edit() to modify them. The indices are 16-bit unless the vertices need more.
+    SharedArray<glm::vec3> _vertices;
+    IndexArray _indices;
+    SharedArray<glm::vec3> _normals;
+    SharedArray<glm::vec4> _tangents;
+    SharedArray<glm::vec2> _tex_coords;
+    // what's drawn of the mesh: consecutive ranges of _indices, each with its material
+    std::vector<Submesh> _submeshes;
+    // gpu-resident copies of the vertex streams and indices, and the vertex array object describing
+    // them. These are gl resource ids created once by the renderer (0 until then).
+    GLuint _vertex_array_id = 0;
+    GLuint _vertex_buffer_id = 0;
+    GLuint _index_buffer_id = 0;
+    // the type of the gpu index buffer's indices, GL_UNSIGNED_SHORT unless the mesh has more vertices
+    // than 16 bits can number. Picked by the renderer with the buffer.
+    GLenum _index_type = GL_UNSIGNED_SHORT;
+    // where the mesh starts in its gpu buffers, in vertices and indices. 0 unless it shares them
+    // with other meshes (see GeometryPool), its uploaded indices then being offset by _first_vertex.
+    uint32_t _first_vertex = 0;
+    uint32_t _first_index = 0;
+    // the mesh's number in draw sort keys, handed out by the renderer at upload: meshes sharing a
+    // vertex array get numbers of their own, those uploaded one after the other close ones.
+    uint32_t _sort_id = 0;
+    // the vertex buffer layout. Unless it's VertexLayout::Separate, the gpu vertex buffer is filled
+    // from _packed_vertices rather than from the float streams above.
+    VertexLayout _vertex_layout = VertexLayout::Separate;
+    SharedArray<u_char> _packed_vertices;
+    // quantized positions are dequantized as: position = _position_offset + quantized * _position_scale
+    glm::vec3 _position_offset = glm::vec3(0.0f);
+    glm::vec3 _position_scale = glm::vec3(1.0f);
+    // bounds of _vertices, in the mesh's local space. Empty until computed or set.
+    BoundingBox _bounding_box;
+    BoundingSphere _bounding_sphere;
+    // levels of detail, each coarser than the previous one: level 0 is the full mesh, level i + 1 has
+    // a MeshLod per submesh, _lods[i * _submeshes.size()] onwards, whose indices are in _lod_indices.
+    // The gpu index buffer holds _indices followed by _lod_indices.
+    IndexArray _lod_indices;
+    std::vector<MeshLod> _lods;
+    // the full mesh's triangles split in meshlets, each a range of _indices within a submesh. Empty if
+    // not built.
+    std::vector<Meshlet> _meshlets;
 
+    // Computes the bounding box and sphere from _vertices.
+    void ComputeBounds();
+    // Sets the bounding box, e.g. from the source asset, and derives the sphere from it.
+    void SetBounds(const BoundingBox& box);
     void ComputeTangentSpace();
+    // Reorders the triangles of each submesh for the vertex cache and overdraw, then, if
+    // reorder_vertices, the vertices in the order the triangles use them. Makes the indices, and the
+    // vertex streams if reordered, owned copies. Call it before packing the vertices or generating
+    // the levels of detail, as it renumbers the vertices.
+    void Optimize(bool reorder_vertices = true);
+    // Splits each submesh's triangles in meshlets, compact patches of the surface, and reorders
+    // _indices meshlet after meshlet. Call it before generating the levels of detail.
+    void BuildMeshlets();
+    // Builds _packed_vertices from the float streams, in the given layout.
+    void PackVertices(VertexLayout layout);
+    // Generates the levels of detail, see MeshLoadOptions::lod_errors. Needs the bounds.
+    void GenerateLods(const std::vector<float>& target_errors);
+    // the levels of detail besides the full one
+    inline int GetLodCount() const {
+        return _submeshes.empty() ? 0 : static_cast<int>(_lods.size() / _submeshes.size());
+    }
+    // how far a level of detail's surface may be off the full mesh's, in the mesh's local space
+    inline float GetLodError(int lod) const {
+        return lod <= 0 ? 0.0f : _lods[(lod - 1) * _submeshes.size()].error;
+    }
+    // the indices of a submesh drawn at a level of detail, counted from the start of the gpu index
+    // buffer
+    void GetLodRange(int lod, size_t submesh, size_t& first_index, size_t& index_count) const;
+    // the triangles drawn at a level of detail, over all the submeshes
+    size_t GetTriangleCount(int lod) const;
     void ComputeTangentSpaceHelper(glm::ivec3 triangleVertexIndices, bool useStoredNormals, std::vector<int>& averager);
 };
 
+/*!
+ * A node of a model's hierarchy, e.g. a glTF node. Its world matrix places the meshes it draws.
+ */
+class ModelNode : public SceneNode
+{
+public:
+    explicit ModelNode(const std::string& name = std::string()) {
+        _id = name;
+    }
+
+    inline const std::string& GetName() const {
+        return _id;
+    }
+};
+
+/*!
+ * A mesh drawn by a node of the model. A mesh may be drawn by several nodes.
+ */
+struct MeshInstance
+{
+    // the model itself, or one of its ModelNodes
+    SceneNode* node = nullptr;
+    std::shared_ptr<ModelMesh> mesh;
+    // the level of detail the renderer last drew it at, which it keeps until the view clearly calls
+    // for another one
+    mutable int lod = 0;
+};
+
 class Model : public SceneNode
 {
 public:
     Model() = default;
 
-    inline void AddMesh(const std::shared_ptr<ModelMesh>& mesh) {
-        _meshes.emplace_back(mesh);
-    }
-    inline void RemoveMesh(const std::shared_ptr<ModelMesh>& mesh) {
-        std::remove(_meshes.begin(), _meshes.end(), mesh);
-    }
+    /*!
+     * Adds a node to the model's hierarchy.
+     * @param parent the model itself when null, otherwise another node of this model
+     * @return the node, owned by the model
+     */
+    ModelNode* AddNode(const std::string& name = std::string(), SceneNode* parent = nullptr);
+
+    /*!
+     * Adds a mesh, drawn by the given node of this model, or with the model's own transform when null.
+     */
+    void AddMesh(const std::shared_ptr<ModelMesh>& mesh, SceneNode* node = nullptr);
+
+    // removes the mesh, and every instance of it
+    void RemoveMesh(const std::shared_ptr<ModelMesh>& mesh);
+
+    // every distinct mesh of the model, e.g. to create their gpu resources
     inline const std::vector<std::shared_ptr<ModelMesh>>& GetMeshes() const {
         return _meshes;
     }
+    // what to draw, and with which node's world matrix
+    inline const std::vector<MeshInstance>& GetMeshInstances() const {
+        return _mesh_instances;
+    }
+    // the model's nodes, parents before their children
+    inline const std::vector<std::unique_ptr<ModelNode>>& GetNodes() const {
+        return _nodes;
+    }
 
 private:
+    std::vector<std::unique_ptr<ModelNode>> _nodes;
     std::vector<std::shared_ptr<ModelMesh>> _meshes;
+    std::vector<MeshInstance> _mesh_instances;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_MODEL_H
\ No newline at end of file
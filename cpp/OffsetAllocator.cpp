@@ -0,0 +1,81 @@
+#include "OffsetAllocator.h"
+
+#include <cassert>
+#include <iterator>
+
+OffsetAllocator::OffsetAllocator(uint32_t size)
+{
+    Grow(size);
+}
+
+uint32_t OffsetAllocator::Allocate(uint32_t size)
+{
+    if(size == 0) {
+        return NO_SPACE;
+    }
+    auto best = _free_by_size.lower_bound(size);
+    if(best == _free_by_size.end()) {
+        return NO_SPACE;
+    }
+    const uint32_t offset = best->second;
+    const uint32_t range_size = best->first;
+    RemoveFreeRange(_free_by_offset.find(offset));
+    if(range_size > size) {
+        AddFreeRange(offset + size, range_size - size);
+    }
+    _free_size -= size;
+    return offset;
+}
+
+void OffsetAllocator::Free(uint32_t offset, uint32_t size)
+{
+    assert(offset + size <= _size);
+    if(size == 0) {
+        return;
+    }
+    _free_size += size;
+    // merge with the free ranges right before and after it
+    auto next = _free_by_offset.lower_bound(offset);
+    if(next != _free_by_offset.begin()) {
+        auto previous = std::prev(next);
+        if(previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            RemoveFreeRange(previous);
+        }
+    }
+    if(next != _free_by_offset.end() && offset + size == next->first) {
+        size += next->second;
+        RemoveFreeRange(next);
+    }
+    AddFreeRange(offset, size);
+}
+
+void OffsetAllocator::Grow(uint32_t size)
+{
+    if(size <= _size) {
+        return;
+    }
+    const uint32_t added_offset = _size;
+    const uint32_t added_size = size - _size;
+    _size = size;
+    Free(added_offset, added_size);
+}
+
+void OffsetAllocator::AddFreeRange(uint32_t offset, uint32_t size)
+{
+    _free_by_offset.emplace(offset, size);
+    _free_by_size.emplace(size, offset);
+}
+
+void OffsetAllocator::RemoveFreeRange(std::map<uint32_t, uint32_t>::iterator range)
+{
+    auto sized = _free_by_size.equal_range(range->second);
+    for(auto it = sized.first; it != sized.second; ++it) {
+        if(it->second == range->first) {
+            _free_by_size.erase(it);
+            break;
+        }
+    }
+    _free_by_offset.erase(range);
+}
@@ -0,0 +1,52 @@
+#ifndef MY_MOBILE_APP_OFFSETALLOCATOR_H
+#define MY_MOBILE_APP_OFFSETALLOCATOR_H
+
+#include <cstdint>
+#include <map>
+
+/*!
+ * Hands out ranges of a linear space, e.g. of a gpu buffer's elements, by offset. It only keeps
+ * the free ranges: a range is allocated from the smallest free one it fits in (best fit), and freed
+ * ranges merge with their free neighbours, which keeps the space from fragmenting.
+ */
+class OffsetAllocator
+{
+public:
+    // returned when no free range is large enough
+    static constexpr uint32_t NO_SPACE = 0xFFFFFFFFu;
+
+    /*!
+     * @param size the size of the space, all free
+     */
+    explicit OffsetAllocator(uint32_t size = 0);
+
+    /*!
+     * @return the offset of a free range of the given size, now allocated, or NO_SPACE
+     */
+    uint32_t Allocate(uint32_t size);
+
+    /*!
+     * Frees a range returned by Allocate(), with the size it was allocated with.
+     */
+    void Free(uint32_t offset, uint32_t size);
+
+    /*!
+     * Extends the space to the given size, which adds to the free range at its end.
+     */
+    void Grow(uint32_t size);
+
+    inline uint32_t GetSize() const { return _size; }
+    inline uint32_t GetFreeSize() const { return _free_size; }
+
+private:
+    void AddFreeRange(uint32_t offset, uint32_t size);
+    void RemoveFreeRange(std::map<uint32_t, uint32_t>::iterator range);
+
+    uint32_t _size = 0;
+    uint32_t _free_size = 0;
+    // the free ranges by offset (to merge neighbours), and by size (for the best fit)
+    std::map<uint32_t, uint32_t> _free_by_offset;
+    std::multimap<uint32_t, uint32_t> _free_by_size;
+};
+
+#endif //MY_MOBILE_APP_OFFSETALLOCATOR_H
@@ -0,0 +1,42 @@
+#ifndef MY_MOBILE_APP_RENDERSTATS_H
+#define MY_MOBILE_APP_RENDERSTATS_H
+
+#include <cstdint>
+
+/*!
+ * Counters gathered by the renderer while drawing a frame. They are reset at the start of every
+ * Renderer::render() call, and are mostly meant for the benchmark tools.
+ */
+struct RenderStats
+{
+    // number of glDraw* calls issued.
+    uint64_t draw_calls = 0;
+    // meshes drawn, and meshes skipped because their bounds were outside the camera frustum, or all
+    // their meshlets were culled.
+    uint64_t meshes_submitted = 0;
+    uint64_t meshes_culled = 0;
+    // triangles drawn, and triangles the meshes drawn at a coarser level of detail would have added
+    // at full detail.
+    uint64_t triangles_submitted = 0;
+    uint64_t triangles_saved = 0;
+    // meshlets of the meshes drawn at full detail left out for being outside the view or facing
+    // away from the camera, and their triangles.
+    uint64_t meshlets_culled = 0;
+    uint64_t triangles_culled = 0;
+    // GL calls that change pipeline state: enables, binds and uniform uploads, as issued through the
+    // GLStateCache. And the calls it dropped because they wouldn't have changed anything.
+    uint64_t state_changes = 0;
+    uint64_t state_changes_filtered = 0;
+    // lights listed in the light clusters, summed over the clusters.
+    uint64_t light_assignments = 0;
+    // world matrices recomputed by the scene's transform update.
+    uint64_t transforms_updated = 0;
+    // bytes sent from CPU memory to the driver: uniforms, client-side vertex/index arrays and textures.
+    uint64_t bytes_uploaded = 0;
+
+    inline void Reset() {
+        *this = RenderStats();
+    }
+};
+
+#endif //MY_MOBILE_APP_RENDERSTATS_H
@@ -1,10 +1,18 @@
 #include "Renderer.h"
 
+#ifdef __ANDROID__
 #include <game-activity/native_app_glue/android_native_app_glue.h>
+#endif
+#include <EGL/eglext.h>
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <sstream>
 #include <vector>
-#include <android/imagedecoder.h>
 
 #include "AndroidOut.h"
 #include "Shader.h"
@@ -57,6 +65,15 @@ static constexpr float kProjectionFarPlane = 500.f;
 
 
 Renderer::~Renderer() {
+    // the scene's gpu resources have to go while the context is still around.
+    if (_current_scene) {
+        for (const auto& render_object : _current_scene->GetRenderObjects()) {
+            shader_->releaseModel(*render_object->GetMeshModel());
+        }
+        _current_scene.reset();
+    }
+    shader_.reset();
+
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (context_ != EGL_NO_CONTEXT) {
@@ -74,15 +91,33 @@ Renderer::~Renderer() {
 
 void Renderer::ApplyCurrentScene(std::unique_ptr<SceneGraph>& scene)
 {
+    if (_current_scene) {
+        for (const auto& render_object : _current_scene->GetRenderObjects()) {
+            shader_->releaseModel(*render_object->GetMeshModel());
+        }
+    }
+
     _current_scene = std::move(scene);
+    // the shader draws with the new scene's camera
+    shaderNeedsNewProjectionMatrix_ = true;
+
+    // create the gpu buffers and textures once, rather than on the first frame that draws them.
+    for (const auto& render_object : _current_scene->GetRenderObjects()) {
+        shader_->uploadModel(*render_object->GetMeshModel());
+    }
 }
 
 void Renderer::render() {
+    frame_stats_.Reset();
+    glState_.resetCounters();
+
     // Check to see if the surface has changed size. This is _necessary_ to do every frame when
     // using immersive mode as you'll get no other notification that your renderable area has
     // changed.
     updateRenderArea();
 
+    applyLoadedModels();
+
     // When the renderable area changes, the projection matrix has to also be updated. This is true
     // even if you change from the sample orthographic projection matrix as your aspect ratio has
     // likely changed.
@@ -97,37 +132,326 @@ void Renderer::render() {
         shader_->setProjectionMatrix(camera->GetProjectionMatrix());
     }
 
+    // only the nodes that moved, and their descendants, get their world matrix recomputed
+    frame_stats_.transforms_updated += _current_scene->UpdateWorldTransforms();
+
     // Render all the models. There's no depth testing in this sample so they're accepted in the
     // order provided. But the sample EGL setup requests a 24 bit depth buffer so you could
     // configure it at the end of initRenderer
     renderCurrentScene();
 
+    frame_stats_.state_changes = glState_.getIssuedCalls();
+    frame_stats_.state_changes_filtered = glState_.getFilteredCalls();
+
     // Present the rendered image. This is an implicit glFlush.
     auto swapResult = eglSwapBuffers(display_, surface_);
     assert(swapResult == EGL_TRUE);
 }
 
+void Renderer::applyLoadedModels()
+{
+    bool models_loaded = false;
+    for (const auto& render_object : _current_scene->GetRenderObjects()) {
+        std::unique_ptr<Model> placeholder;
+        if (render_object->HasPendingModel() && render_object->ApplyLoadedModel(placeholder)) {
+            if (placeholder) {
+                shader_->releaseModel(*placeholder);
+            }
+            frame_stats_.bytes_uploaded += shader_->uploadModel(*render_object->GetMeshModel());
+            models_loaded = true;
+        }
+    }
+
+    if (models_loaded && modelsLoadedCallback_) {
+        modelsLoadedCallback_(*_current_scene);
+        // pick up any camera change
+        shaderNeedsNewProjectionMatrix_ = true;
+    }
+}
+
 void Renderer::renderCurrentScene()
 {
     // == set global GL state ==
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_DEPTH_TEST);
-
-    // == draw all the meshes ==
-    for(const auto& render_object : _current_scene->GetRenderObjects() ) {
-        shader_->drawModel(
-                *(render_object->GetMeshModel()),
-                _current_scene->GetCurrentCamera()->GetEye(),
-                _current_scene->GetLights());
+    glState_.enable(GL_CULL_FACE);
+    glState_.enable(GL_DEPTH_TEST);
+
+    // == assign the lights to the view's clusters, while the draw list gets built ==
+    auto* camera = _current_scene->GetCurrentCamera();
+    const glm::mat4 view_matrix = camera->GetViewMatrix();
+    const glm::mat4 projection_matrix = camera->GetProjectionMatrix();
+    auto build_light_clusters = [this, &view_matrix, &projection_matrix]() {
+        lightClusters_.Build(_current_scene->GetLights(), view_matrix, projection_matrix);
+    };
+    std::future<void> light_clusters_built;
+    if (jobSystem_ != nullptr) {
+        light_clusters_built = jobSystem_->Submit(build_light_clusters);
+    } else {
+        build_light_clusters();
     }
+
+    // == draw the meshes the camera can see ==
+    const Frustum frustum(projection_matrix * view_matrix);
+    buildDrawList(frustumCulling_ ? &frustum : nullptr, view_matrix, projection_matrix);
+    if (light_clusters_built.valid()) {
+        light_clusters_built.get();
+    }
+    shader_->drawList(
+            drawList_,
+            camera->GetEye(),
+            lightClusters_,
+            frame_stats_);
+}
+
+/*!
+ * How much coarser a level of detail has to be than the threshold before a mesh switches to it.
+ * Meshes hovering around a switching distance would flip between levels every frame otherwise.
+ */
+static constexpr float kLodHysteresis = 0.2f;
+
+/*!
+ * @return the coarsest level of detail of the mesh whose error is at most max_pixel_error pixels on
+ * screen, keeping the current level as long as it is, and only moving to coarser levels once they're
+ * within the hysteresis margin
+ * @param pixels_per_unit how many pixels a unit of the mesh's local space covers
+ */
+static int selectLod(const ModelMesh& mesh, int current_lod, float pixels_per_unit, float max_pixel_error)
+{
+    for (int lod = mesh.GetLodCount(); lod > 0; --lod) {
+        const float threshold = lod > current_lod ? max_pixel_error * (1.0f - kLodHysteresis) : max_pixel_error;
+        if (mesh.GetLodError(lod) * pixels_per_unit <= threshold) {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * The part of a submesh's triangles meshlet culling has to leave out before an instance is drawn
+ * from its meshlets left. That takes a draw call of its own and streaming its indices every frame,
+ * which costs more than drawing a few hidden triangles with the instance's batch.
+ */
+static constexpr float kMinMeshletCulledFraction = 0.25f;
+
+void Renderer::buildDrawList(const Frustum* frustum, const glm::mat4& view_matrix, const glm::mat4& projection_matrix)
+{
+    // enough objects per chunk to amortize a job, enough chunks to keep every core busy
+    constexpr size_t CHUNK_SIZE = 64;
+    const auto& render_objects = _current_scene->GetRenderObjects();
+    const size_t chunk_count = (render_objects.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    drawChunks_.resize(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        drawChunks_[i].begin = i * CHUNK_SIZE;
+        drawChunks_[i].end = std::min(render_objects.size(), (i + 1) * CHUNK_SIZE);
+    }
+
+    // the depth along the camera's view direction
+    const glm::vec4 depth_row(-view_matrix[0][2], -view_matrix[1][2], -view_matrix[2][2], -view_matrix[3][2]);
+    // the pixels a unit covers at depth 1 for a perspective projection (w = -z), anywhere for an
+    // orthographic one
+    const bool perspective = projection_matrix[2][3] != 0.0f;
+    const float pixels_per_unit = 0.5f * float(height_) * std::abs(projection_matrix[1][1]);
+    // meshlets are culled in their mesh's local space, against the planes and camera position
+    // brought there
+    const glm::mat4 view_projection = projection_matrix * view_matrix;
+    const glm::vec3 camera_position = glm::vec3(glm::inverse(view_matrix)[3]);
+
+    auto build_chunk = [&](size_t chunk_index) {
+        auto& chunk = drawChunks_[chunk_index];
+        chunk.spheres.clear();
+        chunk.candidates.clear();
+        chunk.instances.clear();
+        chunk.items.clear();
+        chunk.meshlets.clear();
+        chunk.culled = 0;
+        chunk.triangles = 0;
+        chunk.triangles_saved = 0;
+        chunk.meshlets_culled = 0;
+        chunk.triangles_culled = 0;
+
+        // the items point into chunk.meshlets: it mustn't reallocate
+        size_t meshlet_capacity = 0;
+        // the instances left after culling, each drawn once per submesh
+        size_t drawn = 0;
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            auto* model = render_objects[i]->GetMeshModel();
+            for (const auto& instance : model->GetMeshInstances()) {
+                DrawItem item;
+                item.model = model;
+                item.mesh = instance.mesh.get();
+                item.world_matrix = &instance.node->GetTransform().GetWorldMatrix();
+                chunk.candidates.push_back(item);
+                chunk.instances.push_back(&instance);
+                meshlet_capacity += item.mesh->_meshlets.size();
+                if (frustum) {
+                    BoundingSphere sphere;
+                    if (item.mesh->_bounding_box.IsEmpty()) {
+                        // bounds were never computed: can't tell, keep it
+                        sphere.radius = std::numeric_limits<float>::infinity();
+                    } else {
+                        sphere = item.mesh->_bounding_sphere.Transformed(*item.world_matrix);
+                    }
+                    chunk.spheres.push_back(sphere);
+                }
+            }
+        }
+
+        if (meshletCulling_) {
+            chunk.meshlets.reserve(meshlet_capacity);
+        }
+
+        // cull: test all the spheres in one batch, then refine the survivors with their (tighter) boxes
+        auto add_draw = [&](size_t candidate) {
+            DrawItem item = chunk.candidates[candidate];
+            const glm::vec3 center = item.mesh->_bounding_box.IsEmpty()
+                    ? glm::vec3((*item.world_matrix)[3])
+                    : glm::vec3(*item.world_matrix * glm::vec4(item.mesh->_bounding_box.GetCenter(), 1.0f));
+            const float depth = glm::dot(depth_row, glm::vec4(center, 1.0f));
+
+            // the level of detail: by the screen size of the mesh's nearest point, as far as its
+            // bounding sphere tells
+            const auto* instance = chunk.instances[candidate];
+            if (item.mesh->GetLodCount() == 0 || lodPixelError_ <= 0.0f) {
+                instance->lod = 0;
+            } else {
+                const glm::mat4& world = *item.world_matrix;
+                const float scale = std::sqrt(std::max(std::max(glm::dot(world[0], world[0]), glm::dot(world[1], world[1])),
+                                                       glm::dot(world[2], world[2])));
+                const float nearest_depth = depth - item.mesh->_bounding_sphere.radius * scale;
+                const float pixels = nearest_depth > 0.0f || !perspective
+                        ? pixels_per_unit * scale / (perspective ? nearest_depth : 1.0f)
+                        : std::numeric_limits<float>::infinity();
+                instance->lod = selectLod(*item.mesh, instance->lod, pixels, lodPixelError_);
+            }
+            item.lod = instance->lod;
+
+            // a draw per submesh, with its material
+            const auto& meshlets = item.mesh->_meshlets;
+            bool any_drawn = false;
+            for (uint32_t s = 0; s < item.mesh->_submeshes.size(); ++s) {
+                const auto& submesh = item.mesh->_submeshes[s];
+                DrawItem draw = item;
+                draw.submesh = s;
+                size_t first_index = 0;
+                size_t index_count = 0;
+                item.mesh->GetLodRange(item.lod, s, first_index, index_count);
+                // what the level of detail saves. Meshlet culling's savings count as culled instead.
+                chunk.triangles_saved += (submesh.index_count - index_count) / 3;
+
+                // the meshlets at full detail: those outside the view, or whose triangles all face
+                // away from the camera (a perspective one, orthographic ones have no position) are
+                // left out
+                if (item.lod == 0 && meshletCulling_ && submesh.meshlet_count > 0) {
+                    const glm::mat4& world = *item.world_matrix;
+                    const Frustum local_frustum(view_projection * world);
+                    const glm::vec3 local_camera = glm::vec3(glm::inverse(world) * glm::vec4(camera_position, 1.0f));
+                    const size_t first = chunk.meshlets.size();
+                    size_t visible_index_count = 0;
+                    for (uint32_t m = submesh.first_meshlet; m < submesh.first_meshlet + submesh.meshlet_count; ++m) {
+                        if ((perspective && meshlets[m].IsBackfacing(local_camera))
+                            || (frustum && !local_frustum.Intersects(meshlets[m].bounds))) {
+                            continue;
+                        }
+                        chunk.meshlets.push_back(m);
+                        visible_index_count += meshlets[m].index_count;
+                    }
+                    const size_t visible = chunk.meshlets.size() - first;
+                    // the meshlets left are drawn on their own, out of the instances' batch, with their
+                    // indices streamed: only worth it when that leaves out enough of the triangles
+                    const bool split = visible == 0
+                            || float(index_count - visible_index_count) >= kMinMeshletCulledFraction * float(index_count);
+                    if (split) {
+                        chunk.meshlets_culled += submesh.meshlet_count - visible;
+                        chunk.triangles_culled += (index_count - visible_index_count) / 3;
+                    }
+                    if (visible == 0) {
+                        continue;
+                    }
+                    if (split && visible < submesh.meshlet_count) {
+                        draw.meshlets = chunk.meshlets.data() + first;
+                        draw.meshlet_count = static_cast<uint32_t>(visible);
+                        index_count = visible_index_count;
+                    } else {
+                        // all of them, or most: the submesh is drawn whole, with its other instances
+                        chunk.meshlets.resize(first);
+                    }
+                }
+                chunk.triangles += index_count / 3;
+
+                draw.sort_key = DrawList::MakeSortKey(RenderPass::Opaque, 0, *item.mesh, s, item.lod, depth);
+                chunk.items.push_back(draw);
+                any_drawn = true;
+            }
+            drawn += any_drawn ? 1 : 0;
+        };
+        if (frustum) {
+            FrustumCuller::CullSpheres(*frustum, chunk.spheres, chunk.visible);
+            for (auto index : chunk.visible) {
+                const auto& item = chunk.candidates[index];
+                const auto& box = item.mesh->_bounding_box;
+                if (box.IsEmpty() || frustum->Intersects(box.Transformed(*item.world_matrix))) {
+                    add_draw(index);
+                }
+            }
+        } else {
+            for (size_t i = 0; i < chunk.candidates.size(); ++i) {
+                add_draw(i);
+            }
+        }
+        chunk.culled = chunk.candidates.size() - drawn;
+
+        std::sort(chunk.items.begin(), chunk.items.end(),
+                  [](const DrawItem& a, const DrawItem& b) { return a.sort_key < b.sort_key; });
+    };
+
+    if (jobSystem_) {
+        jobSystem_->ParallelFor(chunk_count, build_chunk);
+    } else {
+        for (size_t i = 0; i < chunk_count; ++i) {
+            build_chunk(i);
+        }
+    }
+
+    drawList_.Clear();
+    for (const auto& chunk : drawChunks_) {
+        drawList_.AppendSortedRun(chunk.items);
+        frame_stats_.meshes_submitted += chunk.candidates.size() - chunk.culled;
+        frame_stats_.meshes_culled += chunk.culled;
+        frame_stats_.triangles_submitted += chunk.triangles;
+        frame_stats_.triangles_saved += chunk.triangles_saved;
+        frame_stats_.meshlets_culled += chunk.meshlets_culled;
+        frame_stats_.triangles_culled += chunk.triangles_culled;
+    }
+    drawList_.MergeRuns();
+    drawList_.BuildBatches();
+}
+
+/*!
+ * @brief gets the display for an offscreen renderer.
+ *
+ * Without a window system (e.g. a Linux CI box), prefer Mesa's surfaceless platform, which supports
+ * pbuffers on llvmpipe. Otherwise fall back to the default display.
+ */
+static EGLDisplay getOffscreenDisplay() {
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (client_extensions && strstr(client_extensions, "EGL_MESA_platform_surfaceless")) {
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (get_platform_display) {
+            auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY) {
+                return display;
+            }
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
 }
 
 void Renderer::initRenderer() {
     // Choose your render attributes
-    constexpr EGLint attribs[] = {
+    const EGLint attribs[] = {
             EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
-            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+            EGL_SURFACE_TYPE, offscreen_ ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT,
             EGL_BLUE_SIZE, 8,
             EGL_GREEN_SIZE, 8,
             EGL_RED_SIZE, 8,
@@ -136,8 +460,9 @@ void Renderer::initRenderer() {
     };
 
     // The default display is probably what you want on Android
-    auto display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    auto display = offscreen_ ? getOffscreenDisplay() : eglGetDisplay(EGL_DEFAULT_DISPLAY);
     eglInitialize(display, nullptr, nullptr);
+    eglBindAPI(EGL_OPENGL_ES_API);
 
     // figure out how many configs there are
     EGLint numConfigs;
@@ -170,10 +495,24 @@ void Renderer::initRenderer() {
     aout << "Found " << numConfigs << " configs" << std::endl;
     aout << "Chose " << config << std::endl;
 
-    // create the proper window surface
-    EGLint format;
-    eglGetConfigAttrib(display, config, EGL_NATIVE_VISUAL_ID, &format);
-    EGLSurface surface = eglCreateWindowSurface(display, config, app_->window, nullptr);
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (offscreen_) {
+        // no window: render into a pbuffer of the requested size
+        const EGLint pbufferAttribs[] = {
+                EGL_WIDTH, offscreen_width_,
+                EGL_HEIGHT, offscreen_height_,
+                EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    } else {
+#ifdef __ANDROID__
+        // create the proper window surface
+        EGLint format;
+        eglGetConfigAttrib(display, config, EGL_NATIVE_VISUAL_ID, &format);
+        surface = eglCreateWindowSurface(display, config, app_->window, nullptr);
+#endif
+    }
+    assert(surface != EGL_NO_SURFACE);
 
     // Create a GLES 3 context
     EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
@@ -196,7 +535,7 @@ void Renderer::initRenderer() {
     PRINT_GL_STRING(GL_VERSION);
     PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
 
-    shader_ = std::shared_ptr<Shader>(Shader::loadShader());
+    shader_ = std::shared_ptr<Shader>(Shader::loadShader(glState_));
     assert(shader_);
 
     // Note: there's only one shader in this demo, so I'll activate it here. For a more complex game
@@ -207,8 +546,8 @@ void Renderer::initRenderer() {
     glClearColor(CORNFLOWER_BLUE);
 
     // enable alpha globally for now, you probably don't want to do this in a game
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState_.enable(GL_BLEND);
+    glState_.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 }
 
@@ -223,6 +562,7 @@ void Renderer::updateRenderArea() {
         width_ = width;
         height_ = height;
         glViewport(0, 0, width, height);
+        shader_->setViewport(width, height);
 
         // make sure that we lazily recreate the projection matrix before we render
         shaderNeedsNewProjectionMatrix_ = true;
@@ -230,6 +570,12 @@ void Renderer::updateRenderArea() {
 }
 
 void Renderer::handleInput() {
+#ifdef __ANDROID__
+    if (offscreen_) {
+        // there's no android_app to take input from.
+        return;
+    }
+
     // handle all queued inputs
     auto *inputBuffer = android_app_swap_input_buffers(app_);
     if (!inputBuffer) {
@@ -315,4 +661,5 @@ void Renderer::handleInput() {
     }
     // clear the key input count too.
     android_app_clear_key_events(inputBuffer);
+#endif
 }
\ No newline at end of file
@@ -2,10 +2,17 @@
 #define ANDROIDGLINVESTIGATIONS_RENDERER_H
 
 #include <EGL/egl.h>
+#include <functional>
 #include <memory>
 
+#include "DrawList.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
 #include "Model.h"
+#include "RenderStats.h"
 #include "Shader.h"
+#include "scene/FrustumCuller.h"
 #include "scene/SceneGraph.h"
 
 struct android_app;
@@ -23,10 +30,75 @@ public:
         initRenderer();
     }
 
+    /*!
+     * Creates a renderer without a window, drawing into an offscreen EGL pbuffer of the given size.
+     * This is what the host (Linux) build uses, e.g. on Mesa llvmpipe, for profiling without a device.
+     * @param width the width of the offscreen surface, in pixels
+     * @param height the height of the offscreen surface, in pixels
+     */
+    Renderer(int width, int height) :
+            app_(nullptr),
+            display_(EGL_NO_DISPLAY),
+            surface_(EGL_NO_SURFACE),
+            context_(EGL_NO_CONTEXT),
+            offscreen_(true),
+            offscreen_width_(width),
+            offscreen_height_(height) {
+        initRenderer();
+    }
+
     virtual ~Renderer();
 
+    /*!
+     * @return true if this renderer draws into an offscreen pbuffer rather than a window
+     */
+    bool isOffscreen() const { return offscreen_; }
+
     void ApplyCurrentScene(std::unique_ptr<SceneGraph>& scene);
 
+    /*!
+     * Sets a function called on the render thread after models loaded in the background replace
+     * their placeholders, e.g. to frame the camera around them. The camera is re-read afterwards.
+     */
+    void setModelsLoadedCallback(std::function<void(SceneGraph&)> callback) {
+        modelsLoadedCallback_ = std::move(callback);
+    }
+
+    /*!
+     * Enables or disables skipping the meshes outside the camera's view. Enabled by default.
+     */
+    void setFrustumCulling(bool enabled) { frustumCulling_ = enabled; }
+
+    /*!
+     * Sets how many pixels a mesh's level of detail may be off its full detail surface on screen:
+     * meshes are drawn at the coarsest level within it. 1 by default, 0 draws every mesh at full
+     * detail.
+     */
+    void setLodPixelError(float pixels) { lodPixelError_ = pixels; }
+
+    /*!
+     * Enables or disables skipping the meshlets (see ModelMesh::BuildMeshlets()) of meshes drawn at
+     * full detail that are outside the view or face away from the camera. An instance is only drawn
+     * from its meshlets left, in a draw call of its own, when they leave out a quarter of its
+     * triangles or more; it's drawn whole with its batch otherwise. Enabled by default.
+     */
+    void setMeshletCulling(bool enabled) { meshletCulling_ = enabled; }
+
+    /*!
+     * Enables or disables packing the meshes of the scenes applied from then on into a few shared
+     * vertex and index buffers, one vertex array per vertex layout, rather than buffers per mesh.
+     * Meshes aren't edited once uploaded, so they all qualify, their transforms staying per instance.
+     * Saves the vertex array binds between meshes, and the driver tracking a buffer per mesh.
+     * Disabled by default.
+     */
+    void setGeometryMerging(bool enabled) { shader_->setGeometryMerging(enabled); }
+
+    /*!
+     * Sets the job system building the draw list, JobSystem::GetShared() by default. With none, the
+     * draw list is built on the render thread alone.
+     */
+    void setJobSystem(JobSystem* job_system) { jobSystem_ = job_system; }
+
     /*!
      * Gets the shader program available for this renderer
      * @return Shader
@@ -34,7 +106,7 @@ public:
     Shader* GetShaderProgram() const { return shader_.get(); }
 
     /*!
-     * Handles input from the android_app.
+     * Handles input from the android_app. Does nothing for an offscreen renderer.
      *
      * Note: this will clear the input queue
      */
@@ -45,12 +117,34 @@ public:
      */
     void render();
 
+    /*!
+     * @return the counters gathered while rendering the last frame
+     */
+    const RenderStats& GetFrameStats() const { return frame_stats_; }
+
 private:
     /*!
      *  draws the entire scene nodes.
      */
     void renderCurrentScene();
 
+    /*!
+     * Builds drawList_ from the current scene: the render objects are split in chunks, and jobs
+     * cull each chunk's mesh instances, pick their level of detail, cull their meshlets and generate
+     * their sort keys in parallel. Their sorted draws are then merged on this thread, and batched by mesh for
+     * instanced drawing.
+     * @param frustum if not null, the instances outside it are left out
+     * @param view_matrix the camera's, for the draws' depth
+     * @param projection_matrix the camera's, for the meshes' size on screen
+     */
+    void buildDrawList(const Frustum* frustum, const glm::mat4& view_matrix, const glm::mat4& projection_matrix);
+
+    /*!
+     * Swaps in the scene's models that finished loading in the background, and creates their gpu
+     * resources. GL calls have to be made on this thread, so that's the only loading step done here.
+     */
+    void applyLoadedModels();
+
     /*!
      * Performs necessary OpenGL initialization. Customize this if you want to change your EGL
      * context or application-wide settings.
@@ -67,11 +161,45 @@ private:
     EGLDisplay display_;
     EGLSurface surface_;
     EGLContext context_;
+    bool offscreen_ = false;
+    int offscreen_width_ = 0;
+    int offscreen_height_ = 0;
     int width_ = 0;
     int height_ = 0;
     bool shaderNeedsNewProjectionMatrix_ = false;
+    bool frustumCulling_ = true;
+    float lodPixelError_ = 1.0f;
+    bool meshletCulling_ = true;
+    // declared before the shader, which uses it until it's destroyed
+    GLStateCache glState_;
     std::shared_ptr<Shader> shader_;
     std::unique_ptr<SceneGraph> _current_scene;
+    RenderStats frame_stats_;
+    std::function<void(SceneGraph&)> modelsLoadedCallback_;
+
+    JobSystem* jobSystem_ = &JobSystem::GetShared();
+
+    // a chunk of render objects, and the draws its job produced. Kept to reuse the allocations.
+    struct DrawChunk {
+        size_t begin = 0;
+        size_t end = 0;
+        BoundingSphereArray spheres;
+        std::vector<DrawItem> candidates;
+        // the mesh instance of each candidate, which keeps its level of detail
+        std::vector<const MeshInstance*> instances;
+        std::vector<uint32_t> visible;
+        std::vector<DrawItem> items;
+        // the meshlets left by the items' meshlet culling, which they point into
+        std::vector<uint32_t> meshlets;
+        uint64_t culled = 0;
+        uint64_t triangles = 0;
+        uint64_t triangles_saved = 0;
+        uint64_t meshlets_culled = 0;
+        uint64_t triangles_culled = 0;
+    };
+    std::vector<DrawChunk> drawChunks_;
+    DrawList drawList_;
+    LightClusters lightClusters_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
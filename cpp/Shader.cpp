@@ -1,9 +1,16 @@
 #include "Shader.h"
 
 #include "AndroidOut.h"
+#include "GeometryPool.h"
 #include "Model.h"
+#include "StreamBuffer.h"
 #include "Utility.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
 // Vertex shader, you'd typically load this from assets
 // TBD: pg 120, GL shader book
 static const char* g_vertex_source = R"vertex(#version 300 es
@@ -14,12 +21,22 @@ in vec3 inPosition;
 in vec3 inNormal;
 in vec4 inTangent; // ****TODO: Missing vertex attribute!****
 in vec2 inUV;
+// per instance
+in mat4 inModel;
+in mat3 inNormalMatrix;
 
-uniform mat4 uModel;
-uniform mat4 uCameraView;
-uniform mat4 uProjection;
+// per frame
+layout(std140) uniform uCameraBlock
+{
+    mat4 uCameraView;
+    mat4 uProjection;
+    mat4 uCameraViewProjection;
+    vec4 uCameraPosition;
+};
 
-uniform vec3 uCameraPosition;
+// dequantization of 16-bit normalized positions. (0, 0, 0) and (1, 1, 1) for float positions.
+uniform vec3 uPositionOffset;
+uniform vec3 uPositionScale;
 
 out vec3 vPosition;
 out vec3 vNormal;
@@ -29,16 +46,14 @@ out vec2 vUV;
 
 void main()
 {
-    mat4 modelViewMatrix = uCameraView * uModel;
+    vec3 position = uPositionOffset + inPosition * uPositionScale;
 
-    gl_Position = uProjection * modelViewMatrix * vec4(inPosition, 1.0);
+    vec4 world_pos = inModel * vec4(position, 1.0);
+    gl_Position = uCameraViewProjection * world_pos;
 
-    mat4 model_inverse = inverse(uModel);
-
-    vec4 world_pos = uModel * vec4(inPosition, 1.0);
     vPosition = world_pos.xyz / world_pos.w;
-    vNormal = normalize(mat3(model_inverse) * inNormal);
-    vTangent = normalize(mat3(uModel) * inTangent.xyz);
+    vNormal = normalize(inNormalMatrix * inNormal);
+    vTangent = normalize(mat3(inModel) * inTangent.xyz);
     vBiTangent = cross(vNormal, vTangent) * inTangent.w;
     vUV = inUV;
 }
@@ -48,9 +63,10 @@ void main()
 static const char* g_fragment_source = R"fragment(#version 300 es
 
 precision mediump float;
+precision highp int;
 
 #define PI 3.1415
-#define MAX_LIGHTS 5
+#define MAX_LIGHTS 256
 
 in vec3 vPosition;
 in vec3 vNormal;
@@ -58,13 +74,35 @@ in vec3 vTangent;
 in vec3 vBiTangent;
 in vec2 vUV;
 
-uniform mat4 uModel;
-uniform mat4 uCameraView;
-uniform mat4 uProjection;
+// per frame, shared with the vertex shader
+layout(std140) uniform uCameraBlock
+{
+    mat4 uCameraView;
+    mat4 uProjection;
+    mat4 uCameraViewProjection;
+    vec4 uCameraPosition;
+};
 
-uniform vec3 uCameraPosition;
-uniform vec3 uLightPosition;
-uniform vec3 uLightColor;
+struct Light {
+    int light_type;
+    vec3 light_position;
+    float light_range; // 0: reaches everything
+    vec3 light_color;
+};
+layout(std140) uniform uLightBlock
+{
+    // x: the number of global lights, which come first and light every fragment
+    ivec4 uLightCounts;
+    Light uLights[MAX_LIGHTS];
+};
+
+// the clustered lights: per cluster (tile x, tile y, depth slice), the offset and number of its
+// lights in the index list, laid out in rows
+uniform highp usampler3D uLightClusters;
+uniform highp usampler2D uLightIndices;
+// xy: tiles per pixel. A view depth d falls in slice (uClusterLogDepth != 0 ? log(d) : d) * z + w
+uniform vec4 uClusterScale;
+uniform int uClusterLogDepth;
 
 uniform sampler2D uColorTexture;  // for diffuse mapping
 uniform sampler2D uNormalTexture; // for normal mapping
@@ -74,7 +112,8 @@ struct Material {
     float specular_power;
     vec3 specular_color;
     vec3 ambient_color;
-    vec3 diffuse_color;
+    vec4 diffuse_color; // multiplies the color texture
+    vec3 emissive_color;
 };
 layout(std140) uniform uMaterialBlock
 {
@@ -110,22 +149,50 @@ vec3 ComputeSpecularReflection(vec3 normal, vec3 half_vector, float nl, vec3 lig
     return light_color * uMaterial.specular_color * highlight;
 }
 
-vec3 Shade(vec3 world_position, vec3 normal, vec3 camera_position, vec3 diffuse_color)
+vec3 Shade(Light light, vec3 world_position, vec3 normal, vec3 camera_position, vec3 diffuse_color)
 {
-    vec3 light_direction = normalize(uLightPosition - world_position);
-    vec3 diffuse = ComputeDiffuseReflection(normal, light_direction, uLightColor, diffuse_color);
+    vec3 light_direction = normalize(light.light_position - world_position);
+    vec3 diffuse = ComputeDiffuseReflection(normal, light_direction, light.light_color, diffuse_color);
 
     vec3 eye_direction = normalize(camera_position - world_position);
     vec3 half_vector = normalize(light_direction + eye_direction);
     float nl = clamp(dot(normal, light_direction), 0.0, 1.0);
-    vec3 specular = ComputeSpecularReflection(normal, half_vector, nl, uLightColor);
+    vec3 specular = ComputeSpecularReflection(normal, half_vector, nl, light.light_color);
 
     float nh = clamp(dot(normal, half_vector), 0.0, 1.0);
-    vec3 direct_color = (((uMaterial.surface_albedo / PI) * (diffuse * nl)) + (specular * pow(nh, uMaterial.specular_power))) * uLightColor;
+    vec3 direct_color = (((uMaterial.surface_albedo / PI) * (diffuse * nl)) + (specular * pow(nh, uMaterial.specular_power))) * light.light_color;
 
+    if(light.light_range > 0.0) {
+        // fades out smoothly to 0 at the range
+        float falloff = clamp(1.0 - pow(length(light.light_position - world_position) / light.light_range, 4.0), 0.0, 1.0);
+        direct_color *= falloff * falloff;
+    }
     return direct_color;
 }
 
+vec3 ShadeLights(vec3 world_position, vec3 normal, vec3 camera_position, vec3 diffuse_color)
+{
+    vec3 color = vec3(0.0);
+    for(int i = 0; i < uLightCounts.x; ++i) {
+        color += Shade(uLights[i], world_position, normal, camera_position, diffuse_color);
+    }
+
+    // the lights listed in this fragment's cluster
+    ivec3 cluster_counts = textureSize(uLightClusters, 0);
+    float view_depth = -(uCameraView * vec4(world_position, 1.0)).z;
+    float depth = uClusterLogDepth != 0 ? log(max(view_depth, 1e-4)) : view_depth;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * uClusterScale.xy), int(floor(depth * uClusterScale.z + uClusterScale.w)));
+    cluster = clamp(cluster, ivec3(0), cluster_counts - 1);
+    uvec2 lights = texelFetch(uLightClusters, cluster, 0).xy;
+
+    int row_length = textureSize(uLightIndices, 0).x;
+    for(int i = int(lights.x); i < int(lights.x + lights.y); ++i) {
+        int light_index = int(texelFetch(uLightIndices, ivec2(i % row_length, i / row_length), 0).x);
+        color += Shade(uLights[light_index], world_position, normal, camera_position, diffuse_color);
+    }
+    return color;
+}
+
 void main()
 {
     //uMaterial.surface_albedo = vec3(PI * 1.3);
@@ -140,13 +207,13 @@ void main()
     vec3 bitangent = normalize( vBiTangent );
 
     // color texture value
-    vec4 diffuse_color = texture(uColorTexture, vUV).rgba;
+    vec4 diffuse_color = texture(uColorTexture, vUV).rgba * uMaterial.diffuse_color;
 
     normal = FetchObjectNormal(vUV, normal, tangent, bitangent);
 
-    vec3 material_color = Shade(vPosition, normal, uCameraPosition, diffuse_color.rgb);
+    vec3 material_color = ShadeLights(vPosition, normal, uCameraPosition.xyz, diffuse_color.rgb);
 
-    fragColor = vec4(material_color, diffuse_color.a);
+    fragColor = vec4(material_color + uMaterial.emissive_color, diffuse_color.a);
 }
 )fragment";
 
@@ -159,13 +226,15 @@ struct Shader::ShaderParametersDefinition {
     std::string uv_name_;
 
     std::string model_name_;
-    std::string camera_view_name_;
-    std::string projection_name;
+    std::string normal_matrix_name_;
 
-    std::string camera_position_name_;
-    std::string light_position_name_;
-    std::string light_color_name_;
+    std::string position_offset_name_;
+    std::string position_scale_name_;
+    std::string cluster_scale_name_;
+    std::string cluster_log_depth_name_;
 
+    std::string camera_block_name_;
+    std::string light_block_name_;
     std::string material_block_name_;
 
     GLint position_idx_ = -1;
@@ -174,13 +243,17 @@ struct Shader::ShaderParametersDefinition {
     GLint uv_idx_ = -1;
 
     GLint model_idx_ = -1;
-    GLint camera_view_idx_ = -1;
-    GLint projection_idx_ = -1;
+    GLint normal_matrix_idx_ = -1;
 
-    GLint camera_position_idx_ = -1;
-    GLint light_position_idx_ = -1;
-    GLint light_color_idx_ = -1;
+    GLint position_offset_idx_ = -1;
+    GLint position_scale_idx_ = -1;
+    GLint cluster_scale_idx_ = -1;
+    GLint cluster_log_depth_idx_ = -1;
 
+    GLuint camera_block_idx_ = -1;
+    GLint camera_block_binding_point_ = 0;
+    GLuint light_block_idx_ = -1;
+    GLint light_block_binding_point_ = 2;
     GLuint material_block_idx_ = -1;
     GLint material_block_binding_point_ = 1;
 
@@ -188,6 +261,10 @@ struct Shader::ShaderParametersDefinition {
     int color_texture_slot_number = -1;
     std::string normal_texture_sampler_name;
     int normal_texture_slot_number = -1;
+    std::string light_clusters_sampler_name;
+    int light_clusters_slot_number = -1;
+    std::string light_indices_sampler_name;
+    int light_indices_slot_number = -1;
 };
 
 struct MeshMaterial
@@ -199,9 +276,24 @@ struct MeshMaterial
     glm::vec3 diffuse_color = glm::vec3(1.0, 1.0, 1.0);  // noon/daylight;
 };
 
+struct CameraUBO
+{   // the uCameraBlock layout, std140
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    glm::vec4 position;
+};
+
+struct Shader::LightsUBO
+{   // the uLightBlock layout, std140
+    glm::ivec4 counts = glm::ivec4(0);
+    SceneLight lights[MAX_LIGHTS];
+};
+
 
-Shader::Shader(GLuint program_id)
+Shader::Shader(GLuint program_id, GLStateCache& gl_state)
 : program_id_(program_id)
+, gl_state_(gl_state)
 {
     params_ = new ShaderParametersDefinition;
     params_->position_name_ = "inPosition";
@@ -209,25 +301,52 @@ Shader::Shader(GLuint program_id)
     params_->tangent_name_ = "inTangent";
     params_->uv_name_ = "inUV";
 
-    params_->model_name_ = "uModel";
-    params_->camera_view_name_ = "uCameraView";
-    params_->projection_name = "uProjection";
+    params_->model_name_ = "inModel";
+    params_->normal_matrix_name_ = "inNormalMatrix";
 
-    params_->camera_position_name_ = "uCameraPosition";
-    params_->light_position_name_ = "uLightPosition";
-    params_->light_color_name_ = "uLightColor";
+    params_->position_offset_name_ = "uPositionOffset";
+    params_->position_scale_name_ = "uPositionScale";
+    params_->cluster_scale_name_ = "uClusterScale";
+    params_->cluster_log_depth_name_ = "uClusterLogDepth";
 
+    params_->camera_block_name_ = "uCameraBlock";
+    params_->light_block_name_ = "uLightBlock";
     params_->material_block_name_ = "uMaterialBlock";
 
     params_->color_texture_sampler_name = "uColorTexture";
     params_->color_texture_slot_number = 0;
     params_->normal_texture_sampler_name = "uNormalTexture";
     params_->normal_texture_slot_number = 1;
+    params_->light_clusters_sampler_name = "uLightClusters";
+    params_->light_clusters_slot_number = 2;
+    params_->light_indices_sampler_name = "uLightIndices";
+    params_->light_indices_slot_number = 3;
+
+    camera_buffer_ = std::make_unique<StreamBuffer>(gl_state_, GL_UNIFORM_BUFFER);
+    instance_buffer_ = std::make_unique<StreamBuffer>(gl_state_, GL_ARRAY_BUFFER);
+    index_stream_ = std::make_unique<StreamBuffer>(gl_state_, GL_ELEMENT_ARRAY_BUFFER);
+    light_buffer_ = std::make_unique<StreamBuffer>(gl_state_, GL_UNIFORM_BUFFER);
+    lights_ubo_ = std::make_unique<LightsUBO>();
 }
 
 Shader::~Shader() {
+    camera_buffer_.reset();
+    instance_buffer_.reset();
+    index_stream_.reset();
+    light_buffer_.reset();
+    geometry_pool_.reset();
+    if(material_buffer_id_ != 0) {
+        gl_state_.deleteBuffer(material_buffer_id_);
+        material_buffer_id_ = 0;
+    }
+    for(GLuint* texture_id : {&light_clusters_texture_id_, &light_indices_texture_id_}) {
+        if(*texture_id != 0) {
+            gl_state_.deleteTexture(*texture_id);
+            *texture_id = 0;
+        }
+    }
     if (program_id_ != -1) {
-        glDeleteProgram(program_id_);
+        gl_state_.deleteProgram(program_id_);
         program_id_ = 0;
     }
     if(params_ != nullptr) {
@@ -236,7 +355,7 @@ Shader::~Shader() {
     }
 }
 
-Shader *Shader::loadShader()
+Shader *Shader::loadShader(GLStateCache& gl_state)
 {
     Shader *shader = nullptr;
 
@@ -260,7 +379,7 @@ Shader *Shader::loadShader()
         GLint linkStatus = GL_FALSE;
         glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
         if (linkStatus == GL_TRUE) {
-            shader = new Shader(program);
+            shader = new Shader(program, gl_state);
         } else {
             GLint logLength = 0;
             glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
@@ -314,7 +433,7 @@ GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
     return shader;
 }
 
-void Shader::useShader(Model& model)
+void Shader::loadParameterLocations()
 {
     // if we haven't fetched the shader's attribute and uniform locations, do so at this time.
     if(params_->position_idx_ == -1) {
@@ -331,164 +450,725 @@ void Shader::useShader(Model& model)
     }
 
     if(params_->model_idx_ == -1) {
-        params_->model_idx_ = glGetUniformLocation(program_id_, params_->model_name_.c_str());
+        params_->model_idx_ = glGetAttribLocation(program_id_, params_->model_name_.c_str());
     }
-    if(params_->camera_view_idx_ == -1) {
-        params_->camera_view_idx_ = glGetUniformLocation(program_id_, params_->camera_view_name_.c_str());
-    }
-    if(params_->projection_idx_ == -1) {
-        params_->projection_idx_ = glGetUniformLocation(program_id_, params_->projection_name.c_str());
+    if(params_->normal_matrix_idx_ == -1) {
+        params_->normal_matrix_idx_ = glGetAttribLocation(program_id_, params_->normal_matrix_name_.c_str());
     }
 
-    if(params_->camera_position_idx_ == -1) {
-        params_->camera_position_idx_ = glGetUniformLocation(program_id_, params_->camera_position_name_.c_str());
+    if(params_->position_offset_idx_ == -1) {
+        params_->position_offset_idx_ = glGetUniformLocation(program_id_, params_->position_offset_name_.c_str());
+    }
+    if(params_->position_scale_idx_ == -1) {
+        params_->position_scale_idx_ = glGetUniformLocation(program_id_, params_->position_scale_name_.c_str());
     }
-    if(params_->light_position_idx_ == -1) {
-        params_->light_position_idx_ = glGetUniformLocation(program_id_, params_->light_position_name_.c_str());
+    if(params_->cluster_scale_idx_ == -1) {
+        params_->cluster_scale_idx_ = glGetUniformLocation(program_id_, params_->cluster_scale_name_.c_str());
     }
-    if(params_->light_color_idx_ == -1) {
-        params_->light_color_idx_ = glGetUniformLocation(program_id_, params_->light_color_name_.c_str());
+    if(params_->cluster_log_depth_idx_ == -1) {
+        params_->cluster_log_depth_idx_ = glGetUniformLocation(program_id_, params_->cluster_log_depth_name_.c_str());
+    }
+
+    if(params_->camera_block_idx_ == -1) {
+        params_->camera_block_idx_ = glGetUniformBlockIndex(program_id_, params_->camera_block_name_.c_str());
+        glUniformBlockBinding(program_id_, params_->camera_block_idx_, params_->camera_block_binding_point_);
+    }
+    if(params_->light_block_idx_ == -1) {
+        params_->light_block_idx_ = glGetUniformBlockIndex(program_id_, params_->light_block_name_.c_str());
+        glUniformBlockBinding(program_id_, params_->light_block_idx_, params_->light_block_binding_point_);
+
+        // the light cluster textures stay on their own units
+        gl_state_.useProgram(program_id_);
+        gl_state_.uniform1i(glGetUniformLocation(program_id_, params_->light_clusters_sampler_name.c_str()),
+                            params_->light_clusters_slot_number);
+        gl_state_.uniform1i(glGetUniformLocation(program_id_, params_->light_indices_sampler_name.c_str()),
+                            params_->light_indices_slot_number);
     }
 
     if(params_->material_block_idx_ == -1) {
         params_->material_block_idx_ = glGetUniformBlockIndex(program_id_, params_->material_block_name_.c_str());
         // Associate the uniform block index with a binding point
         glUniformBlockBinding ( program_id_, params_->material_block_idx_, params_->material_block_binding_point_ );
-        // Get the size of lightData; alternatively,
-        // we can calculate it using sizeof(lightData) in this example
+        // each material gets a block of this size in the material buffer, created as materials are
+        // uploaded. Draws bind their material's range.
         GLint block_size = 0;
         glGetActiveUniformBlockiv ( program_id_, params_->material_block_idx_,
                         GL_UNIFORM_BLOCK_DATA_SIZE,
                         &block_size );
-        // Create and fill a buffer object
-        MaterialUBO mesh_material; // create a default material
-        GLuint buffer_id = -1;
-        glGenBuffers ( 1, &buffer_id );
-        glBindBuffer ( GL_UNIFORM_BUFFER, buffer_id );
-        glBufferData ( GL_UNIFORM_BUFFER, block_size, &mesh_material,
-                GL_DYNAMIC_DRAW);
-        // Bind the buffer object to the uniform block binding point
-        glBindBufferBase ( GL_UNIFORM_BUFFER, params_->material_block_binding_point_, buffer_id );
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 1);
+        material_block_size_ = std::max<GLsizeiptr>(block_size, sizeof(MaterialUBO));
+        material_block_stride_ = (material_block_size_ + alignment - 1) / alignment * alignment;
     }
 
     // NOTE: for larger datasets, consider using Shader Storage Buffer Objects (SSBOs)
+}
 
-    // upload textures, if we haven't done so already.
-    for(const auto& mesh : model.GetMeshes()) {
-        if(mesh->_material._pbr_base_color_texture._id == -1) {
-            mesh->_material._pbr_base_color_texture._id = TextureAsset::uploadTexture(
-                    program_id_,
-                    params_->color_texture_sampler_name,
-                    params_->color_texture_slot_number,
-                    mesh->_material._pbr_base_color_texture._image_data.data(),
-                    mesh->_material._pbr_base_color_texture._image_width,
-                    mesh->_material._pbr_base_color_texture._image_height,
-                    mesh->_material._pbr_base_color_texture._sampler_wrap_s,
-                    mesh->_material._pbr_base_color_texture._sampler_wrap_t,
-                    mesh->_material._pbr_base_color_texture._sampler_min_filter,
-                    mesh->_material._pbr_base_color_texture._sampler_mag_filter);
+void Shader::useShader(Model& model, RenderStats& stats)
+{
+    // normally done when the scene is applied, this catches models added afterwards.
+    stats.bytes_uploaded += uploadModel(model);
+}
+
+/*!
+ * Describes one vertex stream of the mesh's vertex buffer, which holds the streams one after the other.
+ */
+template<typename T>
+static void SetupVertexStream(GLint attribute_idx, GLint elements, const SharedArray<T>& stream, size_t& offset)
+{
+    if(attribute_idx < 0) {
+        offset += stream.size() * sizeof(T);
+        return;
+    }
+    if(stream.empty()) {
+        // fall back to the attribute's constant value
+        glDisableVertexAttribArray(attribute_idx);
+        return;
+    }
+    glVertexAttribPointer(
+            attribute_idx, // attrib
+            elements, // elements
+            GL_FLOAT, // of type float
+            GL_FALSE, // don't normalize
+            sizeof(T), // stride is Vertex bytes
+            reinterpret_cast<const void*>(offset) // offset of this stream in the vertex buffer
+    );
+    glEnableVertexAttribArray(attribute_idx);
+    offset += stream.size() * sizeof(T);
+}
+
+/*!
+ * Describes one attribute of an interleaved vertex buffer.
+ */
+static void SetupInterleavedAttribute(
+        GLint attribute_idx,
+        GLint elements,
+        GLenum type,
+        GLboolean normalized,
+        GLsizei stride,
+        size_t offset)
+{
+    if(attribute_idx < 0) {
+        return;
+    }
+    glVertexAttribPointer(attribute_idx, elements, type, normalized, stride, reinterpret_cast<const void*>(offset));
+    glEnableVertexAttribArray(attribute_idx);
+}
+
+/*!
+ * Points the per instance attributes, the model matrix and the normal matrix with a column per
+ * attribute location, at the bound instance buffer. GLES has no base instance, so a batch drawing
+ * the instances from the given offset on re-points them there.
+ */
+static void SetupInstanceAttributes(GLint model_idx, GLint normal_matrix_idx, size_t offset)
+{
+    if(model_idx >= 0) {
+        for(GLint column = 0; column < 4; ++column) {
+            glVertexAttribPointer(
+                    model_idx + column, 4, GL_FLOAT, GL_FALSE, sizeof(Shader::InstanceData),
+                    reinterpret_cast<const void*>(offset + offsetof(Shader::InstanceData, model) + column * sizeof(glm::vec4)));
         }
-        if( mesh->_material._normal_texture._id == -1 ) {
-            mesh->_material._normal_texture._id = TextureAsset::uploadTexture(
-                    program_id_,
-                    params_->normal_texture_sampler_name,
-                    params_->normal_texture_slot_number,
-                    mesh->_material._normal_texture._image_data.data(),
-                    mesh->_material._normal_texture._image_width,
-                    mesh->_material._normal_texture._image_height,
-                    mesh->_material._normal_texture._sampler_wrap_s,
-                    mesh->_material._normal_texture._sampler_wrap_t,
-                    mesh->_material._normal_texture._sampler_min_filter,
-                    mesh->_material._normal_texture._sampler_mag_filter);
+    }
+    if(normal_matrix_idx >= 0) {
+        for(GLint column = 0; column < 3; ++column) {
+            glVertexAttribPointer(
+                    normal_matrix_idx + column, 3, GL_FLOAT, GL_FALSE, sizeof(Shader::InstanceData),
+                    reinterpret_cast<const void*>(offset + offsetof(Shader::InstanceData, normal_matrix) + column * sizeof(glm::vec3)));
         }
     }
 }
 
-void Shader::activate() const {
-    glUseProgram(program_id_);
+/*!
+ * @return the uMaterialBlock contents of a material, approximating its glTF factors with the
+ * shader's Blinn-Phong terms
+ */
+static MaterialUBO MakeMaterialBlock(const Material& material)
+{
+    MaterialUBO block;
+    block.diffuse_color = material._base_color_factor;
+    // metals reflect their base color, dielectrics about 4% of the light
+    const glm::vec3 specular = glm::mix(glm::vec3(0.04f), glm::vec3(material._base_color_factor),
+                                        glm::clamp(material._metallic_factor, 0.0f, 1.0f));
+    block.specular_color = glm::vec4(specular, 1.0f);
+    // the Blinn-Phong exponent matching a microfacet distribution of alpha = roughness^2
+    const float alpha = std::max(material._roughness_factor * material._roughness_factor, 1e-3f);
+    block.specular_power = glm::clamp(2.0f / (alpha * alpha) - 2.0f, 1.0f, 300.0f);
+    block.emissive_color = glm::vec4(material._emissive_factor, 0.0f);
+    return block;
 }
 
-void Shader::deactivate() const {
-    glUseProgram(0);
+size_t Shader::uploadMaterial(Material& material)
+{
+    int slot;
+    if(!free_material_slots_.empty()) {
+        slot = free_material_slots_.back();
+        free_material_slots_.pop_back();
+    } else {
+        slot = material_slot_count_++;
+    }
+    if(slot >= material_slot_capacity_) {
+        // grow the buffer, keeping the blocks already written
+        const int capacity = std::max(2 * material_slot_capacity_, 64);
+        GLuint buffer_id = 0;
+        glGenBuffers(1, &buffer_id);
+        gl_state_.bindBuffer(GL_UNIFORM_BUFFER, buffer_id);
+        glBufferData(GL_UNIFORM_BUFFER, capacity * material_block_stride_, nullptr, GL_STATIC_DRAW);
+        if(material_buffer_id_ != 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, material_buffer_id_);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_UNIFORM_BUFFER, 0, 0,
+                                material_slot_capacity_ * material_block_stride_);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            gl_state_.deleteBuffer(material_buffer_id_);
+        }
+        material_buffer_id_ = buffer_id;
+        material_slot_capacity_ = capacity;
+    }
+
+    const MaterialUBO block = MakeMaterialBlock(material);
+    gl_state_.bindBuffer(GL_UNIFORM_BUFFER, material_buffer_id_);
+    glBufferSubData(GL_UNIFORM_BUFFER, slot * material_block_stride_, sizeof(block), &block);
+    material._uniform_block_slot = slot;
+    return sizeof(block);
+}
+
+/*!
+ * @return what identifies the gl texture of a texture sharing its image: the image, and the sampler
+ * parameters set on the gl texture
+ */
+static Shader::SharedTextureKey MakeSharedTextureKey(const Texture& texture)
+{
+    return Shader::SharedTextureKey(texture._cache_key,
+                                    texture._sampler_wrap_s, texture._sampler_wrap_t,
+                                    texture._sampler_min_filter, texture._sampler_mag_filter);
+}
+
+size_t Shader::uploadTexture(Texture& texture, const std::string& sampler_name, int slot_number)
+{
+    if(texture._cache_key != 0) {
+        auto found = shared_textures_.find(MakeSharedTextureKey(texture));
+        if(found != shared_textures_.end()) {
+            found->second.references += 1;
+            texture._id = found->second.texture_id;
+            texture._image_data = SharedArray<u_char>();
+            return 0;
+        }
+    }
+
+    texture._id = TextureAsset::uploadTexture(
+            gl_state_,
+            program_id_,
+            sampler_name,
+            slot_number,
+            texture._image_data.data(),
+            texture._image_width,
+            texture._image_height,
+            texture._mip_levels,
+            texture._sampler_wrap_s,
+            texture._sampler_wrap_t,
+            texture._sampler_min_filter,
+            texture._sampler_mag_filter,
+            texture._compressed_format);
+    const size_t uploaded_bytes = texture._image_data.size();
+    if(texture._cache_key != 0) {
+        shared_textures_[MakeSharedTextureKey(texture)] = {texture._id, 1};
+    }
+    // draws only need the gpu copy
+    texture._image_data = SharedArray<u_char>();
+    return uploaded_bytes;
+}
+
+void Shader::releaseTexture(Texture& texture)
+{
+    if(texture._id == -1) {
+        return;
+    }
+    if(texture._cache_key != 0) {
+        auto found = shared_textures_.find(MakeSharedTextureKey(texture));
+        if(found != shared_textures_.end() && found->second.texture_id == texture._id) {
+            found->second.references -= 1;
+            if(found->second.references > 0) {
+                texture._id = -1;
+                return;
+            }
+            shared_textures_.erase(found);
+        }
+    }
+    gl_state_.deleteTexture(texture._id);
+    texture._id = -1;
+}
+
+template<typename T>
+static void UploadVertexStream(const SharedArray<T>& stream, size_t& offset)
+{
+    const auto stream_size = stream.size() * sizeof(T);
+    if(stream_size > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, stream_size, stream.data());
+    }
+    offset += stream_size;
+}
+
+static size_t GetIndexSize(GLenum index_type)
+{
+    return index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// appends 16 or 32-bit indices to a byte buffer, plus the first vertex of the mesh in its vertex
+// buffer, in the gpu index type
+template<typename T>
+static void AppendIndices(const T* indices, size_t count, GLenum index_type, Index first_vertex,
+                          std::vector<u_char>& bytes)
+{
+    const size_t offset = bytes.size();
+    const size_t index_size = GetIndexSize(index_type);
+    bytes.resize(offset + count * index_size);
+    if(first_vertex == 0 && index_size == sizeof(T)) {
+        memcpy(bytes.data() + offset, indices, count * sizeof(T));
+    } else if(index_type == GL_UNSIGNED_SHORT) {
+        for(size_t i = 0; i < count; ++i) {
+            const auto index = static_cast<uint16_t>(first_vertex + indices[i]);
+            memcpy(bytes.data() + offset + i * sizeof(index), &index, sizeof(index));
+        }
+    } else {
+        for(size_t i = 0; i < count; ++i) {
+            const Index index = first_vertex + indices[i];
+            memcpy(bytes.data() + offset + i * sizeof(index), &index, sizeof(index));
+        }
+    }
 }
 
-void Shader::drawModel(Model& model, const glm::vec3& camera_position, const std::vector<SceneLight>& lights) {
+// appends count of a mesh's indices, from the first one, to a byte buffer, see above
+static void AppendIndices(const IndexArray& indices, size_t first, size_t count, GLenum index_type,
+                          Index first_vertex, std::vector<u_char>& bytes)
+{
+    if(indices.IsWide()) {
+        AppendIndices(indices.GetWide().data() + first, count, index_type, first_vertex, bytes);
+    } else {
+        AppendIndices(indices.GetShort().data() + first, count, index_type, first_vertex, bytes);
+    }
+}
 
-    static std::vector<SceneLight> lights_buffer(lights.size());
+// writes indices into the bound index buffer, at a byte offset. Those already in the gpu index type
+// are written as they are.
+static void UploadIndices(const IndexArray& indices, GLenum index_type, size_t offset)
+{
+    if(indices.empty()) {
+        return;
+    }
+    if(indices.GetIndexSize() == GetIndexSize(index_type)) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, indices.size() * indices.GetIndexSize(), indices.data());
+        return;
+    }
+    std::vector<u_char> bytes;
+    AppendIndices(indices, 0, indices.size(), index_type, 0, bytes);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, bytes.size(), bytes.data());
+}
 
-    assert(lights.size() <= 5);
+void Shader::setupPackedAttributes(VertexLayout layout)
+{
+    if(layout == VertexLayout::Packed) {
+        const GLsizei stride = sizeof(PackedVertex);
+        SetupInterleavedAttribute(params_->position_idx_, 3, GL_FLOAT, GL_FALSE, stride, offsetof(PackedVertex, position));
+        SetupInterleavedAttribute(params_->normal_idx_, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offsetof(PackedVertex, normal));
+        SetupInterleavedAttribute(params_->tangent_idx_, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offsetof(PackedVertex, tangent));
+        SetupInterleavedAttribute(params_->uv_idx_, 2, GL_HALF_FLOAT, GL_FALSE, stride, offsetof(PackedVertex, uv));
+    } else if(layout == VertexLayout::PackedQuantized) {
+        const GLsizei stride = sizeof(QuantizedVertex);
+        SetupInterleavedAttribute(params_->position_idx_, 3, GL_SHORT, GL_TRUE, stride, offsetof(QuantizedVertex, position));
+        SetupInterleavedAttribute(params_->normal_idx_, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offsetof(QuantizedVertex, normal));
+        SetupInterleavedAttribute(params_->tangent_idx_, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offsetof(QuantizedVertex, tangent));
+        SetupInterleavedAttribute(params_->uv_idx_, 2, GL_HALF_FLOAT, GL_FALSE, stride, offsetof(QuantizedVertex, uv));
+    }
+}
 
-    useShader(model);
+void Shader::setupInstanceAttributes()
+{
+    gl_state_.bindBuffer(GL_ARRAY_BUFFER, instance_buffer_->getBufferId());
+    SetupInstanceAttributes(params_->model_idx_, params_->normal_matrix_idx_, 0);
+    auto enable_per_instance = [](GLint attribute_idx, GLint columns) {
+        for(GLint column = 0; attribute_idx >= 0 && column < columns; ++column) {
+            glEnableVertexAttribArray(attribute_idx + column);
+            glVertexAttribDivisor(attribute_idx + column, 1);
+        }
+    };
+    enable_per_instance(params_->model_idx_, 4);
+    enable_per_instance(params_->normal_matrix_idx_, 3);
+}
+
+void Shader::setupMergedAttributes(VertexLayout layout, size_t vertex_capacity)
+{
+    if(layout != VertexLayout::Separate) {
+        setupPackedAttributes(layout);
+    } else {
+        // the streams of every vertex the buffer has room for, one after the other
+        size_t offset = 0;
+        SetupInterleavedAttribute(params_->position_idx_, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), offset);
+        offset += vertex_capacity * sizeof(glm::vec3);
+        SetupInterleavedAttribute(params_->normal_idx_, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), offset);
+        offset += vertex_capacity * sizeof(glm::vec3);
+        SetupInterleavedAttribute(params_->tangent_idx_, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), offset);
+        offset += vertex_capacity * sizeof(glm::vec4);
+        SetupInterleavedAttribute(params_->uv_idx_, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), offset);
+    }
+    setupInstanceAttributes();
+}
 
-    // --scene-wide level attributes--
-    glUniform3fv(params_->camera_position_idx_, 1, glm::value_ptr(camera_position));
+size_t Shader::uploadModel(Model& model)
+{
+    loadParameterLocations();
 
-    // set light info
-    glUniform3fv(params_->light_position_idx_, 1, glm::value_ptr(lights[0].light_position));
-    glUniform3fv(params_->light_color_idx_, 1, glm::value_ptr(lights[0].light_color));
+    size_t uploaded_bytes = 0;
 
+    // upload materials and textures, if we haven't done so already.
+    for(const auto& mesh : model.GetMeshes()) {
+        for(auto& submesh : mesh->_submeshes) {
+            auto& material = submesh.material;
+            if(material._uniform_block_slot == -1) {
+                uploaded_bytes += uploadMaterial(material);
+            }
+            if(material._pbr_base_color_texture._id == -1) {
+                uploaded_bytes += uploadTexture(material._pbr_base_color_texture,
+                                                params_->color_texture_sampler_name,
+                                                params_->color_texture_slot_number);
+            }
+            if( material._normal_texture._id == -1 ) {
+                uploaded_bytes += uploadTexture(material._normal_texture,
+                                                params_->normal_texture_sampler_name,
+                                                params_->normal_texture_slot_number);
+            }
+        }
+    }
+
+    // upload the vertex streams and indices once, so draws only need to bind the vertex array.
+    for(const auto& mesh : model.GetMeshes()) {
+        if(mesh->_vertex_array_id != 0) {
+            continue;
+        }
+        mesh->_sort_id = next_mesh_sort_id_++;
+        if(geometry_merging_) {
+            if(geometry_pool_ == nullptr) {
+                geometry_pool_ = std::make_unique<GeometryPool>(gl_state_, [this](VertexLayout layout, size_t vertex_capacity) {
+                    setupMergedAttributes(layout, vertex_capacity);
+                });
+            }
+            if(geometry_pool_->add(*mesh, uploaded_bytes)) {
+                continue;
+            }
+        }
+        const bool is_packed = mesh->_vertex_layout != VertexLayout::Separate;
+        const size_t vertex_buffer_size = is_packed
+                ? mesh->_packed_vertices.size()
+                : mesh->_vertices.size() * sizeof(glm::vec3)
+                  + mesh->_normals.size() * sizeof(glm::vec3)
+                  + mesh->_tangents.size() * sizeof(glm::vec4)
+                  + mesh->_tex_coords.size() * sizeof(glm::vec2);
+
+        glGenVertexArrays(1, &mesh->_vertex_array_id);
+        gl_state_.bindVertexArray(mesh->_vertex_array_id);
+
+        glGenBuffers(1, &mesh->_vertex_buffer_id);
+        gl_state_.bindBuffer(GL_ARRAY_BUFFER, mesh->_vertex_buffer_id);
+
+        // the vertex array records the attribute layout...
+        if(is_packed) {
+            glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, mesh->_packed_vertices.data(), GL_STATIC_DRAW);
+            setupPackedAttributes(mesh->_vertex_layout);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, nullptr, GL_STATIC_DRAW);
+            size_t offset = 0;
+            UploadVertexStream(mesh->_vertices, offset);
+            UploadVertexStream(mesh->_normals, offset);
+            UploadVertexStream(mesh->_tangents, offset);
+            UploadVertexStream(mesh->_tex_coords, offset);
+
+            offset = 0;
+            SetupVertexStream(params_->position_idx_, 3, mesh->_vertices, offset);
+            SetupVertexStream(params_->normal_idx_, 3, mesh->_normals, offset);
+            SetupVertexStream(params_->tangent_idx_, 4, mesh->_tangents, offset);
+            SetupVertexStream(params_->uv_idx_, 2, mesh->_tex_coords, offset);
+        }
+
+        // ...the model and normal matrices, advancing once per instance, from the instance buffer...
+        setupInstanceAttributes();
+
+        // ...and the index buffer bound while it is active: the full mesh's indices, followed by its
+        // levels of detail's. 16-bit ones when the vertices allow, which halves the index fetches.
+        mesh->_index_type = mesh->_vertices.size() <= IndexArray::MAX_SHORT_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        const size_t index_size = GetIndexSize(mesh->_index_type);
+        const size_t index_buffer_size = (mesh->_indices.size() + mesh->_lod_indices.size()) * index_size;
+        glGenBuffers(1, &mesh->_index_buffer_id);
+        gl_state_.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->_index_buffer_id);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size, nullptr, GL_STATIC_DRAW);
+        UploadIndices(mesh->_indices, mesh->_index_type, 0);
+        UploadIndices(mesh->_lod_indices, mesh->_index_type, mesh->_indices.size() * index_size);
+
+        gl_state_.bindVertexArray(0);
+        gl_state_.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+        uploaded_bytes += vertex_buffer_size + index_buffer_size;
+    }
+    return uploaded_bytes;
+}
+
+void Shader::releaseModel(Model& model)
+{
     for(const auto& mesh : model.GetMeshes()) {
-        // --upload mvp for this draw call--
-        glUniformMatrix4fv(params_->model_idx_, 1, false, glm::value_ptr(mesh->_model_transform));
-        glUniformMatrix4fv(params_->camera_view_idx_, 1, false, glm::value_ptr(camera_view_matrix_));
-        glUniformMatrix4fv(params_->projection_idx_, 1, false, glm::value_ptr(projection_matrix_));
-        // -- vertex attributes --
-        // The position attribute is 3 floats
-        glVertexAttribPointer(
-                params_->position_idx_, // attrib
-                3, // elements
-                GL_FLOAT, // of type float
-                GL_FALSE, // don't normalize
-                sizeof(glm::vec3), // stride is Vertex bytes
-                mesh->_vertices.data() // pull from the start of the vertex data
-        );
-        glEnableVertexAttribArray(params_->position_idx_);
-        // The normal attribute is 3 floats
-        glVertexAttribPointer(
-                params_->normal_idx_, // attrib
-                3, // elements
-                GL_FLOAT, // of type float
-                GL_FALSE, // don't normalize
-                sizeof(glm::vec3), // stride is Vertex bytes
-                mesh->_normals.data() // pull from the start of the vertex data
-        );
-        glEnableVertexAttribArray(params_->normal_idx_);
-        // The tangent attribute is 4 floats
-        glVertexAttribPointer(
-                params_->tangent_idx_, // attrib
-                4, // elements
-                GL_FLOAT, // of type float
-                GL_FALSE, // don't normalize
-                sizeof(glm::vec4), // stride is Vertex bytes
-                mesh->_tangents.data() // pull from the start of the vertex data
-        );
-        glEnableVertexAttribArray(params_->tangent_idx_);
-        // The uv attribute is 2 floats
-        glVertexAttribPointer(
-                params_->uv_idx_, // attrib
-                2, // elements
-                GL_FLOAT, // of type float
-                GL_FALSE, // don't normalize
-                sizeof(glm::vec2), // stride is Vertex bytes
-                mesh->_tex_coords.data()
-        );
-        glEnableVertexAttribArray(params_->uv_idx_);
-        // --textures--
-        // activate the base color textures
-        glActiveTexture(GL_TEXTURE0); // GL_TEXTURE0.  (texture unit = GL_TEXTURE0 + idx)
-        glBindTexture(GL_TEXTURE_2D, mesh->_material._pbr_base_color_texture._id);
-        // activate the normal texture
-        glActiveTexture(GL_TEXTURE1); // GL_TEXTURE1.  (texture unit = GL_TEXTURE0 + idx)
-        glBindTexture(GL_TEXTURE_2D, mesh->_material._normal_texture._id);
-
-        // --Draw as indexed triangles--
-        glDrawElements(GL_TRIANGLES, mesh->_indices.size(), GL_UNSIGNED_SHORT, mesh->_indices.data());
-
-        glDisableVertexAttribArray(params_->uv_idx_);
-        glDisableVertexAttribArray(params_->tangent_idx_);
-        glDisableVertexAttribArray(params_->normal_idx_);
-        glDisableVertexAttribArray(params_->position_idx_);
+        // a merged mesh gives its ranges of the shared buffers back, which resets its ids. The others
+        // delete their own buffers.
+        if(geometry_pool_ != nullptr) {
+            geometry_pool_->remove(*mesh);
+        }
+        if(mesh->_vertex_array_id != 0) {
+            gl_state_.deleteVertexArray(mesh->_vertex_array_id);
+            mesh->_vertex_array_id = 0;
+        }
+        if(mesh->_vertex_buffer_id != 0) {
+            gl_state_.deleteBuffer(mesh->_vertex_buffer_id);
+            mesh->_vertex_buffer_id = 0;
+        }
+        if(mesh->_index_buffer_id != 0) {
+            gl_state_.deleteBuffer(mesh->_index_buffer_id);
+            mesh->_index_buffer_id = 0;
+        }
+        for(auto& submesh : mesh->_submeshes) {
+            auto& material = submesh.material;
+            if(material._uniform_block_slot != -1) {
+                free_material_slots_.push_back(material._uniform_block_slot);
+                material._uniform_block_slot = -1;
+            }
+            releaseTexture(material._pbr_base_color_texture);
+            releaseTexture(material._normal_texture);
+        }
+    }
+}
+
+void Shader::activate() const {
+    gl_state_.useProgram(program_id_);
+}
+
+void Shader::deactivate() const {
+    gl_state_.useProgram(0);
+}
+
+void Shader::uploadLights(const LightClusters& lights, RenderStats& stats)
+{
+    // --the light block: only written when a light changed, the last one written stays bound--
+    auto& ubo = *lights_ubo_;
+    const auto& scene_lights = lights.GetLights();
+    bool lights_changed = ubo.counts.x != static_cast<int>(lights.GetGlobalLightCount())
+                          || ubo.counts.y != static_cast<int>(scene_lights.size());
+    ubo.counts = glm::ivec4(static_cast<int>(lights.GetGlobalLightCount()), static_cast<int>(scene_lights.size()), 0, 0);
+    for(size_t i = 0; i < scene_lights.size(); ++i) {
+        // copied field by field, so that the padding stays zero and compares equal
+        SceneLight light = SceneLight();
+        light.light_type = scene_lights[i].light_type;
+        light.light_position = scene_lights[i].light_position;
+        light.light_range = scene_lights[i].light_range;
+        light.light_color = scene_lights[i].light_color;
+        if(memcmp(&ubo.lights[i], &light, sizeof(light)) != 0) {
+            ubo.lights[i] = light;
+            lights_changed = true;
+        }
+    }
+    if(lights_changed || !has_lights_) {
+        const GLintptr offset = light_buffer_->upload(&ubo, sizeof(ubo));
+        gl_state_.bindBufferRange(params_->light_block_binding_point_, light_buffer_->getBufferId(),
+                                  offset, sizeof(ubo));
+        stats.bytes_uploaded += sizeof(ubo);
+        has_lights_ = true;
+    }
+
+    // --which clusters of the view the lights with a range reach--
+    if(gl_state_.uniform4fv(params_->cluster_scale_idx_, glm::vec4(
+            float(LightClusters::TILES_X) / float(viewport_width_),
+            float(LightClusters::TILES_Y) / float(viewport_height_),
+            lights.GetDepthScale(),
+            lights.GetDepthBias()))) {
+        stats.bytes_uploaded += sizeof(glm::vec4);
+    }
+    gl_state_.uniform1i(params_->cluster_log_depth_idx_, lights.IsDepthLogarithmic() ? 1 : 0);
+
+    const auto& light_indices = lights.GetLightIndices();
+    if(light_clusters_texture_id_ == 0) {
+        glGenTextures(1, &light_clusters_texture_id_);
+        gl_state_.bindTexture(params_->light_clusters_slot_number, light_clusters_texture_id_, GL_TEXTURE_3D);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32UI,
+                     LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES, 0,
+                     GL_RG_INTEGER, GL_UNSIGNED_INT, lights.GetClusters().data());
+        stats.bytes_uploaded += lights.GetClusters().size() * sizeof(uint32_t);
+    } else if(!light_indices.empty() || has_clustered_lights_) {
+        // not when every cluster stays empty
+        gl_state_.activeTexture(params_->light_clusters_slot_number);
+        gl_state_.bindTexture(params_->light_clusters_slot_number, light_clusters_texture_id_, GL_TEXTURE_3D);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0,
+                        LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES,
+                        GL_RG_INTEGER, GL_UNSIGNED_INT, lights.GetClusters().data());
+        stats.bytes_uploaded += lights.GetClusters().size() * sizeof(uint32_t);
     }
+    has_clustered_lights_ = !light_indices.empty();
+
+    // the index list, in rows. The texture grows as needed, and always has a row to be complete.
+    const int row_length = LightClusters::INDEX_ROW_LENGTH;
+    const int rows = std::max(static_cast<int>((light_indices.size() + row_length - 1) / row_length), 1);
+    if(light_indices_texture_id_ == 0) {
+        glGenTextures(1, &light_indices_texture_id_);
+        gl_state_.bindTexture(params_->light_indices_slot_number, light_indices_texture_id_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    } else {
+        gl_state_.activeTexture(params_->light_indices_slot_number);
+        gl_state_.bindTexture(params_->light_indices_slot_number, light_indices_texture_id_);
+    }
+    if(rows > light_index_rows_) {
+        light_index_rows_ = std::max(rows, 2 * light_index_rows_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, row_length, light_index_rows_, 0,
+                     GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    const int full_rows = static_cast<int>(light_indices.size() / row_length);
+    const int last_row_length = static_cast<int>(light_indices.size() % row_length);
+    if(full_rows > 0) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, row_length, full_rows,
+                        GL_RED_INTEGER, GL_UNSIGNED_INT, light_indices.data());
+    }
+    if(last_row_length > 0) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, full_rows, last_row_length, 1,
+                        GL_RED_INTEGER, GL_UNSIGNED_INT, light_indices.data() + size_t(full_rows) * row_length);
+    }
+    stats.bytes_uploaded += light_indices.size() * sizeof(uint32_t);
+    stats.light_assignments += light_indices.size();
+}
+
+void Shader::drawList(
+        const DrawList& draw_list,
+        const glm::vec3& camera_position,
+        const LightClusters& lights,
+        RenderStats& stats) {
+
+    // the state cache only issues what differs from the previous batch, or the previous frame. The
+    // list is sorted by state, so neighbouring batches share most of it.
+    auto upload_vec3 = [this, &stats](GLint location, const glm::vec3& value) {
+        if(gl_state_.uniform3fv(location, value)) {
+            stats.bytes_uploaded += sizeof(glm::vec3);
+        }
+    };
+
+    // --camera, the same for every draw: written once into this frame's section of the block--
+    CameraUBO camera;
+    camera.view = camera_view_matrix_;
+    camera.projection = projection_matrix_;
+    camera.view_projection = projection_matrix_ * camera_view_matrix_;
+    camera.position = glm::vec4(camera_position, 1.0f);
+    const GLintptr camera_offset = camera_buffer_->upload(&camera, sizeof(camera));
+    gl_state_.bindBufferRange(params_->camera_block_binding_point_, camera_buffer_->getBufferId(),
+                              camera_offset, sizeof(camera));
+    stats.bytes_uploaded += sizeof(camera);
+
+    uploadLights(lights, stats);
+
+    const auto& items = draw_list.GetItems();
+    if(!items.empty()) {
+        // --stream the frame's per instance data, in draw order, into the instance buffer--
+        instance_data_.resize(items.size());
+        for(size_t i = 0; i < items.size(); ++i) {
+            if(items[i].mesh->_vertex_array_id == 0) {
+                useShader(*items[i].model, stats);
+            }
+            // the world matrix of the node drawing the mesh places it in the world. Normals need the
+            // inverse transpose, computed once per instance rather than per vertex.
+            const glm::mat4& model_matrix = *items[i].world_matrix;
+            instance_data_[i].model = model_matrix;
+            instance_data_[i].normal_matrix = glm::transpose(glm::inverse(glm::mat3(model_matrix)));
+        }
+        const size_t instance_bytes = instance_data_.size() * sizeof(InstanceData);
+        // leaves the instance buffer bound, for the instance attributes set up below
+        const GLintptr instance_offset = instance_buffer_->upload(instance_data_.data(), instance_bytes);
+        stats.bytes_uploaded += instance_bytes;
+
+        // --compact the indices of the meshlets left after culling into the index stream, in draw
+        // order and in each mesh's index type, 4-byte aligned per draw. It's uploaded with no vertex
+        // array bound: binding it would change a mesh's one.--
+        index_stream_data_.clear();
+        for(const auto& batch : draw_list.GetBatches()) {
+            const auto& item = items[batch.first];
+            if(item.meshlets == nullptr) {
+                continue;
+            }
+            index_stream_data_.resize((index_stream_data_.size() + 3) & ~size_t(3));
+            for(uint32_t i = 0; i < item.meshlet_count; ++i) {
+                const auto& meshlet = item.mesh->_meshlets[item.meshlets[i]];
+                AppendIndices(item.mesh->_indices, meshlet.first_index, meshlet.index_count,
+                              item.mesh->_index_type, item.mesh->_first_vertex, index_stream_data_);
+            }
+        }
+        GLintptr index_stream_offset = 0;
+        if(!index_stream_data_.empty()) {
+            gl_state_.bindVertexArray(0);
+            index_stream_offset = index_stream_->upload(index_stream_data_.data(), index_stream_data_.size());
+            stats.bytes_uploaded += index_stream_data_.size();
+        }
+        size_t index_stream_position = 0;
+
+        for(const auto& batch : draw_list.GetBatches()) {
+            const auto* mesh = items[batch.first].mesh;
+            // -- vertex attributes --
+            // the vertex array holds the gpu buffers and attribute layout, set up in uploadModel().
+            gl_state_.bindVertexArray(mesh->_vertex_array_id);
+            SetupInstanceAttributes(params_->model_idx_, params_->normal_matrix_idx_,
+                                    instance_offset + batch.first * sizeof(InstanceData));
+            // quantized positions need the mesh's dequantization
+            upload_vec3(params_->position_offset_idx_, mesh->_position_offset);
+            upload_vec3(params_->position_scale_idx_, mesh->_position_scale);
+            // --material: the submesh's block range in the material buffer, and its textures--
+            const auto& item = items[batch.first];
+            const auto& material = mesh->_submeshes[item.submesh].material;
+            gl_state_.bindBufferRange(params_->material_block_binding_point_, material_buffer_id_,
+                                      material._uniform_block_slot * material_block_stride_,
+                                      material_block_size_);
+            // the base color texture on unit 0, the normal texture on unit 1
+            gl_state_.bindTexture(0, material._pbr_base_color_texture._id);
+            gl_state_.bindTexture(1, material._normal_texture._id);
+
+            // --Draw the batch's instances as indexed triangles, from its submesh's range of the bound
+            // index buffer at its level of detail, within the mesh's range of it. Or its meshlets left, from the index stream.--
+            const size_t index_size = GetIndexSize(mesh->_index_type);
+            if(item.meshlets != nullptr) {
+                size_t index_count = 0;
+                for(uint32_t i = 0; i < item.meshlet_count; ++i) {
+                    index_count += mesh->_meshlets[item.meshlets[i]].index_count;
+                }
+                index_stream_position = (index_stream_position + 3) & ~size_t(3);
+                gl_state_.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_stream_->getBufferId());
+                glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(index_count), mesh->_index_type,
+                                        reinterpret_cast<const void*>(index_stream_offset + index_stream_position),
+                                        batch.count);
+                index_stream_position += index_count * index_size;
+                // the vertex array keeps its mesh's index buffer for the next frames' draws
+                gl_state_.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->_index_buffer_id);
+            } else {
+                size_t first_index = 0;
+                size_t index_count = 0;
+                mesh->GetLodRange(item.lod, item.submesh, first_index, index_count);
+                glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(index_count), mesh->_index_type,
+                                        reinterpret_cast<const void*>((mesh->_first_index + first_index) * index_size),
+                                        batch.count);
+            }
+            stats.draw_calls += 1;
+        }
+        gl_state_.bindVertexArray(0);
+    }
+
+    camera_buffer_->finishFrame();
+    instance_buffer_->finishFrame();
+    index_stream_->finishFrame();
+    light_buffer_->finishFrame();
+}
+
+void Shader::setViewport(int width, int height)
+{
+    viewport_width_ = std::max(width, 1);
+    viewport_height_ = std::max(height, 1);
 }
 
 void Shader::setCameraViewMatrix(const glm::mat4& camera_view_matrix)
@@ -1,11 +1,17 @@
 #ifndef ANDROIDGLINVESTIGATIONS_SHADER_H
 #define ANDROIDGLINVESTIGATIONS_SHADER_H
 
+#include "DrawList.h"
+#include "GLStateCache.h"
+#include "LightClusters.h"
+#include "RenderStats.h"
 #include "Utility.h"
 #include "scene/SceneLight.h"
 
+#include <map>
 #include <string>
 #include <memory>
+#include <tuple>
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <vector>
@@ -13,7 +19,12 @@
 #include <GLES3/gl3.h>
 
 
+class GeometryPool;
 class Model;
+struct Material;
+struct Texture;
+class StreamBuffer;
+enum class VertexLayout : int;
 
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
@@ -24,6 +35,16 @@ class Model;
  */
 class Shader {
 public:
+    // a shared image's cache key, and the wrap s, wrap t, min filter and mag filter of its sampler
+    using SharedTextureKey = std::tuple<uint64_t, GLint, GLint, GLint, GLint>;
+
+    // the per instance vertex attributes, streamed every frame
+    struct InstanceData {
+        glm::mat4 model;
+        // the inverse transpose of the model matrix's upper 3x3, which transforms normals
+        glm::mat3 normal_matrix;
+    };
+
     /*!
      * Loads a shader given the full sourcecode and names for necessary attributes and uniforms to
      * link to. Returns a valid shader on success or null on failure. Shader resources are
@@ -34,9 +55,11 @@ public:
      * @param positionAttributeName The name of the position attribute in your vertex program
      * @param uvAttributeName The name of the uv coordinate attribute in your vertex program
      * @param projectionMatrixUniformName The name of your model/view/projection matrix uniform
+     * @param gl_state the state cache of the GL context, all the shader's state changes go through it.
+     *                 It must outlive the shader.
      * @return a valid Shader on success, otherwise null.
      */
-    static Shader *loadShader();
+    static Shader *loadShader(GLStateCache& gl_state);
 
     ~Shader();
 
@@ -51,10 +74,37 @@ public:
     void deactivate() const;
 
     /*!
-     * Renders a single model
-     * @param model a model to render
+     * Creates the gpu resources of a model: material blocks, textures, and per mesh a vertex buffer,
+     * an index buffer and a vertex array object, or ranges of shared ones with geometry merging
+     * enabled. Resources that already exist are left as they are, so this can be
+     * called again for models sharing meshes. Textures sharing an image (see TextureCache) share a
+     * gl texture, and the cpu copies of the pixels are released once uploaded.
+     * @param model the model to upload
+     * @return the number of bytes uploaded
+     */
+    size_t uploadModel(Model& model);
+
+    /*!
+     * Deletes the gpu resources created by @a uploadModel. The GL context must still be current.
+     * @param model the model to release
      */
-    void drawModel(Model& model, const glm::vec3& camera_position, const std::vector<SceneLight>& lights);
+    void releaseModel(Model& model);
+
+    /*!
+     * Submits a frame's draws, in the list's order: one instanced draw call per batch, with the
+     * model and normal matrices streamed through an instance buffer, and the camera and lights
+     * through uniform blocks. The clustered lights' lists go in integer textures. A batch's material
+     * costs a range bind of its block. Meshes without gpu resources yet get them created on the way.
+     * Draws of culled meshlets draw the indices of those left, compacted into an index stream
+     * buffer. The state cache drops the state a batch shares with the previous one, so a list
+     * sorted by state costs a few binds per distinct material and mesh.
+     * @param stats the frame counters to update with the GL work issued
+     */
+    void drawList(
+            const DrawList& draw_list,
+            const glm::vec3& camera_position,
+            const LightClusters& lights,
+            RenderStats& stats);
 
     /*!
      * Sets the camera view matrix in the shader.
@@ -68,6 +118,18 @@ public:
      */
     void setProjectionMatrix(const glm::mat4& projection_matrix);
 
+    /*!
+     * Sets the size of the render area, which fragments find their light cluster with.
+     */
+    void setViewport(int width, int height);
+
+    /*!
+     * Enables or disables packing the meshes uploaded from then on into shared vertex and index
+     * buffers (see GeometryPool), so draws of meshes with the same vertex layout share a vertex
+     * array. Meshes too large for them keep their own. Disabled by default.
+     */
+    void setGeometryMerging(bool enabled) { geometry_merging_ = enabled; }
+
 
 private:
 
@@ -78,7 +140,7 @@ private:
      * @param uv the attribute location of the uv coordinates
      * @param projectionMatrix the uniform location of the projection matrix
      */
-    Shader(GLuint program_id);
+    Shader(GLuint program_id, GLStateCache& gl_state);
 
     /*!
      * Helper function to load a shader of a given type
@@ -88,12 +150,101 @@ private:
      */
     static GLuint loadShader(GLenum shaderType, const std::string &shaderSource);
 
+    /*!
+     * Fetches the shader's attribute and uniform locations, if we haven't done so already.
+     */
+    void loadParameterLocations();
+
     /*!
      * Creates all gpu shader resources for the given model, before rendering.
      */
-    void useShader(Model& model);
+    void useShader(Model& model, RenderStats& stats);
+
+    /*!
+     * Sets up the attributes of the bound vertex array for an interleaved vertex layout, from the
+     * bound vertex buffer.
+     */
+    void setupPackedAttributes(VertexLayout layout);
+
+    /*!
+     * Sets up the per instance attributes of the bound vertex array, from the instance buffer.
+     */
+    void setupInstanceAttributes();
+
+    /*!
+     * Sets up the attributes of a GeometryPool page's vertex array, from the bound vertex buffer
+     * with room for vertex_capacity vertices, and the instance attributes.
+     */
+    void setupMergedAttributes(VertexLayout layout, size_t vertex_capacity);
+
+    /*!
+     * Uploads the lights block, if a light changed, and the light clusters.
+     */
+    void uploadLights(const LightClusters& lights, RenderStats& stats);
+
+    /*!
+     * Writes a material's block into a free slot of the material buffer, growing it as needed.
+     * @return the number of bytes uploaded
+     */
+    size_t uploadMaterial(Material& material);
+
+    /*!
+     * Creates a texture's gl texture, or takes a reference to the one of a texture sharing its image
+     * and sampler.
+     * @return the number of bytes uploaded
+     */
+    size_t uploadTexture(Texture& texture, const std::string& sampler_name, int slot_number);
+
+    /*!
+     * Drops a texture's reference to its gl texture, deleting it with the last one.
+     */
+    void releaseTexture(Texture& texture);
 
     GLuint program_id_ = -1;
+    GLStateCache& gl_state_;
+
+    // the camera block, and the per instance data of the frame's draws in draw order. Written once
+    // per frame, into ring buffers the gpu may still be reading the previous frames from.
+    std::unique_ptr<StreamBuffer> camera_buffer_;
+    std::unique_ptr<StreamBuffer> instance_buffer_;
+    std::vector<InstanceData> instance_data_;
+    // the indices of the meshlets left after culling, compacted per draw in its mesh's index type
+    std::unique_ptr<StreamBuffer> index_stream_;
+    std::vector<u_char> index_stream_data_;
+
+    // the light block last uploaded, and the light cluster textures
+    struct LightsUBO;
+    std::unique_ptr<StreamBuffer> light_buffer_;
+    std::unique_ptr<LightsUBO> lights_ubo_;
+    bool has_lights_ = false;
+    bool has_clustered_lights_ = false;
+    GLuint light_clusters_texture_id_ = 0;
+    GLuint light_indices_texture_id_ = 0;
+    int light_index_rows_ = 0;
+    int viewport_width_ = 1;
+    int viewport_height_ = 1;
+
+    // every uploaded material's block, in slots of material_block_stride_ bytes. Written once, when
+    // the material is uploaded. Released slots are reused.
+    GLuint material_buffer_id_ = 0;
+    GLsizeiptr material_block_size_ = 0;
+    GLsizeiptr material_block_stride_ = 0;
+    int material_slot_capacity_ = 0;
+    int material_slot_count_ = 0;
+    std::vector<int> free_material_slots_;
+
+    // the gl textures of textures sharing an image, and how many textures use each
+    struct SharedTexture {
+        GLuint texture_id = 0;
+        int references = 0;
+    };
+    std::map<SharedTextureKey, SharedTexture> shared_textures_;
+
+    // the shared vertex and index buffers of merged meshes, created with the first one
+    bool geometry_merging_ = false;
+    std::unique_ptr<GeometryPool> geometry_pool_;
+    // the next ModelMesh::_sort_id handed out
+    uint32_t next_mesh_sort_id_ = 0;
 
     struct ShaderParametersDefinition;
     ShaderParametersDefinition* params_ = nullptr;
@@ -0,0 +1,84 @@
+#ifndef MY_MOBILE_APP_SHAREDARRAY_H
+#define MY_MOBILE_APP_SHAREDARRAY_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*!
+ * A read-only array of T that either owns its elements, or references them inside some shared
+ * storage (e.g. a loaded glTF buffer or a memory-mapped file) kept alive by a shared_ptr.
+ *
+ * Referencing the storage avoids copying the data out of it. Reads never copy; writes go through
+ * @a Edit(), which first copies referenced elements into an owned vector.
+ */
+template<typename T>
+class SharedArray
+{
+public:
+    SharedArray() = default;
+
+    // takes ownership of the elements
+    SharedArray(std::vector<T> values) : _owned(std::move(values)) {}
+
+    /*!
+     * Creates an array referencing count elements at data, inside storage.
+     * @param storage whatever owns the memory at data, kept alive as long as this array references it
+     */
+    static SharedArray View(std::shared_ptr<const void> storage, const T* data, size_t count) {
+        SharedArray array;
+        array._storage = std::move(storage);
+        array._view = data;
+        array._view_count = count;
+        return array;
+    }
+
+    // true if the elements live in shared storage rather than in this array
+    inline bool IsView() const { return _view != nullptr; }
+
+    inline size_t size() const { return IsView() ? _view_count : _owned.size(); }
+    inline bool empty() const { return size() == 0; }
+    inline const T* data() const { return IsView() ? _view : _owned.data(); }
+    inline const T* begin() const { return data(); }
+    inline const T* end() const { return data() + size(); }
+
+    inline const T& operator[](size_t i) const { return data()[i]; }
+    inline const T& at(size_t i) const {
+        assert(i < size());
+        return data()[i];
+    }
+
+    /*!
+     * @return the elements for writing. Referenced elements are copied into an owned vector first.
+     */
+    std::vector<T>& Edit() {
+        if(IsView()) {
+            _owned.assign(_view, _view + _view_count);
+            _view = nullptr;
+            _view_count = 0;
+            _storage.reset();
+        }
+        return _owned;
+    }
+
+    /*!
+     * Moves owned elements into shared storage, so that copies of the array reference them rather
+     * than copying them.
+     */
+    void Share() {
+        if(!IsView() && !_owned.empty()) {
+            auto storage = std::make_shared<const std::vector<T>>(std::move(_owned));
+            *this = View(storage, storage->data(), storage->size());
+        }
+    }
+
+private:
+    std::vector<T> _owned;
+    std::shared_ptr<const void> _storage;
+    const T* _view = nullptr;
+    size_t _view_count = 0;
+};
+
+#endif //MY_MOBILE_APP_SHAREDARRAY_H
@@ -0,0 +1,79 @@
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+StreamBuffer::StreamBuffer(GLStateCache& gl_state, GLenum target)
+: gl_state_(gl_state)
+, target_(target)
+{
+    glGenBuffers(1, &buffer_id_);
+    if(target_ == GL_UNIFORM_BUFFER) {
+        // uniform block ranges must start at a multiple of it
+        GLint alignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment_ = static_cast<size_t>(std::max(alignment, 1));
+    }
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    deleteFences();
+    if(buffer_id_ != 0) {
+        gl_state_.deleteBuffer(buffer_id_);
+        buffer_id_ = 0;
+    }
+}
+
+void StreamBuffer::deleteFences()
+{
+    for(auto& fence : fences_) {
+        if(fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
+
+GLintptr StreamBuffer::upload(const void* data, size_t size)
+{
+    section_ = (section_ + 1) % FRAME_COUNT;
+    gl_state_.bindBuffer(target_, buffer_id_);
+
+    if(size > section_size_) {
+        // a new store: the gpu keeps reading the old one until it's done with it
+        section_size_ = std::max(size, 2 * section_size_);
+        section_size_ = (section_size_ + alignment_ - 1) / alignment_ * alignment_;
+        deleteFences();
+        glBufferData(target_, static_cast<GLsizeiptr>(section_size_ * FRAME_COUNT), nullptr, GL_STREAM_DRAW);
+    } else if(fences_[section_] != nullptr) {
+        // only waits when the cpu is a whole ring of frames ahead of the gpu
+        while(glClientWaitSync(fences_[section_], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(fences_[section_]);
+        fences_[section_] = nullptr;
+    }
+
+    const auto offset = static_cast<GLintptr>(section_ * section_size_);
+    if(size == 0) {
+        return offset;
+    }
+    // unsynchronized: the fence already guarantees the gpu is done with the section
+    void* mapped = glMapBufferRange(target_, offset, static_cast<GLsizeiptr>(size),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(mapped != nullptr) {
+        memcpy(mapped, data, size);
+        glUnmapBuffer(target_);
+    } else {
+        glBufferSubData(target_, offset, static_cast<GLsizeiptr>(size), data);
+    }
+    return offset;
+}
+
+void StreamBuffer::finishFrame()
+{
+    if(fences_[section_] != nullptr) {
+        glDeleteSync(fences_[section_]);
+    }
+    fences_[section_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,58 @@
+#ifndef MY_MOBILE_APP_STREAMBUFFER_H
+#define MY_MOBILE_APP_STREAMBUFFER_H
+
+#include <GLES3/gl3.h>
+
+#include "GLStateCache.h"
+
+#include <cstddef>
+
+/*!
+ * A GL buffer whose data is rewritten every frame, e.g. the camera uniforms or the instance data.
+ *
+ * It's a ring of FRAME_COUNT sections: each frame writes the next section, while the gpu may still
+ * be reading the previous frames' ones. A fence per section makes the cpu wait in the rare case it
+ * laps the gpu, so writes never stall on the driver otherwise.
+ */
+class StreamBuffer
+{
+public:
+    static constexpr int FRAME_COUNT = 3;
+
+    /*!
+     * @param target the buffer's binding target, e.g. GL_ARRAY_BUFFER or GL_UNIFORM_BUFFER
+     */
+    StreamBuffer(GLStateCache& gl_state, GLenum target);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    /*!
+     * Writes the frame's data into the next section, and leaves the buffer bound to its target.
+     * Once per frame: the sections grow when the data doesn't fit, dropping the previous data.
+     * @return the offset of the data in the buffer
+     */
+    GLintptr upload(const void* data, size_t size);
+
+    /*!
+     * Marks the end of the gpu commands reading the current section, after the frame's draws.
+     */
+    void finishFrame();
+
+    inline GLuint getBufferId() const { return buffer_id_; }
+
+private:
+    void deleteFences();
+
+    GLStateCache& gl_state_;
+    GLenum target_;
+    GLuint buffer_id_ = 0;
+    // bytes per section, a multiple of the target's offset alignment
+    size_t section_size_ = 0;
+    size_t alignment_ = 1;
+    int section_ = FRAME_COUNT - 1;
+    GLsync fences_[FRAME_COUNT] = {};
+};
+
+#endif //MY_MOBILE_APP_STREAMBUFFER_H
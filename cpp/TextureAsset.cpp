@@ -1,8 +1,13 @@
-#include <android/imagedecoder.h>
 #include "TextureAsset.h"
 #include "AndroidOut.h"
 #include "Utility.h"
 
+#include <GLES2/gl2ext.h>
+#include <algorithm>
+
+#ifdef __ANDROID__
+#include <android/imagedecoder.h>
+
 std::shared_ptr<TextureAsset>
 TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPath) {
     // Get the image from asset manager
@@ -48,24 +53,33 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
     // Create a shared pointer so it can be cleaned up easily/automatically
     return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
 }
+#endif
 
 GLuint TextureAsset::uploadTexture(
+        GLStateCache& gl_state,
         GLuint shader_program_id,
         const std::string& sampler_uniform_name,
         int gl_texture_slot_number,
-        u_char* image_buffer,
+        const u_char* image_buffer,
         int width,
         int height,
+        int mip_levels,
         int sampler_wrapS,
         int sampler_wrapT,
         int sampler_min_filter,
-        int sampler_mag_filter)
+        int sampler_mag_filter,
+        GLenum compressed_format)
 {
     // Get an opengl texture
-    glActiveTexture(GL_TEXTURE0 + gl_texture_slot_number);
     GLuint textureId;
     glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    gl_state.bindTexture(gl_texture_slot_number, textureId);
+
+    // textures without a sampler (-1) get the glTF defaults: repeat, and trilinear filtering
+    if (sampler_wrapS < 0) sampler_wrapS = GL_REPEAT;
+    if (sampler_wrapT < 0) sampler_wrapT = GL_REPEAT;
+    if (sampler_min_filter < 0) sampler_min_filter = GL_LINEAR_MIPMAP_LINEAR;
+    if (sampler_mag_filter < 0) sampler_mag_filter = GL_LINEAR;
 
     // Clamp to the edge, you'll get odd results alpha blending if you don't
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler_wrapS);
@@ -74,29 +88,121 @@ GLuint TextureAsset::uploadTexture(
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler_min_filter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler_mag_filter);
 
-    // Load the texture into VRAM
-    glTexImage2D(
-            GL_TEXTURE_2D, // target
-            0, // mip level
-            GL_RGBA, // internal format, often advisable to use BGR
-            width, // width of the texture
-            height, // height of the texture
-            0, // border (always 0)
-            GL_RGBA, // format
-            GL_UNSIGNED_BYTE, // type
-            image_buffer // Data to upload
-    );
+    // Load the texture into VRAM, one mip level at a time
+    for(int level = 0; level < std::max(mip_levels, 1) && compressed_format != 0; ++level) {
+        // compressed blocks are uploaded as they are, the gpu samples them directly
+        const auto level_size = static_cast<GLsizei>(getLevelSize(compressed_format, width, height, 0));
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, compressed_format, width, height, 0, level_size, image_buffer);
+        if(image_buffer != nullptr) {
+            image_buffer += level_size;
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    for(int level = 0; level < std::max(mip_levels, 1) && compressed_format == 0; ++level) {
+        glTexImage2D(
+                GL_TEXTURE_2D, // target
+                level, // mip level
+                GL_RGBA, // internal format, often advisable to use BGR
+                width, // width of the texture
+                height, // height of the texture
+                0, // border (always 0)
+                GL_RGBA, // format
+                GL_UNSIGNED_BYTE, // type
+                image_buffer // Data to upload
+        );
+        if(image_buffer != nullptr) {
+            image_buffer += static_cast<size_t>(width) * height * 4;
+        }
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
 
     int loc = glGetUniformLocation(shader_program_id, sampler_uniform_name.c_str());
     if( loc >= 0 )
-        glUniform1i(loc, gl_texture_slot_number);
-
-    // generate mip levels. Not really needed for 2D, but good to do
-    glGenerateMipmap(GL_TEXTURE_2D);
+        gl_state.uniform1i(loc, gl_texture_slot_number);
+
+    // generate mip levels, unless they were provided. Not really needed for 2D, but good to do
+    if(compressed_format == 0 && mip_levels <= 1) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else {
+        // a provided chain, which may be partial (KTX2 allows it), is sampled up to its last level:
+        // the texture would be incomplete otherwise, and sample black. Compressed levels can't be
+        // generated.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, std::max(mip_levels, 1) - 1);
+    }
 
     return textureId;
 }
 
+std::vector<GLenum> TextureAsset::getCompressedTextureFormats()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+    std::vector<GLint> formats(std::max(count, 0));
+    if(!formats.empty()) {
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+    }
+    return std::vector<GLenum>(formats.begin(), formats.end());
+}
+
+bool TextureAsset::getCompressedBlockSize(GLenum compressed_format, int& block_width, int& block_height, int& block_bytes)
+{
+    // the ASTC formats, in GL's order, 16 bytes per block
+    static const int kAstcBlocks[][2] = {
+            {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+            {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+    static const int kAstcFormatCount = sizeof(kAstcBlocks) / sizeof(kAstcBlocks[0]);
+
+    switch(compressed_format) {
+        case GL_COMPRESSED_R11_EAC:
+        case GL_COMPRESSED_SIGNED_R11_EAC:
+        case GL_COMPRESSED_RGB8_ETC2:
+        case GL_COMPRESSED_SRGB8_ETC2:
+        case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+            block_width = 4;
+            block_height = 4;
+            block_bytes = 8;
+            return true;
+        case GL_COMPRESSED_RG11_EAC:
+        case GL_COMPRESSED_SIGNED_RG11_EAC:
+        case GL_COMPRESSED_RGBA8_ETC2_EAC:
+        case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+            block_width = 4;
+            block_height = 4;
+            block_bytes = 16;
+            return true;
+        default:
+            break;
+    }
+    for(GLenum first : {GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR}) {
+        if(compressed_format >= first && compressed_format < first + kAstcFormatCount) {
+            block_width = kAstcBlocks[compressed_format - first][0];
+            block_height = kAstcBlocks[compressed_format - first][1];
+            block_bytes = 16;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TextureAsset::getLevelSize(GLenum compressed_format, int width, int height, int level)
+{
+    const size_t level_width = std::max(width >> level, 1);
+    const size_t level_height = std::max(height >> level, 1);
+    if(compressed_format == 0) {
+        return level_width * level_height * 4;
+    }
+    int block_width = 0;
+    int block_height = 0;
+    int block_bytes = 0;
+    if(!getCompressedBlockSize(compressed_format, block_width, block_height, block_bytes)) {
+        return 0;
+    }
+    return (level_width + block_width - 1) / block_width * ((level_height + block_height - 1) / block_height) * block_bytes;
+}
+
 TextureAsset::~TextureAsset() {
     // return texture resources
     glDeleteTextures(1, &textureID_);
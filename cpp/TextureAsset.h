@@ -2,13 +2,18 @@
 #define ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
 
 #include <memory>
+#ifdef __ANDROID__
 #include <android/asset_manager.h>
+#endif
 #include <GLES3/gl3.h>
 #include <string>
 #include <vector>
 
+#include "GLStateCache.h"
+
 class TextureAsset {
 public:
+#ifdef __ANDROID__
     /*!
      * Loads a texture asset from the assets/ directory
      * @param assetManager Asset manager to use
@@ -17,18 +22,48 @@ public:
      */
     static std::shared_ptr<TextureAsset>
     loadAsset(AAssetManager *assetManager, const std::string &assetPath);
+#endif
 
+    /*!
+     * Creates a texture from RGBA8 pixels, or from compressed blocks.
+     * @param image_buffer mip_levels levels, largest first, each half the size of the previous one.
+     *                     If an RGBA8 image only holds one level, the rest are generated by the
+     *                     driver. Compressed images are only sampled from the levels provided.
+     * @param gl_state the context's state cache. The texture is left bound to its slot, and the
+     *                 shader program in use gets its sampler uniform set.
+     * @param compressed_format 0 for RGBA8 pixels, otherwise an ETC2/EAC or ASTC format
+     */
     static GLuint uploadTexture(
+            GLStateCache& gl_state,
             GLuint shader_program_id,
             const std::string& sampler_uniform_name,
             int gl_texture_slot_number, // 0,1,2,... = GL_TEXTURE<gl_texture_index>
-            u_char* image_buffer,
+            const u_char* image_buffer,
             int width,
             int height,
+            int mip_levels,
             int sampler_wrapS,
             int sampler_wrapT,
             int sampler_min_filter,
-            int sampler_mag_filter);
+            int sampler_mag_filter,
+            GLenum compressed_format = 0);
+
+    /*!
+     * @return the compressed texture formats the current context accepts
+     */
+    static std::vector<GLenum> getCompressedTextureFormats();
+
+    /*!
+     * Gets the block dimensions of an ETC2/EAC or ASTC compressed format.
+     * @return false if the format isn't one of them
+     */
+    static bool getCompressedBlockSize(GLenum compressed_format, int& block_width, int& block_height, int& block_bytes);
+
+    /*!
+     * @return the size in bytes of a mip level of an image, of RGBA8 pixels if compressed_format is
+     * 0. 0 for an unknown compressed format.
+     */
+    static size_t getLevelSize(GLenum compressed_format, int width, int height, int level);
 
     ~TextureAsset();
 
@@ -0,0 +1,45 @@
+#include "TextureCache.h"
+
+#include <iterator>
+
+TextureCache& TextureCache::GetShared()
+{
+    static TextureCache shared;
+    return shared;
+}
+
+uint64_t TextureCache::MakeKey(const void* encoded, size_t size)
+{
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    const auto* bytes = static_cast<const unsigned char*>(encoded);
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+std::shared_ptr<const TextureCache::Image> TextureCache::Find(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _images.find(key);
+    return it != _images.end() ? it->second.lock() : nullptr;
+}
+
+std::shared_ptr<const TextureCache::Image> TextureCache::Add(Image image)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& entry = _images[image.key];
+    if(auto added = entry.lock()) {
+        return added;
+    }
+    auto added = std::make_shared<const Image>(std::move(image));
+    entry = added;
+
+    // drop the entries of released images
+    for(auto it = _images.begin(); it != _images.end();) {
+        it = it->second.expired() ? _images.erase(it) : std::next(it);
+    }
+    return added;
+}
@@ -0,0 +1,59 @@
+#ifndef MY_MOBILE_APP_TEXTURECACHE_H
+#define MY_MOBILE_APP_TEXTURECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * The decoded images of every loaded model, keyed by the contents of their encoded file. Meshes and
+ * models referencing the same image, e.g. a shared atlas, share one decoded copy of its pixels.
+ *
+ * The cache only holds weak references: an image is released once no texture references its
+ * pixels anymore, e.g. once they're uploaded.
+ */
+class TextureCache
+{
+public:
+    // an image and its mip levels, largest first
+    struct Image
+    {
+        uint64_t key = 0;
+        int width = 0;
+        int height = 0;
+        int mip_levels = 1;
+        // 0 for RGBA8 pixels, otherwise the GL format of the compressed blocks (see TextureAsset)
+        uint32_t compressed_format = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    /*!
+     * @return the cache shared by the engine's loaders
+     */
+    static TextureCache& GetShared();
+
+    /*!
+     * @return the key of an encoded image (png, jpeg, ktx2...) file's contents, never 0
+     */
+    static uint64_t MakeKey(const void* encoded, size_t size);
+
+    /*!
+     * @return the image decoded from the file with this key, or null if none is alive
+     */
+    std::shared_ptr<const Image> Find(uint64_t key);
+
+    /*!
+     * Adds a decoded image, under its key. If another thread added one with the same key meanwhile,
+     * that one is kept, and returned.
+     */
+    std::shared_ptr<const Image> Add(Image image);
+
+private:
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<const Image>> _images;
+};
+
+#endif //MY_MOBILE_APP_TEXTURECACHE_H
@@ -40,7 +40,9 @@ typedef uint16_t Index;
 typedef float Matrix4x4[4][4];
 */
 
-typedef uint16_t Index;
+// a vertex index, as processed on the cpu side. Meshes store theirs 16-bit when their vertices
+// allow, see IndexArray.
+typedef uint32_t Index;
 
 class Utility {
 public:
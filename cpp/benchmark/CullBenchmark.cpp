@@ -0,0 +1,172 @@
+/*!
+ * Microbenchmark of the frustum culling kernel.
+ *
+ * Culls sets of random bounding spheres scattered around a camera with FrustumCuller::CullSpheres()
+ * and with its scalar reference, checks both find the same visible spheres, and reports the best
+ * time per call of each as JSON. Exits with a non-zero status if the results differ.
+ *
+ * usage: cull_benchmark [--counts <n,n,...>] [--iterations <n>] [--output <file.json>]
+ */
+#include "scene/FrustumCuller.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchmarkOptions {
+    std::vector<int> counts = {1000, 10000, 100000};
+    int iterations = 200;
+    std::string output_path;
+};
+
+struct CountResult {
+    int count = 0;
+    size_t visible = 0;
+    double scalar_us = 0.0;
+    double simd_us = 0.0;
+    bool matches = true;
+};
+
+bool ParseOptions(int argc, char** argv, BenchmarkOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            return (i + 1 < argc) ? argv[++i] : nullptr;
+        };
+        const char* value = nullptr;
+        if (arg == "--counts" && (value = next())) {
+            options.counts.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) {
+                    options.counts.push_back(std::max(0, atoi(item.c_str())));
+                }
+            }
+        } else if (arg == "--iterations" && (value = next())) {
+            options.iterations = std::max(1, atoi(value));
+        } else if (arg == "--output" && (value = next())) {
+            options.output_path = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * Spheres scattered in a cube around the camera, so that roughly a tenth of them are visible.
+ */
+BoundingSphereArray CreateSpheres(int count) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+    BoundingSphereArray spheres;
+    for (int i = 0; i < count; ++i) {
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(position(random), position(random), position(random));
+        sphere.radius = radius(random);
+        spheres.push_back(sphere);
+    }
+    return spheres;
+}
+
+/*!
+ * @return the best time of the given number of calls, in microseconds
+ */
+template<typename F>
+double BestTime(int iterations, F cull) {
+    double best_us = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        cull();
+        auto end = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count();
+        best_us = (i == 0) ? us : std::min(best_us, us);
+    }
+    return best_us;
+}
+
+std::string ToJson(const BenchmarkOptions& options, const std::vector<CountResult>& results) {
+    std::ostringstream json;
+    json.precision(3);
+    json << std::fixed;
+    json << "{\n";
+    json << "  \"instruction_set\": \"" << FrustumCuller::GetInstructionSet() << "\",\n";
+    json << "  \"iterations\": " << options.iterations << ",\n";
+    json << "  \"counts\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        json << "    {\n";
+        json << "      \"count\": " << result.count << ",\n";
+        json << "      \"visible\": " << result.visible << ",\n";
+        json << "      \"scalar_us\": " << result.scalar_us << ",\n";
+        json << "      \"simd_us\": " << result.simd_us << ",\n";
+        json << "      \"speedup\": " << (result.simd_us > 0.0 ? result.scalar_us / result.simd_us : 0.0) << ",\n";
+        json << "      \"matches\": " << (result.matches ? "true" : "false") << "\n";
+        json << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+    return json.str();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--counts <n,n,...>] [--iterations <n>] [--output <file.json>]" << std::endl;
+        return 2;
+    }
+
+    // a 60 degree camera at the origin, looking down -z
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const Frustum frustum(projection * view);
+
+    std::vector<CountResult> results;
+    bool all_match = true;
+    for (int count : options.counts) {
+        const auto spheres = CreateSpheres(count);
+        std::vector<uint32_t> scalar_visible;
+        std::vector<uint32_t> simd_visible;
+
+        CountResult result;
+        result.count = count;
+        result.scalar_us = BestTime(options.iterations, [&]() {
+            FrustumCuller::CullSpheresScalar(frustum, spheres, scalar_visible);
+        });
+        result.simd_us = BestTime(options.iterations, [&]() {
+            FrustumCuller::CullSpheres(frustum, spheres, simd_visible);
+        });
+        result.visible = simd_visible.size();
+        result.matches = scalar_visible == simd_visible;
+        all_match = all_match && result.matches;
+        results.push_back(result);
+    }
+
+    const std::string json = ToJson(options, results);
+    if (options.output_path.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.output_path) << json;
+    }
+
+    if (!all_match) {
+        std::cerr << "the vectorized and scalar culling results differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,584 @@
+/*!
+ * Frame-time benchmark for the host (offscreen) build of the renderer.
+ *
+ * Loads the bundled glTF scenes plus synthetic N-instance stress scenes, renders a fixed number of
+ * frames into an offscreen pbuffer and reports CPU frame time percentiles along with the renderer's
+ * per-frame counters as JSON. When given a baseline JSON from an earlier run, it exits with a
+ * non-zero status if any scene's frame time regressed by more than the given threshold.
+ *
+ * usage: renderer_benchmark [--assets <dir>] [--frames <n>] [--warmup <n>] [--size <w>x<h>]
+ *                           [--instances <n,n,...>] [--vertex-layout separate|packed|quantized]
+ *                           [--reference-buffers] [--cache-dir <dir>] [--transform-system] [--animate]
+ *                           [--zoom <factor>] [--no-culling] [--workers <n>] [--lights <n>]
+ *                           [--compressed-textures] [--lod-errors <e,e,...>] [--lod-pixel-error <px>]
+ *                           [--no-mesh-optimization] [--meshlets] [--no-meshlet-culling]
+ *                           [--merge-geometry] [--output <file.json>]
+ *                           [--baseline <file.json>] [--threshold <percent>] [--metric p50|p95|p99]
+ */
+#include "Renderer.h"
+#include "MeshModelBuilder.h"
+#include "MeshOptimizer.h"
+#include "TextureAsset.h"
+#include "scene/PerspectiveCamera.h"
+
+#include <GLES3/gl3.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct BenchmarkOptions {
+    std::string assets_dir = ".";
+    int frames = 300;
+    int warmup_frames = 30;
+    int width = 1280;
+    int height = 720;
+    std::vector<int> instance_counts = {100, 1000};
+    // store the stress scenes' transforms in a TransformSystem
+    bool transform_system = false;
+    // move every stress scene instance each frame
+    bool animate = false;
+    // moves the camera this many times closer to the scene than the default framing, so that part of
+    // the scene falls outside the view
+    float zoom = 1.0f;
+    bool frustum_culling = true;
+    // worker threads building the draw list: 0 for the render thread alone, -1 for the engine's
+    // shared job system (one per core besides the render thread)
+    int workers = -1;
+    // point lights with a range spread over the scene, lighting it besides the main light
+    int point_lights = 0;
+    // load the images converted to KTX2 by texture_converter, in the formats the gpu samples
+    bool compressed_textures = false;
+    // how many pixels a level of detail may be off on screen, see Renderer::setLodPixelError()
+    float lod_pixel_error = 1.0f;
+    // cull the meshlets of the meshes loaded with MeshLoadOptions::build_meshlets
+    bool meshlet_culling = true;
+    // pack the scenes' meshes into shared vertex and index buffers, see Renderer::setGeometryMerging()
+    bool merge_geometry = false;
+    MeshLoadOptions load_options;
+    std::string output_path;
+    std::string baseline_path;
+    double threshold_percent = 10.0;
+    std::string metric = "p50";
+};
+
+struct SceneResult {
+    std::string name;
+    double load_ms = 0.0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    // the renderer's counters are identical every frame for these static scenes, so the last one is kept.
+    RenderStats stats;
+    // the post-transform vertex cache efficiency of the scene's distinct meshes, see MeshOptimizer
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+    long max_rss_kb = 0;
+};
+
+// the scenes loaded by createRenderObjects() in main.cpp
+const std::vector<std::string> kSceneFiles = {
+        "AntiqueCamera/AntiqueCamera.gltf",
+        "BarramundiFish/BarramundiFish.gltf",
+        "Avocado/Avocado.gltf",
+        "Cube/Cube.gltf"
+};
+
+bool ParseOptions(int argc, char** argv, BenchmarkOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            return (i + 1 < argc) ? argv[++i] : nullptr;
+        };
+        const char* value = nullptr;
+        if (arg == "--assets" && (value = next())) {
+            options.assets_dir = value;
+        } else if (arg == "--frames" && (value = next())) {
+            options.frames = std::max(1, atoi(value));
+        } else if (arg == "--warmup" && (value = next())) {
+            options.warmup_frames = std::max(0, atoi(value));
+        } else if (arg == "--size" && (value = next())) {
+            if (sscanf(value, "%dx%d", &options.width, &options.height) != 2) {
+                return false;
+            }
+        } else if (arg == "--instances" && (value = next())) {
+            options.instance_counts.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) {
+                    options.instance_counts.push_back(atoi(item.c_str()));
+                }
+            }
+        } else if (arg == "--vertex-layout" && (value = next())) {
+            std::string layout = value;
+            if (layout == "separate") {
+                options.load_options.vertex_layout = VertexLayout::Separate;
+            } else if (layout == "packed") {
+                options.load_options.vertex_layout = VertexLayout::Packed;
+            } else if (layout == "quantized") {
+                options.load_options.vertex_layout = VertexLayout::PackedQuantized;
+            } else {
+                return false;
+            }
+        } else if (arg == "--reference-buffers") {
+            options.load_options.reference_source_buffers = true;
+        } else if (arg == "--compressed-textures") {
+            options.compressed_textures = true;
+        } else if (arg == "--lod-errors" && (value = next())) {
+            options.load_options.lod_errors.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) {
+                    options.load_options.lod_errors.push_back(float(atof(item.c_str())));
+                }
+            }
+        } else if (arg == "--lod-pixel-error" && (value = next())) {
+            options.lod_pixel_error = std::max(0.0f, float(atof(value)));
+        } else if (arg == "--no-mesh-optimization") {
+            options.load_options.optimize_meshes = false;
+        } else if (arg == "--meshlets") {
+            options.load_options.build_meshlets = true;
+        } else if (arg == "--no-meshlet-culling") {
+            options.meshlet_culling = false;
+        } else if (arg == "--merge-geometry") {
+            options.merge_geometry = true;
+        } else if (arg == "--transform-system") {
+            options.transform_system = true;
+        } else if (arg == "--animate") {
+            options.animate = true;
+        } else if (arg == "--zoom" && (value = next())) {
+            options.zoom = float(atof(value));
+            if (options.zoom <= 0.0f) {
+                return false;
+            }
+        } else if (arg == "--no-culling") {
+            options.frustum_culling = false;
+        } else if (arg == "--workers" && (value = next())) {
+            options.workers = std::max(0, atoi(value));
+        } else if (arg == "--lights" && (value = next())) {
+            options.point_lights = std::max(0, atoi(value));
+        } else if (arg == "--cache-dir" && (value = next())) {
+            options.load_options.cache_directory = value;
+        } else if (arg == "--output" && (value = next())) {
+            options.output_path = value;
+        } else if (arg == "--baseline" && (value = next())) {
+            options.baseline_path = value;
+        } else if (arg == "--threshold" && (value = next())) {
+            options.threshold_percent = atof(value);
+        } else if (arg == "--metric" && (value = next())) {
+            options.metric = value;
+            if (options.metric != "p50" && options.metric != "p95" && options.metric != "p99") {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * Builds a uv-sphere mesh with a flat white material, used for the synthetic stress scenes.
+ */
+std::shared_ptr<ModelMesh> CreateSphereMesh(int rings, int segments, const MeshLoadOptions& load_options) {
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> tex_coords;
+    std::vector<Index> indices;
+    for (int ring = 0; ring <= rings; ++ring) {
+        float v = float(ring) / float(rings);
+        float phi = v * float(M_PI);
+        for (int segment = 0; segment <= segments; ++segment) {
+            float u = float(segment) / float(segments);
+            float theta = u * 2.0f * float(M_PI);
+            glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            vertices.push_back(normal * 0.5f);
+            normals.push_back(normal);
+            tex_coords.emplace_back(u, v);
+        }
+    }
+    for (int ring = 0; ring < rings; ++ring) {
+        for (int segment = 0; segment < segments; ++segment) {
+            Index i0 = ring * (segments + 1) + segment;
+            Index i1 = i0 + segments + 1;
+            indices.insert(indices.end(), {i0, Index(i0 + 1), i1, i1, Index(i0 + 1), Index(i1 + 1)});
+        }
+    }
+    auto mesh = std::make_shared<ModelMesh>();
+    mesh->_vertices = std::move(vertices);
+    mesh->_normals = std::move(normals);
+    mesh->_tex_coords = std::move(tex_coords);
+    mesh->_indices = IndexArray(std::move(indices), mesh->_vertices.size());
+    Submesh submesh;
+    submesh.index_count = static_cast<uint32_t>(mesh->_indices.size());
+    mesh->_submeshes.push_back(std::move(submesh));
+    mesh->ComputeBounds();
+    mesh->ComputeTangentSpace();
+    if (load_options.optimize_meshes) {
+        mesh->Optimize();
+    }
+    if (load_options.build_meshlets) {
+        mesh->BuildMeshlets();
+    }
+    mesh->GenerateLods(load_options.lod_errors);
+    mesh->PackVertices(load_options.vertex_layout);
+
+    // 1x1 textures: white base color, and a normal map pointing straight out of the surface.
+    auto init_texture = [](Texture& texture, std::vector<u_char> pixel) {
+        texture._image_data = std::move(pixel);
+        texture._image_width = 1;
+        texture._image_height = 1;
+        texture._sampler_wrap_s = Sampler::WRAP_REPEAT;
+        texture._sampler_wrap_t = Sampler::WRAP_REPEAT;
+        texture._sampler_min_filter = Sampler::FILTER_LINEAR;
+        texture._sampler_mag_filter = Sampler::FILTER_LINEAR;
+    };
+    init_texture(mesh->_submeshes[0].material._pbr_base_color_texture, {255, 255, 255, 255});
+    init_texture(mesh->_submeshes[0].material._normal_texture, {128, 128, 255, 255});
+    return mesh;
+}
+
+std::unique_ptr<SceneGraph> CreateStressScene(int instance_count, const MeshLoadOptions& load_options, bool transform_system) {
+    auto scene = std::make_unique<SceneGraph>();
+    if (transform_system) {
+        scene->EnableTransformSystem();
+    }
+    auto sphere = CreateSphereMesh(16, 32, load_options);
+
+    // lay the instances out on a square grid, all of them sharing the same mesh.
+    int grid_size = std::max(1, int(std::ceil(std::sqrt(float(instance_count)))));
+    for (int i = 0; i < instance_count; ++i) {
+        auto model = std::make_unique<Model>();
+        model->AddMesh(sphere);
+        glm::vec3 position(float(i % grid_size) - 0.5f * float(grid_size - 1),
+                           float(i / grid_size) - 0.5f * float(grid_size - 1),
+                           0.0f);
+        model->GetTransform().SetLocalMatrix(glm::translate(glm::mat4(1.0f), position));
+
+        auto render_object = std::make_unique<RenderObject>();
+        render_object->ApplyMeshModel(std::move(model));
+        scene->AddRenderObject(render_object);
+    }
+    return scene;
+}
+
+/*!
+ * Bobs every stress scene instance along z, so every world matrix changes each frame.
+ */
+void AnimateStressScene(SceneGraph& scene, int frame) {
+    int i = 0;
+    for (const auto& render_object : scene.GetRenderObjects()) {
+        auto& transform = render_object->GetMeshModel()->GetTransform();
+        glm::vec3 position = transform.GetPosition();
+        position.z = 0.25f * std::sin(0.1f * float(frame) + float(i++));
+        transform.SetLocalMatrix(glm::translate(glm::mat4(1.0f), position));
+    }
+}
+
+/*!
+ * Places the camera and the light the same way createRenderObjects() does in main.cpp, and spreads
+ * point_lights lights with a range over the scene, on a spiral just in front of it.
+ */
+void SetupCameraAndLights(SceneGraph& scene, int width, int height, float zoom, int point_lights) {
+    glm::vec3 scene_center;
+    float scene_radius = 0.f;
+    scene.GetSceneBounds(scene_center, scene_radius);
+    auto camera_position = scene_center + glm::vec3(0.0f, 0.0f, scene_radius * 3.0f / zoom);
+
+    std::unique_ptr<CameraBaseNode> camera = std::make_unique<PerspectiveCamera>(
+            45.0f, width, height, 0.01f, std::max(500.0f, scene_radius * 6.0f));
+    camera->LookAt(camera_position, scene_center);
+    scene.AddCamera(camera);
+
+    SceneLight light;
+    light.light_type = LightType::PointLight;
+    light.light_position = glm::vec3(0.0, 0.0, scene_radius);
+    light.light_color = glm::vec3(1.0);
+    scene.AddLight(light);
+
+    // each light reaches about twice the spacing between them
+    const float light_range = 2.0f * scene_radius / std::sqrt(float(std::max(point_lights, 1)));
+    for (int i = 0; i < point_lights; ++i) {
+        const float distance = scene_radius * std::sqrt((float(i) + 0.5f) / float(point_lights));
+        const float angle = 2.39996f * float(i); // the golden angle, in radians
+        SceneLight point_light;
+        point_light.light_type = LightType::PointLight;
+        point_light.light_position = scene_center + glm::vec3(distance * std::cos(angle), distance * std::sin(angle), 0.5f);
+        point_light.light_range = light_range;
+        point_light.light_color = glm::vec3(0.5f + 0.5f * std::cos(angle),
+                                            0.5f + 0.5f * std::cos(angle + 2.0944f),
+                                            0.5f + 0.5f * std::cos(angle + 4.18879f));
+        scene.AddLight(point_light);
+    }
+}
+
+double Percentile(const std::vector<double>& sorted_values, double percentile) {
+    if (sorted_values.empty()) {
+        return 0.0;
+    }
+    auto rank = size_t(std::ceil(percentile / 100.0 * double(sorted_values.size())));
+    rank = std::min(std::max<size_t>(rank, 1), sorted_values.size());
+    return sorted_values[rank - 1];
+}
+
+long MaxResidentSetKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+SceneResult RunScene(Renderer& renderer,
+                     const std::string& name,
+                     std::unique_ptr<SceneGraph> scene,
+                     double load_ms,
+                     const BenchmarkOptions& options,
+                     const std::function<void(SceneGraph&, int)>& animate = nullptr) {
+    SceneResult result;
+    result.name = name;
+    result.load_ms = load_ms;
+
+    MeshOptimizer::VertexCacheStatistics vertex_cache;
+    std::unordered_set<const ModelMesh*> meshes;
+    for (const auto& render_object : scene->GetRenderObjects()) {
+        for (const auto& mesh : render_object->GetMeshModel()->GetMeshes()) {
+            if (meshes.insert(mesh.get()).second) {
+                const auto indices = mesh->_indices.ToVector();
+                vertex_cache.Add(MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), mesh->_vertices.size()));
+            }
+        }
+    }
+    result.acmr = vertex_cache.GetAcmr();
+    result.atvr = vertex_cache.GetAtvr();
+
+    SetupCameraAndLights(*scene, options.width, options.height, options.zoom, options.point_lights);
+    SceneGraph& current_scene = *scene;
+    renderer.ApplyCurrentScene(scene);
+
+    int frame = 0;
+    for (int i = 0; i < options.warmup_frames; ++i) {
+        if (animate) {
+            animate(current_scene, frame++);
+        }
+        renderer.render();
+        glFinish();
+    }
+
+    std::vector<double> frame_ms;
+    frame_ms.reserve(options.frames);
+    for (int i = 0; i < options.frames; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (animate) {
+            animate(current_scene, frame++);
+        }
+        renderer.render();
+        auto end = std::chrono::steady_clock::now();
+        frame_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        // keep the GPU from queueing up frames; this isn't part of the CPU frame time.
+        glFinish();
+    }
+    result.stats = renderer.GetFrameStats();
+
+    double total_ms = 0.0;
+    for (double ms : frame_ms) {
+        total_ms += ms;
+    }
+    result.mean_ms = total_ms / double(frame_ms.size());
+    std::sort(frame_ms.begin(), frame_ms.end());
+    result.p50_ms = Percentile(frame_ms, 50.0);
+    result.p95_ms = Percentile(frame_ms, 95.0);
+    result.p99_ms = Percentile(frame_ms, 99.0);
+    result.max_rss_kb = MaxResidentSetKb();
+    return result;
+}
+
+std::string ToJson(const BenchmarkOptions& options, const std::vector<SceneResult>& results) {
+    std::ostringstream json;
+    json.precision(6);
+    json << std::fixed;
+    json << "{\n";
+    json << "  \"renderer\": \"" << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "\",\n";
+    json << "  \"frames\": " << options.frames << ",\n";
+    json << "  \"width\": " << options.width << ",\n";
+    json << "  \"height\": " << options.height << ",\n";
+    json << "  \"workers\": " << (options.workers >= 0 ? options.workers : int(JobSystem::GetShared().GetWorkerCount())) << ",\n";
+    json << "  \"point_lights\": " << options.point_lights << ",\n";
+    json << "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        json << "    {\n";
+        json << "      \"name\": \"" << result.name << "\",\n";
+        json << "      \"load_ms\": " << result.load_ms << ",\n";
+        json << "      \"mean_ms\": " << result.mean_ms << ",\n";
+        json << "      \"p50_ms\": " << result.p50_ms << ",\n";
+        json << "      \"p95_ms\": " << result.p95_ms << ",\n";
+        json << "      \"p99_ms\": " << result.p99_ms << ",\n";
+        json << "      \"draw_calls\": " << result.stats.draw_calls << ",\n";
+        json << "      \"meshes_submitted\": " << result.stats.meshes_submitted << ",\n";
+        json << "      \"meshes_culled\": " << result.stats.meshes_culled << ",\n";
+        json << "      \"triangles_submitted\": " << result.stats.triangles_submitted << ",\n";
+        json << "      \"triangles_saved\": " << result.stats.triangles_saved << ",\n";
+        json << "      \"meshlets_culled\": " << result.stats.meshlets_culled << ",\n";
+        json << "      \"triangles_culled\": " << result.stats.triangles_culled << ",\n";
+        json << "      \"acmr\": " << result.acmr << ",\n";
+        json << "      \"atvr\": " << result.atvr << ",\n";
+        json << "      \"light_assignments\": " << result.stats.light_assignments << ",\n";
+        json << "      \"transforms_updated\": " << result.stats.transforms_updated << ",\n";
+        json << "      \"state_changes\": " << result.stats.state_changes << ",\n";
+        json << "      \"state_changes_filtered\": " << result.stats.state_changes_filtered << ",\n";
+        json << "      \"bytes_uploaded\": " << result.stats.bytes_uploaded << ",\n";
+        json << "      \"max_rss_kb\": " << result.max_rss_kb << "\n";
+        json << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+    return json.str();
+}
+
+/*!
+ * Reads "<metric>_ms" for the given scene from a JSON file written by ToJson().
+ * @return false if the scene isn't present in the baseline
+ */
+bool FindBaselineValue(const std::string& baseline_json,
+                       const std::string& scene_name,
+                       const std::string& metric,
+                       double& value) {
+    auto scene_pos = baseline_json.find("\"name\": \"" + scene_name + "\"");
+    if (scene_pos == std::string::npos) {
+        return false;
+    }
+    auto scene_end = baseline_json.find('}', scene_pos);
+    auto key = "\"" + metric + "_ms\": ";
+    auto value_pos = baseline_json.find(key, scene_pos);
+    if (value_pos == std::string::npos || value_pos > scene_end) {
+        return false;
+    }
+    value = atof(baseline_json.c_str() + value_pos + key.size());
+    return true;
+}
+
+/*!
+ * @return the number of scenes whose frame time regressed beyond the threshold
+ */
+int CompareWithBaseline(const BenchmarkOptions& options, const std::vector<SceneResult>& results) {
+    std::ifstream baseline_file(options.baseline_path);
+    if (!baseline_file) {
+        std::cerr << "Could not read baseline " << options.baseline_path << std::endl;
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << baseline_file.rdbuf();
+    const std::string baseline_json = buffer.str();
+
+    int regressions = 0;
+    for (const auto& result : results) {
+        double baseline_ms = 0.0;
+        if (!FindBaselineValue(baseline_json, result.name, options.metric, baseline_ms) || baseline_ms <= 0.0) {
+            std::cerr << result.name << ": not in baseline, skipped" << std::endl;
+            continue;
+        }
+        double current_ms = options.metric == "p50" ? result.p50_ms
+                          : options.metric == "p95" ? result.p95_ms
+                          : result.p99_ms;
+        double change_percent = (current_ms - baseline_ms) / baseline_ms * 100.0;
+        bool regressed = change_percent > options.threshold_percent;
+        std::cerr << result.name << ": " << options.metric << " " << baseline_ms << " -> " << current_ms
+                  << " ms (" << (change_percent >= 0.0 ? "+" : "") << change_percent << "%)"
+                  << (regressed ? "  REGRESSION" : "") << std::endl;
+        if (regressed) {
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--assets <dir>] [--frames <n>] [--warmup <n>] [--size <w>x<h>]"
+                     " [--instances <n,n,...>] [--vertex-layout separate|packed|quantized]"
+                     " [--reference-buffers] [--cache-dir <dir>] [--transform-system] [--animate]"
+                     " [--zoom <factor>] [--no-culling] [--workers <n>] [--lights <n>]"
+                     " [--compressed-textures] [--lod-errors <e,e,...>] [--lod-pixel-error <px>]"
+                     " [--no-mesh-optimization] [--meshlets] [--no-meshlet-culling]"
+                     " [--merge-geometry] [--output <file.json>]"
+                     " [--baseline <file.json>] [--threshold <percent>] [--metric p50|p95|p99]" << std::endl;
+        return 2;
+    }
+
+    std::unique_ptr<JobSystem> job_system;
+    if (options.workers > 0) {
+        job_system = std::make_unique<JobSystem>(unsigned(options.workers));
+    }
+
+    Renderer renderer(options.width, options.height);
+    if (options.compressed_textures) {
+        options.load_options.compressed_texture_formats = TextureAsset::getCompressedTextureFormats();
+    }
+    renderer.setFrustumCulling(options.frustum_culling);
+    renderer.setLodPixelError(options.lod_pixel_error);
+    renderer.setMeshletCulling(options.meshlet_culling);
+    renderer.setGeometryMerging(options.merge_geometry);
+    if (options.workers >= 0) {
+        renderer.setJobSystem(job_system.get());
+    }
+    std::vector<SceneResult> results;
+
+    for (const auto& scene_file : kSceneFiles) {
+        auto start = std::chrono::steady_clock::now();
+        auto model = MeshModelBuilder::CreateMeshModel(
+                options.assets_dir + "/" + scene_file, options.load_options);
+        auto end = std::chrono::steady_clock::now();
+        if (!model) {
+            std::cerr << "Skipping " << scene_file << ": could not be loaded" << std::endl;
+            continue;
+        }
+        auto scene = std::make_unique<SceneGraph>();
+        auto render_object = std::make_unique<RenderObject>();
+        render_object->ApplyMeshModel(std::move(model));
+        scene->AddRenderObject(render_object);
+
+        std::string name = scene_file.substr(0, scene_file.find('/'));
+        double load_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        results.push_back(RunScene(renderer, name, std::move(scene), load_ms, options));
+    }
+
+    for (int instance_count : options.instance_counts) {
+        auto start = std::chrono::steady_clock::now();
+        auto scene = CreateStressScene(instance_count, options.load_options, options.transform_system);
+        auto end = std::chrono::steady_clock::now();
+        double load_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        results.push_back(RunScene(renderer, "stress_" + std::to_string(instance_count),
+                                   std::move(scene), load_ms, options,
+                                   options.animate ? AnimateStressScene : nullptr));
+    }
+
+    const std::string json = ToJson(options, results);
+    if (options.output_path.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.output_path) << json;
+    }
+
+    if (!options.baseline_path.empty() && CompareWithBaseline(options, results) > 0) {
+        return 1;
+    }
+    return 0;
+}
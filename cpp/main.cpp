@@ -3,6 +3,7 @@
 #include "AndroidOut.h"
 #include "Renderer.h"
 #include "MeshModelBuilder.h"
+#include "TextureAsset.h"
 #include "scene/PerspectiveCamera.h"
 
 #define TINYGLTF_ANDROID_LOAD_FROM_ASSETS
@@ -128,6 +129,22 @@ void android_main(struct android_app *pApp) {
     } while (!pApp->destroyRequested);
 }
 
+/*!
+ * Points the camera at the scene's models, and puts the light in front of them.
+ */
+static void frameScene(SceneGraph& scene)
+{
+    glm::vec3 scene_center;
+    float scene_radius = 0.f;
+    scene.GetSceneBounds(scene_center, scene_radius);
+    auto camera_position = scene_center + glm::vec3(0.0f, 0.0f, scene_radius * 3.0f);
+    //light_position = scene_center + glm::vec3(0.0, 0.0, -scene_radius); // works for antique camera model
+    auto main_light_position = glm::vec3(0.0, 0.0, scene_radius); //  // works for avocado model
+
+    scene.GetCurrentCamera()->LookAt(camera_position, scene_center);
+    scene.GetLights()[0].light_position = main_light_position;
+}
+
 void createRenderObjects(android_app *pApp, Renderer* renderer)
 {
     // tinygltf needs the asset manager set before use.
@@ -142,27 +159,36 @@ void createRenderObjects(android_app *pApp, Renderer* renderer)
 
     auto scene= std::make_unique<SceneGraph>();
 
+    // pack the vertices to save vertex memory and fetch bandwidth, and have the meshes reference
+    // the loaded glTF buffers rather than copying them. After the first launch the meshes are mapped
+    // from the binary mesh cache in the app's internal storage. Textures converted to KTX2 by
+    // texture_converter are loaded compressed, if the gpu samples their format (the renderer's
+    // context is current). Far away meshes are drawn from simplified levels of detail.
+    MeshLoadOptions load_options;
+    load_options.vertex_layout = VertexLayout::PackedQuantized;
+    load_options.reference_source_buffers = true;
+    load_options.cache_directory = pApp->activity->internalDataPath;
+    load_options.compressed_texture_formats = TextureAsset::getCompressedTextureFormats();
+    load_options.lod_errors = {0.005f, 0.01f, 0.02f, 0.04f};
+    load_options.build_meshlets = true;
+
+    // draw a placeholder right away, and swap the model in once it's loaded in the background.
     auto render_object = std::make_unique<RenderObject>();
-    render_object->ApplyMeshModel(MeshModelBuilder::CreateMeshModel(scene_files[2]));
+    render_object->ApplyMeshModel(MeshModelBuilder::CreateMeshModelAsync(scene_files[2], load_options),
+                                  MeshModelBuilder::CreatePlaceholderModel());
     scene->AddRenderObject(render_object);
 
-    glm::vec3 scene_center;
-    float scene_radius = 0.f;
-    scene->GetSceneBounds(scene_center, scene_radius);
-    auto camera_position = scene_center + glm::vec3(0.0f, 0.0f, scene_radius * 3.0f);
-    //light_position = scene_center + glm::vec3(0.0, 0.0, -scene_radius); // works for antique camera model
-    auto main_light_position = glm::vec3(0.0, 0.0, scene_radius); //  // works for avocado model
-
     std::unique_ptr<CameraBaseNode> app_camera = std::make_unique<PerspectiveCamera>(45.0f, 800, 600, 0.01f, 500.0f);
-    app_camera->LookAt(camera_position, scene_center);
     scene->AddCamera(app_camera);
 
     SceneLight scene_light1;
     scene_light1.light_type = LightType::PointLight;
-    scene_light1.light_position = main_light_position;
     scene_light1.light_color = glm::vec3(1.0);
     scene->AddLight(scene_light1);
 
+    frameScene(*scene);
+    renderer->setModelsLoadedCallback(frameScene);
+
     renderer->ApplyCurrentScene(scene);
 }
 
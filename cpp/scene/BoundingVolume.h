@@ -0,0 +1,76 @@
+#ifndef MY_MOBILE_APP_BOUNDINGVOLUME_H
+#define MY_MOBILE_APP_BOUNDINGVOLUME_H
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/*!
+ * An axis aligned bounding box. An empty box has min > max.
+ */
+struct BoundingBox
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    inline bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    inline glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+    inline glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+    inline void Extend(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    inline void Extend(const BoundingBox& box) {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    /*!
+     * @return the axis aligned box enclosing this box once transformed by the given matrix
+     */
+    inline BoundingBox Transformed(const glm::mat4& matrix) const {
+        if(IsEmpty()) {
+            return *this;
+        }
+        const glm::vec3 center = glm::vec3(matrix * glm::vec4(GetCenter(), 1.0f));
+        const glm::vec3 extents = GetExtents();
+        // each world axis extent is the sum of the box axes' absolute projections on it
+        const glm::vec3 world_extents = glm::abs(glm::vec3(matrix[0])) * extents.x
+                                        + glm::abs(glm::vec3(matrix[1])) * extents.y
+                                        + glm::abs(glm::vec3(matrix[2])) * extents.z;
+        BoundingBox box;
+        box.min = center - world_extents;
+        box.max = center + world_extents;
+        return box;
+    }
+};
+
+/*!
+ * A bounding sphere. An empty sphere has a negative radius.
+ */
+struct BoundingSphere
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = -1.0f;
+
+    inline bool IsEmpty() const { return radius < 0.0f; }
+
+    /*!
+     * @return a sphere enclosing this sphere once transformed by the given matrix. Non uniform
+     * scales give the sphere the largest of the axis scales.
+     */
+    inline BoundingSphere Transformed(const glm::mat4& matrix) const {
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+        const float scale = std::sqrt(std::max(glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+                                      std::max(glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])),
+                                               glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2])))));
+        sphere.radius = IsEmpty() ? radius : radius * scale;
+        return sphere;
+    }
+};
+
+#endif //MY_MOBILE_APP_BOUNDINGVOLUME_H
@@ -0,0 +1,50 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& view_projection)
+{
+    // Gribb & Hartmann: a clip space point is inside when -w <= x, y, z <= w, so each plane is the
+    // fourth row of the matrix plus or minus one of the others.
+    auto row = [&view_projection](int i) {
+        return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+    };
+    _planes[Left] = row(3) + row(0);
+    _planes[Right] = row(3) - row(0);
+    _planes[Bottom] = row(3) + row(1);
+    _planes[Top] = row(3) - row(1);
+    _planes[Near] = row(3) + row(2);
+    _planes[Far] = row(3) - row(2);
+    for(auto& plane : _planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+    if(sphere.IsEmpty()) {
+        return false;
+    }
+    for(const auto& plane : _planes) {
+        if(glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const
+{
+    if(box.IsEmpty()) {
+        return false;
+    }
+    const glm::vec3 center = box.GetCenter();
+    const glm::vec3 extents = box.GetExtents();
+    for(const auto& plane : _planes) {
+        // the distance to the plane of the box corner furthest along its normal
+        const glm::vec3 normal = glm::vec3(plane);
+        const float radius = glm::dot(glm::abs(normal), extents);
+        if(glm::dot(normal, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef MY_MOBILE_APP_FRUSTUM_H
+#define MY_MOBILE_APP_FRUSTUM_H
+
+#include "BoundingVolume.h"
+
+/*!
+ * The six planes bounding a camera's view volume, used to skip meshes the camera can't see.
+ */
+class Frustum
+{
+public:
+    enum Plane { Left = 0, Right, Bottom, Top, Near, Far, PlaneCount };
+
+    /*!
+     * Extracts the planes of the volume a view-projection matrix maps to the clip cube.
+     * @param view_projection projection matrix * view matrix
+     */
+    explicit Frustum(const glm::mat4& view_projection);
+
+    /*!
+     * Conservative tests: they may accept a volume just outside a frustum corner, never reject
+     * a visible one. Empty volumes are never visible.
+     */
+    bool Intersects(const BoundingSphere& sphere) const;
+    bool Intersects(const BoundingBox& box) const;
+
+    // plane i is the points p with dot(xyz, p) + w >= 0 inside, xyz normalized
+    inline const glm::vec4& GetPlane(int i) const { return _planes[i]; }
+
+private:
+    glm::vec4 _planes[PlaneCount];
+};
+
+#endif //MY_MOBILE_APP_FRUSTUM_H
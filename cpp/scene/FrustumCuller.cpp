@@ -0,0 +1,166 @@
+#include "FrustumCuller.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FRUSTUM_CULLER_NEON 1
+#endif
+
+// the planes, one coefficient per array, so a batch can broadcast them
+struct PlaneCoefficients
+{
+    float x[Frustum::PlaneCount];
+    float y[Frustum::PlaneCount];
+    float z[Frustum::PlaneCount];
+    float w[Frustum::PlaneCount];
+
+    explicit PlaneCoefficients(const Frustum& frustum) {
+        for(int p = 0; p < Frustum::PlaneCount; ++p) {
+            const glm::vec4& plane = frustum.GetPlane(p);
+            x[p] = plane.x;
+            y[p] = plane.y;
+            z[p] = plane.z;
+            w[p] = plane.w;
+        }
+    }
+};
+
+/*!
+ * Tests the spheres in [begin, end) one at a time, appending the visible ones' indices.
+ * visible_indices must have room for end - begin more indices.
+ */
+static size_t CullSpheresRange(const PlaneCoefficients& planes, const BoundingSphereArray& spheres,
+                               size_t begin, size_t end, uint32_t* visible_indices)
+{
+    size_t count = 0;
+    for(size_t i = begin; i < end; ++i) {
+        const float radius = spheres.radius[i];
+        bool inside = radius >= 0.0f;
+        for(int p = 0; p < Frustum::PlaneCount && inside; ++p) {
+            // same operation order as the vectorized paths, and as Frustum::Intersects()
+            const float distance = planes.x[p] * spheres.center_x[i] + planes.y[p] * spheres.center_y[i]
+                                   + planes.z[p] * spheres.center_z[i] + planes.w[p];
+            inside = distance >= -radius;
+        }
+        // always write, only advance past visible spheres: no branch on the (unpredictable) result
+        visible_indices[count] = static_cast<uint32_t>(i);
+        count += inside ? 1 : 0;
+    }
+    return count;
+}
+
+size_t FrustumCuller::CullSpheresScalar(const Frustum& frustum, const BoundingSphereArray& spheres,
+                                        std::vector<uint32_t>& visible_indices)
+{
+    visible_indices.resize(spheres.size());
+    const size_t count = CullSpheresRange(PlaneCoefficients(frustum), spheres, 0, spheres.size(),
+                                          visible_indices.data());
+    visible_indices.resize(count);
+    return count;
+}
+
+size_t FrustumCuller::CullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres,
+                                  std::vector<uint32_t>& visible_indices)
+{
+    const PlaneCoefficients planes(frustum);
+    const size_t sphere_count = spheres.size();
+    visible_indices.resize(sphere_count);
+    uint32_t* output = visible_indices.data();
+    size_t count = 0;
+    size_t i = 0;
+
+#if FRUSTUM_CULLER_AVX2
+    const __m256 zero = _mm256_setzero_ps();
+    for(; i + 8 <= sphere_count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(&spheres.center_x[i]);
+        const __m256 y = _mm256_loadu_ps(&spheres.center_y[i]);
+        const __m256 z = _mm256_loadu_ps(&spheres.center_z[i]);
+        const __m256 radius = _mm256_loadu_ps(&spheres.radius[i]);
+        const __m256 negative_radius = _mm256_sub_ps(zero, radius);
+        __m256 inside = _mm256_cmp_ps(radius, zero, _CMP_GE_OQ);
+        for(int p = 0; p < Frustum::PlaneCount; ++p) {
+            __m256 distance = _mm256_mul_ps(_mm256_set1_ps(planes.x[p]), x);
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.y[p]), y));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.z[p]), z));
+            distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.w[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+        }
+        const int mask = _mm256_movemask_ps(inside);
+        for(int k = 0; k < 8; ++k) {
+            output[count] = static_cast<uint32_t>(i + k);
+            count += (mask >> k) & 1;
+        }
+    }
+#elif FRUSTUM_CULLER_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= sphere_count; i += 4) {
+        const __m128 x = _mm_loadu_ps(&spheres.center_x[i]);
+        const __m128 y = _mm_loadu_ps(&spheres.center_y[i]);
+        const __m128 z = _mm_loadu_ps(&spheres.center_z[i]);
+        const __m128 radius = _mm_loadu_ps(&spheres.radius[i]);
+        const __m128 negative_radius = _mm_sub_ps(zero, radius);
+        __m128 inside = _mm_cmpge_ps(radius, zero);
+        for(int p = 0; p < Frustum::PlaneCount; ++p) {
+            __m128 distance = _mm_mul_ps(_mm_set1_ps(planes.x[p]), x);
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.y[p]), y));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.z[p]), z));
+            distance = _mm_add_ps(distance, _mm_set1_ps(planes.w[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+        }
+        const int mask = _mm_movemask_ps(inside);
+        for(int k = 0; k < 4; ++k) {
+            output[count] = static_cast<uint32_t>(i + k);
+            count += (mask >> k) & 1;
+        }
+    }
+#elif FRUSTUM_CULLER_NEON
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    for(; i + 4 <= sphere_count; i += 4) {
+        const float32x4_t x = vld1q_f32(&spheres.center_x[i]);
+        const float32x4_t y = vld1q_f32(&spheres.center_y[i]);
+        const float32x4_t z = vld1q_f32(&spheres.center_z[i]);
+        const float32x4_t radius = vld1q_f32(&spheres.radius[i]);
+        const float32x4_t negative_radius = vnegq_f32(radius);
+        uint32x4_t inside = vcgeq_f32(radius, zero);
+        for(int p = 0; p < Frustum::PlaneCount; ++p) {
+            // separate multiplies and adds, not vmlaq, to round like the scalar path
+            float32x4_t distance = vmulq_n_f32(x, planes.x[p]);
+            distance = vaddq_f32(distance, vmulq_n_f32(y, planes.y[p]));
+            distance = vaddq_f32(distance, vmulq_n_f32(z, planes.z[p]));
+            distance = vaddq_f32(distance, vdupq_n_f32(planes.w[p]));
+            inside = vandq_u32(inside, vcgeq_f32(distance, negative_radius));
+        }
+        // lanes are all ones or all zeros
+        output[count] = static_cast<uint32_t>(i);
+        count += vgetq_lane_u32(inside, 0) & 1;
+        output[count] = static_cast<uint32_t>(i + 1);
+        count += vgetq_lane_u32(inside, 1) & 1;
+        output[count] = static_cast<uint32_t>(i + 2);
+        count += vgetq_lane_u32(inside, 2) & 1;
+        output[count] = static_cast<uint32_t>(i + 3);
+        count += vgetq_lane_u32(inside, 3) & 1;
+    }
+#endif
+
+    count += CullSpheresRange(planes, spheres, i, sphere_count, output + count);
+    visible_indices.resize(count);
+    return count;
+}
+
+const char* FrustumCuller::GetInstructionSet()
+{
+#if FRUSTUM_CULLER_AVX2
+    return "avx2";
+#elif FRUSTUM_CULLER_SSE2
+    return "sse2";
+#elif FRUSTUM_CULLER_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,63 @@
+#ifndef MY_MOBILE_APP_FRUSTUMCULLER_H
+#define MY_MOBILE_APP_FRUSTUMCULLER_H
+
+#include "Frustum.h"
+
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Bounding spheres stored as separate coordinate arrays, so that a batch of consecutive spheres
+ * loads straight into SIMD registers.
+ */
+struct BoundingSphereArray
+{
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> radius;
+
+    inline size_t size() const { return radius.size(); }
+
+    inline void clear() {
+        center_x.clear();
+        center_y.clear();
+        center_z.clear();
+        radius.clear();
+    }
+
+    inline void push_back(const BoundingSphere& sphere) {
+        center_x.push_back(sphere.center.x);
+        center_y.push_back(sphere.center.y);
+        center_z.push_back(sphere.center.z);
+        radius.push_back(sphere.radius);
+    }
+};
+
+/*!
+ * Tests many bounding spheres against a frustum at once.
+ *
+ * The spheres are tested 8 (AVX2) or 4 (SSE2, NEON) at a time against each of the six planes,
+ * whichever the build targets, with a scalar loop for the remainder and for other targets.
+ */
+class FrustumCuller
+{
+public:
+    /*!
+     * Finds the spheres intersecting the frustum. Same results as Frustum::Intersects() on each
+     * sphere, including rejecting spheres with a negative radius.
+     * @param visible_indices set to the indices of the visible spheres, in increasing order
+     * @return the number of visible spheres
+     */
+    static size_t CullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres,
+                              std::vector<uint32_t>& visible_indices);
+
+    // The same, one sphere at a time. Kept as the reference for the vectorized version.
+    static size_t CullSpheresScalar(const Frustum& frustum, const BoundingSphereArray& spheres,
+                                    std::vector<uint32_t>& visible_indices);
+
+    // the instruction set CullSpheres() was built for: "avx2", "sse2", "neon" or "scalar"
+    static const char* GetInstructionSet();
+};
+
+#endif //MY_MOBILE_APP_FRUSTUMCULLER_H
@@ -1,6 +1,42 @@
 #include "RenderObject.h"
 
+#include <chrono>
+
 void RenderObject::ApplyMeshModel(std::unique_ptr<Model> model)
+{
+    SetModel(std::move(model));
+    _pending_model = std::future<std::unique_ptr<Model>>();
+}
+
+void RenderObject::ApplyMeshModel(std::future<std::unique_ptr<Model>> pending_model, std::unique_ptr<Model> placeholder)
+{
+    SetModel(std::move(placeholder));
+    _pending_model = std::move(pending_model);
+}
+
+void RenderObject::SetModel(std::unique_ptr<Model> model)
 {
     _model = std::move(model);
+    // the model is placed relative to this object
+    if(_model) {
+        AddChild(_model.get());
+    }
+}
+
+bool RenderObject::ApplyLoadedModel(std::unique_ptr<Model>& replaced_model)
+{
+    if(!_pending_model.valid()
+       || _pending_model.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+    auto loaded_model = _pending_model.get();
+    if(!loaded_model) {
+        return false;
+    }
+    replaced_model = std::move(_model);
+    if(replaced_model) {
+        RemoveChild(replaced_model.get());
+    }
+    SetModel(std::move(loaded_model));
+    return true;
 }
@@ -4,6 +4,7 @@
 #include "SceneNode.h"
 #include "../Model.h"
 
+#include <future>
 #include <memory>
 
 
@@ -11,12 +12,35 @@ class RenderObject : public SceneNode
 {
 public:
     void ApplyMeshModel(std::unique_ptr<Model> model);
+
+    /*!
+     * Shows the placeholder model until the model loading in the background is ready.
+     * @param pending_model e.g. from MeshModelBuilder::CreateMeshModelAsync
+     * @param placeholder drawn meanwhile, must not be null
+     */
+    void ApplyMeshModel(std::future<std::unique_ptr<Model>> pending_model, std::unique_ptr<Model> placeholder);
+
+    /*!
+     * Replaces the current model with the pending one, if it finished loading. A model that failed
+     * to load is dropped, and the placeholder stays.
+     * @param replaced_model receives the replaced model, whose gpu resources the caller must release
+     * @return true if the current model changed
+     */
+    bool ApplyLoadedModel(std::unique_ptr<Model>& replaced_model);
+
+    inline bool HasPendingModel() const {
+        return _pending_model.valid();
+    }
+
     inline Model* GetMeshModel() const {
         return _model.get();
     }
 
 private:
+    void SetModel(std::unique_ptr<Model> model);
+
     std::unique_ptr<Model> _model;
+    std::future<std::unique_ptr<Model>> _pending_model;
 };
 
 
@@ -1,19 +1,10 @@
 #include "SceneGraph.h"
 
-static void ComputeBBox(const Model& model,  glm::vec3& bbox_min, glm::vec3& bbox_max)
+static void ComputeBBox(const Model& model, BoundingBox& bbox)
 {
-    for(const auto& mesh : model.GetMeshes()) {
-        const auto &indices = mesh->_indices;
-        const auto &vertices = mesh->_vertices;
-        for (const auto &index: indices) {
-            auto vertex = mesh->_model_transform * glm::vec4(vertices[index], 1.0);
-            bbox_min.x = std::min(bbox_min.x, vertex.x);
-            bbox_min.y = std::min(bbox_min.y, vertex.y);
-            bbox_min.z = std::min(bbox_min.z, vertex.z);
-            bbox_max.x = std::max(bbox_max.x, vertex.x);
-            bbox_max.y = std::max(bbox_max.y, vertex.y);
-            bbox_max.z = std::max(bbox_max.z, vertex.z);
-        }
+    for(const auto& instance : model.GetMeshInstances()) {
+        const glm::mat4& mesh_transform = instance.node->GetTransform().GetWorldMatrix();
+        bbox.Extend(instance.mesh->_bounding_box.Transformed(mesh_transform));
     }
 }
 
@@ -29,25 +20,51 @@ void SceneGraph::AddLight(const SceneLight& light)
 
 void SceneGraph::AddRenderObject(std::unique_ptr<RenderObject>& render_object)
 {
+    if(_transform_system) {
+        render_object->AttachTransformSystem(*_transform_system);
+    }
     _render_objects.emplace_back(std::move(render_object));
 }
 
-void SceneGraph::GetSceneBounds(glm::vec3& scene_center, float& scene_radius) const
+void SceneGraph::EnableTransformSystem()
 {
-    glm::vec3 bbox_min;
-    glm::vec3 bbox_max;
+    if(_transform_system) {
+        return;
+    }
+    _transform_system = std::make_unique<TransformSystem>();
+    for(const auto& render_object : _render_objects) {
+        render_object->AttachTransformSystem(*_transform_system);
+    }
+}
 
-    bbox_min.x = std::numeric_limits<float>::max();
-    bbox_min.y = bbox_min.x;
-    bbox_min.z = bbox_min.x;
-    bbox_max.x = std::numeric_limits<float>::min();
-    bbox_max.y = bbox_max.x;
-    bbox_max.z = bbox_max.x;
+size_t SceneGraph::UpdateWorldTransforms()
+{
+    size_t updated = 0;
+    if(_transform_system) {
+        updated += _transform_system->Update();
+    }
+    for(const auto& render_object : _render_objects) {
+        if(!render_object->GetTransform().GetSystem()) {
+            updated += render_object->UpdateWorldTransforms();
+        }
+    }
+    return updated;
+}
 
+void SceneGraph::GetSceneBounds(glm::vec3& scene_center, float& scene_radius)
+{
+    UpdateWorldTransforms();
+
+    BoundingBox bbox;
     for(const auto& render_object : _render_objects ) {
-        ComputeBBox(*render_object->GetMeshModel(), bbox_min, bbox_max);
+        ComputeBBox(*render_object->GetMeshModel(), bbox);
     }
 
-    scene_center = (bbox_min + bbox_max) * 0.5f;
-    scene_radius = glm::length(bbox_max - scene_center);
+    if(bbox.IsEmpty()) {
+        scene_center = glm::vec3(0.0f);
+        scene_radius = 0.0f;
+        return;
+    }
+    scene_center = bbox.GetCenter();
+    scene_radius = glm::length(bbox.GetExtents());
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "RenderObject.h"
 #include "SceneLight.h"
 #include "CameraBaseNode.h"
+#include "TransformSystem.h"
 
 #include <memory>
 #include <vector>
@@ -35,11 +36,28 @@ public:
         return _render_objects;
     }
 
-    // Computes the scene bounds encompassing all scene meshes.
-    void GetSceneBounds(glm::vec3& scene_center, float& scene_radius) const;
+    /*!
+     * Stores the transforms of the render objects and of their models' nodes, present and future,
+     * in one TransformSystem, so the world matrices of large scenes update in one linear pass.
+     */
+    void EnableTransformSystem();
+    inline TransformSystem* GetTransformSystem() const {
+        return _transform_system.get();
+    }
+
+    /*!
+     * Brings the world matrices of the render objects, and of their models' nodes, up to date.
+     * @return the number of world matrices recomputed
+     */
+    size_t UpdateWorldTransforms();
+
+    // Computes the scene bounds encompassing all scene meshes, from their precomputed bounds.
+    void GetSceneBounds(glm::vec3& scene_center, float& scene_radius);
 
 private:
 
+    // declared first, so it outlives the nodes attached to it
+    std::unique_ptr<TransformSystem> _transform_system;
     std::vector<std::unique_ptr<CameraBaseNode>> _cameras;
     std::vector<SceneLight> _lights;
     std::vector<std::unique_ptr<RenderObject>> _render_objects;
@@ -3,7 +3,8 @@
 
 #include "glm/glm.hpp"
 
-#define MAX_LIGHTS 5
+// the lights a scene can have, all uploaded in one uniform block
+#define MAX_LIGHTS 256
 
 enum LightType : int
 {
@@ -15,7 +16,9 @@ struct alignas(16) SceneLight // layout(std140) rules: vec3 pads to vec4
     LightType light_type = LightType::PointLight;
     glm::vec3 padding0; // pad each field to 16 bytes
     glm::vec3 light_position = glm::vec3(0.0);
-    float padding1;     // pad each field to 16 bytes
+    // the distance the light reaches, fading out towards it. 0 lights everything, at full strength.
+    // Packs with the position into 16 bytes.
+    float light_range = 0.0f;
     glm::vec3 light_color = glm::vec3(1.0, 1.0, 1.0); // noon/daylight;
     float padding2;     // pad each field to 16 bytes
 };
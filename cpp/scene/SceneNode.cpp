@@ -0,0 +1,105 @@
+#include "SceneNode.h"
+
+#include <algorithm>
+
+SceneNode::~SceneNode()
+{
+    if(_parent) {
+        _parent->RemoveChild(this);
+    }
+    for(auto* child : _children) {
+        child->_parent = nullptr;
+        child->MarkTransformDirty();
+    }
+    // the children's transforms become roots of the system
+    if(_transform._system) {
+        _transform._system->Destroy(_transform._handle);
+    }
+}
+
+void SceneNode::AddChild(SceneNode* child)
+{
+    if(child->_parent == this) {
+        return;
+    }
+    if(child->_parent) {
+        child->_parent->RemoveChild(child);
+    }
+    child->_parent = this;
+    _children.push_back(child);
+    // its world matrix now depends on this node's
+    child->MarkTransformDirty();
+    if(_transform._system && !child->_transform._system) {
+        child->AttachTransformSystem(*_transform._system);
+    } else if(_transform._system && _transform._system == child->_transform._system) {
+        _transform._system->SetParent(child->_transform._handle, _transform._handle);
+    }
+}
+
+void SceneNode::RemoveChild(SceneNode* child)
+{
+    auto found = std::find(_children.begin(), _children.end(), child);
+    if(found == _children.end()) {
+        return;
+    }
+    _children.erase(found);
+    child->_parent = nullptr;
+    child->MarkTransformDirty();
+    if(child->_transform._system) {
+        child->_transform._system->SetParent(child->_transform._handle, TransformHandle());
+    }
+}
+
+void SceneNode::AttachTransformSystem(TransformSystem& system)
+{
+    if(_transform._system) {
+        return;
+    }
+    TransformHandle parent_handle;
+    if(_parent && _parent->_transform._system == &system) {
+        parent_handle = _parent->_transform._handle;
+    }
+    _transform._handle = system.Create(parent_handle);
+    _transform._system = &system;
+    system.SetLocalMatrix(_transform._handle, _transform._local_transform);
+    for(auto* child : _children) {
+        child->AttachTransformSystem(system);
+    }
+}
+
+void SceneNode::MarkTransformDirty()
+{
+    _transform._dirty = true;
+    // stop at the first flagged ancestor, the rest of the path to the root is flagged already
+    for(auto* ancestor = _parent; ancestor && !ancestor->_subtree_dirty; ancestor = ancestor->_parent) {
+        ancestor->_subtree_dirty = true;
+    }
+}
+
+size_t SceneNode::UpdateWorldTransforms()
+{
+    if(_transform._system) {
+        return _transform._system->Update();
+    }
+    return UpdateWorldTransforms(_parent ? _parent->_transform._world_transform : glm::mat4(1.0f), false);
+}
+
+size_t SceneNode::UpdateWorldTransforms(const glm::mat4& parent_world, bool parent_changed)
+{
+    size_t updated = 0;
+    const bool changed = parent_changed || _transform._dirty;
+    if(changed) {
+        _transform._world_transform = parent_world * _transform._local_transform;
+        _transform._dirty = false;
+        ++updated;
+    }
+    if(changed || _subtree_dirty) {
+        for(auto* child : _children) {
+            if(!child->_transform._system) {
+                updated += child->UpdateWorldTransforms(_transform._world_transform, changed);
+            }
+        }
+    }
+    _subtree_dirty = false;
+    return updated;
+}
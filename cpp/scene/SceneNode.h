@@ -3,21 +3,70 @@
 
 #include "Transform.h"
 
+#include <string>
+#include <vector>
+
 class SceneNode
 {
 protected:
-    SceneNode() = default;
+    SceneNode() : _transform(this) {}
 public:
-    virtual ~SceneNode() = default;
+    virtual ~SceneNode();
+
+    SceneNode(const SceneNode&) = delete;
+    SceneNode& operator=(const SceneNode&) = delete;
 
 public:
     Transform& GetTransform() {
         return _transform;
     }
+    const Transform& GetTransform() const {
+        return _transform;
+    }
+
+    // Links a child node, detaching it from its previous parent. Nodes don't own their children.
+    void AddChild(SceneNode* child);
+    void RemoveChild(SceneNode* child);
+
+    inline SceneNode* GetParent() const {
+        return _parent;
+    }
+    inline const std::vector<SceneNode*>& GetChildren() const {
+        return _children;
+    }
+
+    /*!
+     * Brings the world matrices of this node and its descendants up to date. Only the nodes whose
+     * local matrix changed since the last pass, and their descendants, are recomputed: subtrees
+     * without changes are skipped. Call it on root nodes, once per frame.
+     *
+     * Nodes attached to a transform system are updated by the system's own (whole system) update.
+     * @return the number of world matrices recomputed
+     */
+    size_t UpdateWorldTransforms();
+
+    /*!
+     * Moves the transforms of this node and of its descendants into the system, which has to outlive
+     * them. Children added later join it too. Attach root nodes, a node's world matrix only includes
+     * its parent's when both are in the same system.
+     */
+    void AttachTransformSystem(TransformSystem& system);
 
 protected:
     std::string _id;
     Transform _transform;
+
+private:
+    friend class Transform;
+
+    // marks this node's world matrix out of date, and flags the path to the root for the next update
+    void MarkTransformDirty();
+    size_t UpdateWorldTransforms(const glm::mat4& parent_world, bool parent_changed);
+
+    SceneNode* _parent = nullptr;
+    std::vector<SceneNode*> _children;
+    // true if some node below this one has an out of date world matrix
+    bool _subtree_dirty = false;
 };
 
 
@@ -1,6 +1,20 @@
 #include "Transform.h"
+#include "SceneNode.h"
+
+void Transform::SetLocalMatrix(const glm::mat4& value)
+{
+    if(_system) {
+        _system->SetLocalMatrix(_handle, value);
+        return;
+    }
+    _local_transform = value;
+    _node->MarkTransformDirty();
+}
 
 glm::vec3 Transform::GetPosition() const
 {
+    if(_system) {
+        return _system->GetPosition(_handle);
+    }
     return {_local_transform[3][0], _local_transform[3][1], _local_transform[3][2] };
-}
\ No newline at end of file
+}
@@ -5,20 +5,53 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/quaternion.hpp"
+#include "TransformSystem.h"
 
+class SceneNode;
+
+/*!
+ * A scene node's transform. It's stored in the node itself, or, once the node is attached to a
+ * TransformSystem (see SceneNode::AttachTransformSystem), in the system's arrays.
+ */
 class Transform
 {
 public:
-    inline glm::mat4 GetLocalMatrix() {
-        return _local_transform;
+    explicit Transform(SceneNode* node) : _node(node) {}
+
+    inline glm::mat4 GetLocalMatrix() const {
+        return _system ? _system->GetLocalMatrix(_handle) : _local_transform;
     }
-    inline void SetLocalMatrix(const glm::mat4& value) {
-        _local_transform = value;
+    // also marks the node's world matrix, and its descendants', out of date
+    void SetLocalMatrix(const glm::mat4& value);
+
+    // the world matrix as of the last world transforms update over this node
+    inline const glm::mat4& GetWorldMatrix() const {
+        return _system ? _system->GetWorldMatrix(_handle) : _world_transform;
     }
+    // true if the local matrix changed since the world matrix was last updated
+    inline bool IsDirty() const {
+        return _system ? _system->IsDirty(_handle) : _dirty;
+    }
+
     glm::vec3 GetPosition() const;
 
+    // the system storing this transform, or null
+    inline TransformSystem* GetSystem() const {
+        return _system;
+    }
+    inline TransformHandle GetHandle() const {
+        return _handle;
+    }
+
 private:
-    glm::mat4 _local_transform; // relative to its parent, world transform later...
+    friend class SceneNode;
+
+    SceneNode* _node;
+    TransformSystem* _system = nullptr;
+    TransformHandle _handle;
+    glm::mat4 _local_transform = glm::mat4(1.0f); // relative to its parent
+    glm::mat4 _world_transform = glm::mat4(1.0f);
+    bool _dirty = true;
 };
 
 
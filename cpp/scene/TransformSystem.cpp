@@ -0,0 +1,215 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+
+// local matrix = translate(position) * rotate(rotation) * scale(scale)
+static inline glm::mat4 ComposeMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+    const glm::mat3 rotation_matrix = glm::mat3_cast(rotation);
+    glm::mat4 matrix;
+    matrix[0] = glm::vec4(rotation_matrix[0] * scale.x, 0.0f);
+    matrix[1] = glm::vec4(rotation_matrix[1] * scale.y, 0.0f);
+    matrix[2] = glm::vec4(rotation_matrix[2] * scale.z, 0.0f);
+    matrix[3] = glm::vec4(position, 1.0f);
+    return matrix;
+}
+
+TransformHandle TransformSystem::Create(TransformHandle parent)
+{
+    TransformHandle handle;
+    if(!_free_handles.empty()) {
+        handle.id = _free_handles.back();
+        _free_handles.pop_back();
+    } else {
+        handle.id = static_cast<uint32_t>(_slots.size());
+        _slots.push_back(TransformHandle::INVALID);
+    }
+
+    // appended after its parent, so the arrays stay sorted
+    const auto slot = static_cast<uint32_t>(_positions.size());
+    _slots[handle.id] = slot;
+    _positions.emplace_back(0.0f);
+    _rotations.emplace_back();
+    _scales.emplace_back(1.0f);
+    _world_matrices.emplace_back(1.0f);
+    _parents.push_back(parent.IsValid() ? static_cast<int32_t>(_slots[parent.id]) : -1);
+    _dirty.push_back(1);
+    _handles.push_back(handle.id);
+    return handle;
+}
+
+void TransformSystem::Destroy(TransformHandle handle)
+{
+    const auto slot = static_cast<int32_t>(_slots[handle.id]);
+    for(size_t i = 0; i < _parents.size(); ++i) {
+        if(_parents[i] == slot) {
+            _parents[i] = -1;
+            _dirty[i] = 1;
+        }
+    }
+    // the slot itself is dropped by the next sort
+    _handles[slot] = TransformHandle::INVALID;
+    _parents[slot] = -1;
+    _slots[handle.id] = TransformHandle::INVALID;
+    _free_handles.push_back(handle.id);
+    _needs_sort = true;
+}
+
+void TransformSystem::SetParent(TransformHandle handle, TransformHandle parent)
+{
+    const auto slot = static_cast<int32_t>(_slots[handle.id]);
+    const int32_t parent_slot = parent.IsValid() ? static_cast<int32_t>(_slots[parent.id]) : -1;
+    // refuse to make a transform its own ancestor
+    for(int32_t ancestor = parent_slot; ancestor >= 0; ancestor = _parents[ancestor]) {
+        if(ancestor == slot) {
+            return;
+        }
+    }
+    _parents[slot] = parent_slot;
+    _dirty[slot] = 1;
+    if(parent_slot > slot) {
+        _needs_sort = true;
+    }
+}
+
+void TransformSystem::SetPosition(TransformHandle handle, const glm::vec3& position)
+{
+    _positions[_slots[handle.id]] = position;
+    MarkDirty(handle);
+}
+
+void TransformSystem::SetRotation(TransformHandle handle, const glm::quat& rotation)
+{
+    _rotations[_slots[handle.id]] = rotation;
+    MarkDirty(handle);
+}
+
+void TransformSystem::SetScale(TransformHandle handle, const glm::vec3& scale)
+{
+    _scales[_slots[handle.id]] = scale;
+    MarkDirty(handle);
+}
+
+void TransformSystem::SetLocalMatrix(TransformHandle handle, const glm::mat4& local_matrix)
+{
+    const auto slot = _slots[handle.id];
+    glm::mat3 basis = glm::mat3(local_matrix);
+    glm::vec3 scale(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+    // a mirroring matrix: fold the mirror into the x scale
+    if(glm::determinant(basis) < 0.0f) {
+        scale.x = -scale.x;
+    }
+    glm::quat rotation;
+    if(scale.x != 0.0f && scale.y != 0.0f && scale.z != 0.0f) {
+        basis[0] /= scale.x;
+        basis[1] /= scale.y;
+        basis[2] /= scale.z;
+        rotation = glm::normalize(glm::quat_cast(basis));
+    }
+    _positions[slot] = glm::vec3(local_matrix[3]);
+    _rotations[slot] = rotation;
+    _scales[slot] = scale;
+    _dirty[slot] = 1;
+}
+
+glm::mat4 TransformSystem::GetLocalMatrix(TransformHandle handle) const
+{
+    const auto slot = _slots[handle.id];
+    return ComposeMatrix(_positions[slot], _rotations[slot], _scales[slot]);
+}
+
+size_t TransformSystem::Update()
+{
+    if(_needs_sort) {
+        SortByHierarchy();
+    }
+
+    // parents come first: by the time a transform is reached, its parent is up to date, and its
+    // dirty flag tells whether the parent's world matrix just changed.
+    size_t updated = 0;
+    const size_t count = _positions.size();
+    for(size_t i = 0; i < count; ++i) {
+        const int32_t parent = _parents[i];
+        if(parent >= 0) {
+            _dirty[i] |= _dirty[parent];
+        }
+        if(!_dirty[i]) {
+            continue;
+        }
+        const glm::mat4 local_matrix = ComposeMatrix(_positions[i], _rotations[i], _scales[i]);
+        _world_matrices[i] = parent >= 0 ? _world_matrices[parent] * local_matrix : local_matrix;
+        ++updated;
+    }
+    std::fill(_dirty.begin(), _dirty.end(), 0);
+    return updated;
+}
+
+void TransformSystem::SortByHierarchy()
+{
+    const size_t count = _positions.size();
+
+    // children of each slot, in slot order
+    std::vector<uint32_t> child_offsets(count + 1, 0);
+    for(size_t i = 0; i < count; ++i) {
+        if(_parents[i] >= 0) {
+            ++child_offsets[_parents[i] + 1];
+        }
+    }
+    for(size_t i = 0; i < count; ++i) {
+        child_offsets[i + 1] += child_offsets[i];
+    }
+    std::vector<uint32_t> children(child_offsets[count]);
+    std::vector<uint32_t> child_fill(child_offsets.begin(), child_offsets.end() - 1);
+    for(size_t i = 0; i < count; ++i) {
+        if(_parents[i] >= 0) {
+            children[child_fill[_parents[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // depth-first from each live root, so every subtree ends up contiguous
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    std::vector<uint32_t> stack;
+    for(size_t root = 0; root < count; ++root) {
+        if(_parents[root] >= 0 || _handles[root] == TransformHandle::INVALID) {
+            continue;
+        }
+        stack.push_back(static_cast<uint32_t>(root));
+        while(!stack.empty()) {
+            const uint32_t slot = stack.back();
+            stack.pop_back();
+            order.push_back(slot);
+            for(uint32_t c = child_offsets[slot + 1]; c > child_offsets[slot]; --c) {
+                stack.push_back(children[c - 1]);
+            }
+        }
+    }
+
+    std::vector<int32_t> new_slots(count, -1);
+    for(size_t i = 0; i < order.size(); ++i) {
+        new_slots[order[i]] = static_cast<int32_t>(i);
+    }
+
+    auto permute = [&order](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted;
+        sorted.reserve(order.size());
+        for(auto slot : order) {
+            sorted.push_back(values[slot]);
+        }
+        values.swap(sorted);
+    };
+    permute(_positions);
+    permute(_rotations);
+    permute(_scales);
+    permute(_world_matrices);
+    permute(_dirty);
+    permute(_handles);
+    permute(_parents);
+    for(size_t i = 0; i < order.size(); ++i) {
+        if(_parents[i] >= 0) {
+            _parents[i] = new_slots[_parents[i]];
+        }
+        _slots[_handles[i]] = static_cast<uint32_t>(i);
+    }
+    _needs_sort = false;
+}
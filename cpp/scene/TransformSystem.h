@@ -0,0 +1,90 @@
+#ifndef MY_MOBILE_APP_TRANSFORMSYSTEM_H
+#define MY_MOBILE_APP_TRANSFORMSYSTEM_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Identifies a transform inside a TransformSystem. Stays valid while the system reorders its arrays.
+ */
+struct TransformHandle
+{
+    static constexpr uint32_t INVALID = UINT32_MAX;
+    uint32_t id = INVALID;
+
+    inline bool IsValid() const { return id != INVALID; }
+    inline bool operator==(const TransformHandle& other) const { return id == other.id; }
+    inline bool operator!=(const TransformHandle& other) const { return id != other.id; }
+};
+
+/*!
+ * Data-oriented storage for the transforms of many scene nodes.
+ *
+ * Positions, rotations, scales and world matrices live in separate contiguous arrays, sorted so that
+ * every parent comes before its children. Update() then computes all out of date world matrices in
+ * one linear pass, without chasing node pointers.
+ */
+class TransformSystem
+{
+public:
+    /*!
+     * @param parent the parent transform, or an invalid handle for a root
+     */
+    TransformHandle Create(TransformHandle parent = TransformHandle());
+    // The children of a destroyed transform become roots.
+    void Destroy(TransformHandle handle);
+
+    void SetParent(TransformHandle handle, TransformHandle parent);
+
+    void SetPosition(TransformHandle handle, const glm::vec3& position);
+    void SetRotation(TransformHandle handle, const glm::quat& rotation);
+    void SetScale(TransformHandle handle, const glm::vec3& scale);
+    // decomposes the matrix into position, rotation and scale. Shear is lost.
+    void SetLocalMatrix(TransformHandle handle, const glm::mat4& local_matrix);
+
+    inline const glm::vec3& GetPosition(TransformHandle handle) const { return _positions[_slots[handle.id]]; }
+    inline const glm::quat& GetRotation(TransformHandle handle) const { return _rotations[_slots[handle.id]]; }
+    inline const glm::vec3& GetScale(TransformHandle handle) const { return _scales[_slots[handle.id]]; }
+    glm::mat4 GetLocalMatrix(TransformHandle handle) const;
+    // the world matrix as of the last Update()
+    inline const glm::mat4& GetWorldMatrix(TransformHandle handle) const { return _world_matrices[_slots[handle.id]]; }
+
+    // true if the transform changed since the last Update()
+    inline bool IsDirty(TransformHandle handle) const { return _dirty[_slots[handle.id]] != 0; }
+
+    inline size_t GetCount() const { return _positions.size(); }
+
+    /*!
+     * Recomputes the world matrices of the transforms changed since the last update, and of their
+     * descendants.
+     * @return the number of world matrices recomputed
+     */
+    size_t Update();
+
+private:
+    // reorders the arrays depth-first, parents before their children, and drops destroyed slots
+    void SortByHierarchy();
+
+    inline void MarkDirty(TransformHandle handle) { _dirty[_slots[handle.id]] = 1; }
+
+    // by slot
+    std::vector<glm::vec3> _positions;
+    std::vector<glm::quat> _rotations;
+    std::vector<glm::vec3> _scales;
+    std::vector<glm::mat4> _world_matrices;
+    std::vector<int32_t> _parents; // parent slot, -1 for roots
+    std::vector<uint8_t> _dirty;
+    std::vector<uint32_t> _handles; // handle id of each slot, INVALID once destroyed
+
+    // by handle id
+    std::vector<uint32_t> _slots;
+    std::vector<uint32_t> _free_handles;
+
+    // set when the arrays are no longer sorted, or hold destroyed slots
+    bool _needs_sort = false;
+};
+
+#endif //MY_MOBILE_APP_TRANSFORMSYSTEM_H
@@ -0,0 +1,258 @@
+#include "EtcEncoder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+// the ETC1 intensity modifier tables: a pixel index selects +small, +large, -small or -large
+const int COLOR_MODIFIERS[8][2] = {
+        {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+// the EAC modifier tables, multiplied by the block's multiplier
+const int ALPHA_MODIFIERS[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14},
+        {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8, -13, 1, 4, 7, 12},
+        {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11},
+        {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10},
+        {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9},
+        {-2, -5, -8, -10, 1, 4, 7, 9},
+        {-2, -4, -8, -10, 1, 3, 7, 9},
+        {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9},
+        {-1, -2, -3, -10, 0, 1, 2, 9},
+        {-4, -6, -8, -9, 3, 5, 7, 8},
+        {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+inline int Clamp255(int value)
+{
+    return std::min(std::max(value, 0), 255);
+}
+
+// the pixels of a block are numbered column by column in ETC blocks
+inline int PixelNumber(int x, int y)
+{
+    return x * 4 + y;
+}
+
+/*!
+ * The best intensity modifier table, and each pixel's modifier, for a subblock with the given base
+ * color.
+ * @return the subblock's squared error
+ */
+int EncodeSubblock(const unsigned char* pixels, bool flip, int subblock, const int base[3],
+                   int& table, uint32_t& indices)
+{
+    int best_error = INT_MAX;
+    for(int candidate = 0; candidate < 8; ++candidate) {
+        const int modifiers[4] = {COLOR_MODIFIERS[candidate][0], COLOR_MODIFIERS[candidate][1],
+                                  -COLOR_MODIFIERS[candidate][0], -COLOR_MODIFIERS[candidate][1]};
+        int error = 0;
+        uint32_t candidate_indices = 0;
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                if((flip ? y / 2 : x / 2) != subblock) {
+                    continue;
+                }
+                const unsigned char* pixel = pixels + (y * 4 + x) * 4;
+                int best_pixel_error = INT_MAX;
+                int best_index = 0;
+                for(int index = 0; index < 4; ++index) {
+                    int pixel_error = 0;
+                    for(int channel = 0; channel < 3; ++channel) {
+                        const int difference = Clamp255(base[channel] + modifiers[index]) - pixel[channel];
+                        pixel_error += difference * difference;
+                    }
+                    if(pixel_error < best_pixel_error) {
+                        best_pixel_error = pixel_error;
+                        best_index = index;
+                    }
+                }
+                error += best_pixel_error;
+                // the index's high bit goes in the upper half of the index word
+                const int number = PixelNumber(x, y);
+                candidate_indices |= static_cast<uint32_t>(best_index >> 1) << (16 + number);
+                candidate_indices |= static_cast<uint32_t>(best_index & 1) << number;
+            }
+        }
+        if(error < best_error) {
+            best_error = error;
+            table = candidate;
+            indices = candidate_indices;
+        }
+    }
+    return best_error;
+}
+
+void StoreBigEndian(uint64_t value, unsigned char* bytes)
+{
+    for(int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<unsigned char>(value >> (56 - 8 * i));
+    }
+}
+
+} // namespace
+
+void EtcEncoder::EncodeColorBlock(const unsigned char* pixels, unsigned char* block)
+{
+    int best_error = INT_MAX;
+    uint64_t best_block = 0;
+    for(bool flip : {false, true}) {
+        // the subblocks' average colors
+        int averages[2][3] = {};
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                const int subblock = flip ? y / 2 : x / 2;
+                for(int channel = 0; channel < 3; ++channel) {
+                    averages[subblock][channel] += pixels[(y * 4 + x) * 4 + channel];
+                }
+            }
+        }
+        for(auto& average : averages) {
+            for(int& channel : average) {
+                channel = (channel + 4) / 8;
+            }
+        }
+
+        for(bool differential : {false, true}) {
+            // quantize the base colors: 4 bits each, or 5 bits and a 3-bit delta for the second
+            int quantized[2][3];
+            int bases[2][3];
+            for(int channel = 0; channel < 3; ++channel) {
+                if(differential) {
+                    quantized[0][channel] = (averages[0][channel] * 31 + 127) / 255;
+                    const int second = (averages[1][channel] * 31 + 127) / 255;
+                    quantized[1][channel] = quantized[0][channel] + std::min(std::max(second - quantized[0][channel], -4), 3);
+                    for(int subblock = 0; subblock < 2; ++subblock) {
+                        bases[subblock][channel] = (quantized[subblock][channel] << 3) | (quantized[subblock][channel] >> 2);
+                    }
+                } else {
+                    for(int subblock = 0; subblock < 2; ++subblock) {
+                        quantized[subblock][channel] = (averages[subblock][channel] * 15 + 127) / 255;
+                        bases[subblock][channel] = quantized[subblock][channel] * 17;
+                    }
+                }
+            }
+
+            int tables[2] = {};
+            uint32_t indices[2] = {};
+            const int error = EncodeSubblock(pixels, flip, 0, bases[0], tables[0], indices[0])
+                              + EncodeSubblock(pixels, flip, 1, bases[1], tables[1], indices[1]);
+            if(error >= best_error) {
+                continue;
+            }
+            best_error = error;
+
+            uint64_t bits = 0;
+            for(int channel = 0; channel < 3; ++channel) {
+                const int shift = 59 - 8 * channel;
+                if(differential) {
+                    bits |= static_cast<uint64_t>(quantized[0][channel]) << shift;
+                    bits |= static_cast<uint64_t>((quantized[1][channel] - quantized[0][channel]) & 0x7) << (shift - 3);
+                } else {
+                    bits |= static_cast<uint64_t>(quantized[0][channel]) << (shift + 1);
+                    bits |= static_cast<uint64_t>(quantized[1][channel]) << (shift - 3);
+                }
+            }
+            bits |= static_cast<uint64_t>(tables[0]) << 37;
+            bits |= static_cast<uint64_t>(tables[1]) << 34;
+            bits |= static_cast<uint64_t>(differential ? 1 : 0) << 33;
+            bits |= static_cast<uint64_t>(flip ? 1 : 0) << 32;
+            bits |= indices[0] | indices[1];
+            best_block = bits;
+        }
+    }
+    StoreBigEndian(best_block, block);
+}
+
+void EtcEncoder::EncodeAlphaBlock(const unsigned char* pixels, unsigned char* block)
+{
+    int min_alpha = 255;
+    int max_alpha = 0;
+    for(int i = 0; i < 16; ++i) {
+        min_alpha = std::min<int>(min_alpha, pixels[i * 4 + 3]);
+        max_alpha = std::max<int>(max_alpha, pixels[i * 4 + 3]);
+    }
+
+    // constant alpha: table 13 has a 0 modifier
+    int best_error = INT_MAX;
+    uint64_t best_block = (static_cast<uint64_t>(min_alpha) << 56) | (1ull << 52) | (13ull << 48);
+    for(int i = 0; i < 16; ++i) {
+        best_block |= 4ull << (45 - 3 * i);
+    }
+    if(min_alpha == max_alpha) {
+        StoreBigEndian(best_block, block);
+        return;
+    }
+
+    for(int table = 0; table < 16; ++table) {
+        const int* modifiers = ALPHA_MODIFIERS[table];
+        const int low = *std::min_element(modifiers, modifiers + 8);
+        const int high = *std::max_element(modifiers, modifiers + 8);
+        // the multiplier and base spreading the table over the alpha range, and their neighbours
+        const int estimate = std::min(std::max((max_alpha - min_alpha + (high - low) / 2) / (high - low), 1), 15);
+        for(int multiplier = std::max(estimate - 1, 1); multiplier <= std::min(estimate + 1, 15); ++multiplier) {
+            const int center = Clamp255(min_alpha - low * multiplier);
+            for(int base = Clamp255(center - 2); base <= Clamp255(center + 2); ++base) {
+                int error = 0;
+                uint64_t indices = 0;
+                for(int y = 0; y < 4; ++y) {
+                    for(int x = 0; x < 4; ++x) {
+                        const int alpha = pixels[(y * 4 + x) * 4 + 3];
+                        int best_pixel_error = INT_MAX;
+                        int best_index = 0;
+                        for(int index = 0; index < 8; ++index) {
+                            const int difference = Clamp255(base + modifiers[index] * multiplier) - alpha;
+                            if(difference * difference < best_pixel_error) {
+                                best_pixel_error = difference * difference;
+                                best_index = index;
+                            }
+                        }
+                        error += best_pixel_error;
+                        indices |= static_cast<uint64_t>(best_index) << (45 - 3 * PixelNumber(x, y));
+                    }
+                }
+                if(error < best_error) {
+                    best_error = error;
+                    best_block = (static_cast<uint64_t>(base) << 56) | (static_cast<uint64_t>(multiplier) << 52)
+                                 | (static_cast<uint64_t>(table) << 48) | indices;
+                }
+            }
+        }
+    }
+    StoreBigEndian(best_block, block);
+}
+
+std::vector<unsigned char> EtcEncoder::EncodeImage(const unsigned char* pixels, int width, int height, bool with_alpha)
+{
+    const int blocks_x = (width + 3) / 4;
+    const int blocks_y = (height + 3) / 4;
+    const size_t block_bytes = with_alpha ? 16 : 8;
+    std::vector<unsigned char> blocks(static_cast<size_t>(blocks_x) * blocks_y * block_bytes);
+    unsigned char block_pixels[16 * 4];
+    for(int block_y = 0; block_y < blocks_y; ++block_y) {
+        for(int block_x = 0; block_x < blocks_x; ++block_x) {
+            for(int y = 0; y < 4; ++y) {
+                for(int x = 0; x < 4; ++x) {
+                    const int source_x = std::min(block_x * 4 + x, width - 1);
+                    const int source_y = std::min(block_y * 4 + y, height - 1);
+                    std::copy_n(pixels + (static_cast<size_t>(source_y) * width + source_x) * 4, 4,
+                                block_pixels + (y * 4 + x) * 4);
+                }
+            }
+            unsigned char* block = blocks.data() + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_bytes;
+            if(with_alpha) {
+                EncodeAlphaBlock(block_pixels, block);
+                block += 8;
+            }
+            EncodeColorBlock(block_pixels, block);
+        }
+    }
+    return blocks;
+}
@@ -0,0 +1,37 @@
+#ifndef MY_MOBILE_APP_ETCENCODER_H
+#define MY_MOBILE_APP_ETCENCODER_H
+
+#include <vector>
+
+/*!
+ * Encodes RGBA8 images into ETC2 blocks of 4x4 pixels: 8 bytes per block for RGB8, 16 for RGBA8
+ * (an EAC alpha block followed by the color block).
+ *
+ * Color blocks use the ETC1 compatible individual and differential modes only, with the subblock
+ * averages as base colors. That's a fast, offline quality trade-off: the T, H and planar modes
+ * ETC2 adds would do better on sharp color edges and smooth gradients.
+ */
+class EtcEncoder
+{
+public:
+    /*!
+     * @param pixels the 16 RGBA8 pixels of a block, row by row
+     * @param block receives the 8 bytes of the ETC2 RGB8 block
+     */
+    static void EncodeColorBlock(const unsigned char* pixels, unsigned char* block);
+
+    /*!
+     * @param pixels the 16 RGBA8 pixels of a block, row by row
+     * @param block receives the 8 bytes of the EAC alpha block
+     */
+    static void EncodeAlphaBlock(const unsigned char* pixels, unsigned char* block);
+
+    /*!
+     * Encodes an image, block row after block row. Blocks past the image's edges repeat its edge
+     * pixels.
+     * @param with_alpha RGBA8 (EAC alpha) blocks if true, RGB8 blocks otherwise
+     */
+    static std::vector<unsigned char> EncodeImage(const unsigned char* pixels, int width, int height, bool with_alpha);
+};
+
+#endif //MY_MOBILE_APP_ETCENCODER_H
@@ -0,0 +1,138 @@
+/*!
+ * Offline texture converter.
+ *
+ * Loads glTF models and writes, next to each image file they reference, a KTX2 version of it (same
+ * path, .ktx2 extension) holding its whole mip chain in a format the gpu samples directly. The
+ * loaders pick those up instead of decoding the image when the gpu supports their format (see
+ * MeshLoadOptions::compressed_texture_formats), and fall back to the source image otherwise.
+ *
+ * Opaque images are encoded as ETC2 RGB8, others as ETC2 RGBA8 with EAC alpha, or both as plain
+ * RGBA8 with --format rgba8. ASTC isn't encoded here: ASTC KTX2 files written by external encoders
+ * (astcenc, toktx) are loaded the same way.
+ *
+ * usage: texture_converter [--format etc2|rgba8] <model.gltf|glb>...
+ */
+#include "EtcEncoder.h"
+#include "GltfMeshModelLoader.h"
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct ConverterOptions {
+    bool etc2 = true;
+    std::vector<std::string> model_paths;
+};
+
+bool ParseOptions(int argc, char** argv, ConverterOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            const std::string format = argv[++i];
+            if (format != "etc2" && format != "rgba8") {
+                return false;
+            }
+            options.etc2 = format == "etc2";
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return false;
+        } else {
+            options.model_paths.push_back(arg);
+        }
+    }
+    return !options.model_paths.empty();
+}
+
+/*!
+ * @return the image, with its mip chain, in the requested format
+ */
+TextureCache::Image Convert(Texture texture, bool etc2) {
+    texture.GenerateMipChain();
+
+    TextureCache::Image image;
+    image.width = texture._image_width;
+    image.height = texture._image_height;
+    image.mip_levels = texture._mip_levels;
+    if (!etc2) {
+        image.pixels.assign(texture._image_data.begin(), texture._image_data.end());
+        return image;
+    }
+
+    bool opaque = true;
+    for (size_t i = 3; i < texture._image_data.size() && opaque; i += 4) {
+        opaque = texture._image_data[i] == 255;
+    }
+    image.compressed_format = opaque ? GL_COMPRESSED_RGB8_ETC2 : GL_COMPRESSED_RGBA8_ETC2_EAC;
+    size_t level_offset = 0;
+    for (int level = 0; level < image.mip_levels; ++level) {
+        const int width = std::max(image.width >> level, 1);
+        const int height = std::max(image.height >> level, 1);
+        const auto blocks = EtcEncoder::EncodeImage(texture._image_data.data() + level_offset, width, height, !opaque);
+        image.pixels.insert(image.pixels.end(), blocks.begin(), blocks.end());
+        level_offset += TextureAsset::getLevelSize(0, image.width, image.height, level);
+    }
+    return image;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ConverterOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--format etc2|rgba8] <model.gltf|glb>..." << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    std::set<std::string> converted;
+    GltfMeshModelLoader loader;
+    for (const auto& model_path : options.model_paths) {
+        auto model = loader.LoadModel(model_path);
+        if (!model) {
+            std::cerr << "failed to load " << model_path << std::endl;
+            ++failures;
+            continue;
+        }
+        const size_t slash = model_path.find_last_of("/\\");
+        const std::string base_dir = slash == std::string::npos ? "" : model_path.substr(0, slash + 1);
+
+        // every material's textures, of every submesh
+        std::vector<const Texture*> textures;
+        for (const auto& mesh : model->GetMeshes()) {
+            for (const auto& submesh : mesh->_submeshes) {
+                textures.push_back(&submesh.material._pbr_base_color_texture);
+                textures.push_back(&submesh.material._normal_texture);
+            }
+        }
+        for (const Texture* texture : textures) {
+            // images embedded in the model (data uris, glb buffers) have no file to put a KTX2 next to
+            const std::string& uri = texture->_image_uri;
+            const size_t extension = uri.find_last_of('.');
+            if (uri.empty() || uri.compare(0, 5, "data:") == 0 || extension == std::string::npos
+                || texture->_image_data.empty() || texture->_compressed_format != 0) {
+                continue;
+            }
+            const std::string ktx2_path = base_dir + uri.substr(0, extension) + ".ktx2";
+            if (!converted.insert(ktx2_path).second) {
+                continue;
+            }
+
+            const auto contents = Ktx2::Write(Convert(*texture, options.etc2));
+            std::ofstream file(ktx2_path, std::ios::binary);
+            if (contents.empty() || !file.write(reinterpret_cast<const char*>(contents.data()),
+                                                static_cast<std::streamsize>(contents.size()))) {
+                std::cerr << "failed to write " << ktx2_path << std::endl;
+                ++failures;
+                continue;
+            }
+            std::cout << ktx2_path << ": " << texture->_image_width << "x" << texture->_image_height
+                      << ", " << contents.size() << " bytes" << std::endl;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}